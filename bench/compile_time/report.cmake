@@ -0,0 +1,33 @@
+# Summarizes the log written by time_compile.cmake.
+#
+#   cmake -DLOG=<file> -P report.cmake
+
+if(NOT EXISTS "${LOG}")
+  message(FATAL_ERROR "No compile times recorded in ${LOG}; build the `clean` target and retry")
+endif()
+
+# Keep the latest time of each output file.
+file(STRINGS "${LOG}" entries)
+set(variants)
+foreach(entry IN LISTS entries)
+  list(GET entry 0 variant)
+  list(GET entry 1 output)
+  list(GET entry 2 elapsed)
+  string(MD5 key "${output}")
+  set(time_${variant}_${key} ${elapsed})
+  list(APPEND keys_${variant} ${key})
+  list(APPEND variants ${variant})
+endforeach()
+list(REMOVE_DUPLICATES variants)
+
+foreach(variant IN LISTS variants)
+  list(REMOVE_DUPLICATES keys_${variant})
+  list(LENGTH keys_${variant} units)
+  set(total 0)
+  foreach(key IN LISTS keys_${variant})
+    math(EXPR total "${total} + ${time_${variant}_${key}}")
+  endforeach()
+  math(EXPR total_ms "${total} / 1000")
+  math(EXPR mean_ms "${total} / 1000 / ${units}")
+  message("${variant}: ${units} translation units, ${total_ms} ms total, ${mean_ms} ms each")
+endforeach()
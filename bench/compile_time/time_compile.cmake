@@ -0,0 +1,46 @@
+# Compiler launcher used by the compile-time benchmark.
+#
+#   cmake -DLOG=<file> -DVARIANT=<name> -P time_compile.cmake <compiler> <args>...
+#
+# Runs the compiler command and appends "<variant>;<output>;<microseconds>" to
+# LOG. The output file keys the entry so rebuilding an object replaces its time
+# in the report instead of adding to it.
+
+set(command)
+set(output)
+set(script_seen FALSE)
+set(take_output FALSE)
+math(EXPR last "${CMAKE_ARGC} - 1")
+foreach(i RANGE 1 ${last})
+  set(arg "${CMAKE_ARGV${i}}")
+  if(NOT script_seen)
+    if(arg STREQUAL "-P")
+      math(EXPR script_index "${i} + 1")
+    elseif(DEFINED script_index AND i EQUAL script_index)
+      set(script_seen TRUE)
+    endif()
+    continue()
+  endif()
+  list(APPEND command "${arg}")
+  if(take_output)
+    set(output "${arg}")
+    set(take_output FALSE)
+  elseif(arg STREQUAL "-o")
+    set(take_output TRUE)
+  endif()
+endforeach()
+
+if(NOT output)
+  string(MD5 output "${command}")
+endif()
+
+string(TIMESTAMP start "%s%f")
+execute_process(COMMAND ${command} RESULT_VARIABLE result)
+string(TIMESTAMP stop "%s%f")
+
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Compilation failed: ${result}")
+endif()
+
+math(EXPR elapsed "${stop} - ${start}")
+file(APPEND "${LOG}" "${VARIANT};${output};${elapsed}\n")
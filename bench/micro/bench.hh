@@ -0,0 +1,134 @@
+#pragma once
+
+// Minimal self-contained microbenchmark harness.
+//
+// Benchmarks are registered with register_benchmark() and time the body of a
+// `while(st.keep_running())` loop. The runner (bench_main.cc) calibrates the
+// iteration count to a minimum batch time, repeats the batch, and reports the
+// per-iteration times as a table or JSON. With --perf-counters, hardware
+// counters (perf_counters.hh) are read around the timed region as well.
+
+#include "perf_counters.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jacl {
+namespace bench {
+
+/// @brief Prevents the compiler from optimizing away the computation of `value`.
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+/// @brief Forces pending writes to memory to be treated as observable.
+inline void clobber_memory() {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+/// @brief Timing state of one batch of benchmark iterations.
+class state {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit state(std::size_t iterations, perf_counters* perf = nullptr) :
+      iterations_{iterations}, remaining_{iterations}, perf_{perf} {}
+
+  /// @brief Returns true while iterations remain. The first call starts the
+  /// timer and the last call stops it.
+  bool keep_running() {
+    if(remaining_ == iterations_) {
+      start_ = clock::now();
+      if(perf_) perf_->start();
+    }
+    if(remaining_ != 0) {
+      --remaining_;
+      return true;
+    }
+    if(perf_) perf_->stop();
+    stop_ = clock::now();
+    return false;
+  }
+
+  /// @brief Excludes the time until resume_timing() from the measurement.
+  void pause_timing() {
+    if(perf_) perf_->pause();
+    pause_start_ = clock::now();
+  }
+
+  void resume_timing() {
+    paused_ += clock::now() - pause_start_;
+    if(perf_) perf_->resume();
+  }
+
+  /// @brief Number of items (elements, operations, ...) processed by the whole
+  /// batch; reported as a rate.
+  void set_items_processed(std::uint64_t n) { items_processed_ = n; }
+
+  /// @brief Adds a named value reported alongside the timings.
+  void set_counter(std::string name, double value) {
+    for(auto& counter : counters_) {
+      if(counter.first == name) {
+        counter.second = value;
+        return;
+      }
+    }
+    counters_.emplace_back(std::move(name), value);
+  }
+
+  std::size_t iterations() const noexcept { return iterations_; }
+
+  std::uint64_t items_processed() const noexcept { return items_processed_; }
+
+  const std::vector<std::pair<std::string, double>>& counters() const noexcept {
+    return counters_;
+  }
+
+  /// @brief Measured time of the batch in nanoseconds.
+  double elapsed_ns() const {
+    return std::chrono::duration<double, std::nano>(stop_ - start_ - paused_).count();
+  }
+
+private:
+  std::size_t iterations_;
+  std::size_t remaining_;
+  clock::time_point start_{};
+  clock::time_point stop_{};
+  clock::time_point pause_start_{};
+  clock::duration paused_{};
+  perf_counters* perf_;
+  std::uint64_t items_processed_{};
+  std::vector<std::pair<std::string, double>> counters_;
+}; // class state
+
+struct benchmark {
+  std::string name;
+  std::function<void(state&)> fn;
+  std::string label; ///< Free-form tag reported with the results, e.g. "inline".
+}; // struct benchmark
+
+inline std::vector<benchmark>& registry() {
+  static std::vector<benchmark> benchmarks;
+  return benchmarks;
+}
+
+inline void register_benchmark(
+    std::string name, std::function<void(state&)> fn, std::string label = {}) {
+  registry().push_back(benchmark{std::move(name), std::move(fn), std::move(label)});
+}
+
+} // namespace bench
+} // namespace jacl
@@ -0,0 +1,239 @@
+// Runner for benchmarks registered with jacl::bench::register_benchmark().
+//
+// Usage: <bench> [--filter=<regex>] [--min-time=<seconds>] [--repetitions=<n>]
+//                [--json=<file>|-] [--perf-counters] [--list]
+//
+// Hardware counters are reported per iteration, from the median of the
+// repetitions, next to the user counters of each benchmark.
+
+#include "bench.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::string filter{".*"};
+  double min_time{0.1};
+  std::size_t repetitions{5};
+  std::string json;
+  bool perf_counters{false};
+  bool list{false};
+}; // struct options
+
+struct result {
+  std::string name;
+  std::string label;
+  std::size_t iterations{};
+  double min_ns{};
+  double median_ns{};
+  double mean_ns{};
+  double items_per_second{};
+  std::vector<std::pair<std::string, double>> counters;
+}; // struct result
+
+bool parse_flag(const char* arg, const char* flag, std::string& value) {
+  const std::size_t len = std::strlen(flag);
+  if(std::strncmp(arg, flag, len) != 0 || arg[len] != '=') return false;
+  value = arg + len + 1;
+  return true;
+}
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for(int i = 1; i < argc; ++i) {
+    std::string value;
+    if(parse_flag(argv[i], "--filter", value)) {
+      opts.filter = value;
+    } else if(parse_flag(argv[i], "--min-time", value)) {
+      opts.min_time = std::strtod(value.c_str(), nullptr);
+    } else if(parse_flag(argv[i], "--repetitions", value)) {
+      opts.repetitions = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+    } else if(parse_flag(argv[i], "--json", value)) {
+      opts.json = value;
+    } else if(std::strcmp(argv[i], "--perf-counters") == 0) {
+      opts.perf_counters = true;
+    } else if(std::strcmp(argv[i], "--list") == 0) {
+      opts.list = true;
+    } else {
+      std::fprintf(stderr,
+          "usage: %s [--filter=<regex>] [--min-time=<seconds>] [--repetitions=<n>] "
+          "[--json=<file>|-] [--perf-counters] [--list]\n",
+          argv[0]);
+      std::exit(2);
+    }
+  }
+  return opts;
+}
+
+jacl::bench::state run_batch(const jacl::bench::benchmark& b, std::size_t iterations,
+    jacl::bench::perf_counters* perf = nullptr) {
+  jacl::bench::state st{iterations, perf};
+  b.fn(st);
+  return st;
+}
+
+double median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+result run(const jacl::bench::benchmark& b, const options& opts, jacl::bench::perf_counters* perf) {
+  // Grow the batch until it runs for at least min_time.
+  const double min_ns    = opts.min_time * 1e9;
+  std::size_t iterations = 1;
+  for(;;) {
+    const auto st = run_batch(b, iterations);
+    if(st.elapsed_ns() >= min_ns || iterations >= 1000000000) break;
+    const double scale = st.elapsed_ns() > 0 ? 1.4 * min_ns / st.elapsed_ns() : 10.0;
+    iterations = static_cast<std::size_t>(iterations * std::min(10.0, std::max(2.0, scale)));
+  }
+
+  std::vector<double> times;
+  result r;
+  r.name       = b.name;
+  r.label      = b.label;
+  r.iterations = iterations;
+  std::uint64_t items{};
+  std::vector<std::pair<std::string, std::vector<double>>> hardware;
+  for(std::size_t rep = 0; rep < opts.repetitions; ++rep) {
+    const auto st = run_batch(b, iterations, perf);
+    times.push_back(st.elapsed_ns() / iterations);
+    items      = st.items_processed();
+    r.counters = st.counters();
+    if(perf == nullptr) continue;
+    for(const auto& counter : perf->read()) {
+      auto it = std::find_if(hardware.begin(), hardware.end(),
+          [&](const std::pair<std::string, std::vector<double>>& h) {
+            return h.first == counter.first;
+          });
+      if(it == hardware.end()) it = hardware.insert(hardware.end(), {counter.first, {}});
+      it->second.push_back(counter.second / iterations);
+    }
+  }
+  for(const auto& h : hardware) r.counters.emplace_back(h.first, median(h.second));
+
+  std::sort(times.begin(), times.end());
+  r.min_ns    = times.front();
+  r.median_ns = times[times.size() / 2];
+  for(double t : times) r.mean_ns += t;
+  r.mean_ns /= times.size();
+  if(items != 0) r.items_per_second = items / (r.median_ns * iterations) * 1e9;
+  return r;
+}
+
+std::string json_escape(const std::string& s) {
+  std::string out;
+  for(char c : s) {
+    if(c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+void write_json(std::ostream& out, const std::vector<result>& results, const options& opts) {
+  char date[64];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+  out << "{\n  \"context\": {\n";
+  out << "    \"date\": \"" << date << "\",\n";
+  out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#if defined(__VERSION__)
+  out << "    \"compiler\": \"" << json_escape(__VERSION__) << "\",\n";
+#endif
+#if defined(NDEBUG)
+  out << "    \"build_type\": \"release\",\n";
+#else
+  out << "    \"build_type\": \"debug\",\n";
+#endif
+  out << "    \"min_time\": " << opts.min_time << ",\n";
+  out << "    \"repetitions\": " << opts.repetitions << ",\n";
+  out << "    \"perf_counters\": " << (opts.perf_counters ? "true" : "false") << "\n";
+  out << "  },\n  \"benchmarks\": [";
+  for(std::size_t i = 0; i < results.size(); ++i) {
+    const auto& r = results[i];
+    out << (i ? ",\n" : "\n") << "    {\n";
+    out << "      \"name\": \"" << json_escape(r.name) << "\",\n";
+    if(!r.label.empty()) out << "      \"label\": \"" << json_escape(r.label) << "\",\n";
+    out << "      \"iterations\": " << r.iterations << ",\n";
+    out << "      \"min_ns\": " << r.min_ns << ",\n";
+    out << "      \"median_ns\": " << r.median_ns << ",\n";
+    out << "      \"mean_ns\": " << r.mean_ns;
+    if(r.items_per_second != 0) out << ",\n      \"items_per_second\": " << r.items_per_second;
+    for(const auto& counter : r.counters) {
+      out << ",\n      \"" << json_escape(counter.first) << "\": " << counter.second;
+    }
+    out << "\n    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const options opts = parse_options(argc, argv);
+  const std::regex filter{opts.filter};
+  const bool table = opts.json != "-";
+
+  std::unique_ptr<jacl::bench::perf_counters> perf;
+  if(opts.perf_counters && !opts.list) {
+    perf.reset(new jacl::bench::perf_counters);
+    if(!perf->available()) {
+      std::fprintf(stderr, "hardware counters unavailable (%s); reporting time only\n",
+          perf->error().c_str());
+      perf.reset();
+    }
+  }
+
+  if(table && !opts.list) {
+    std::printf("%-56s %12s %12s %12s %14s\n", "benchmark", "iterations", "median ns", "min ns",
+        "items/s");
+  }
+
+  std::vector<result> results;
+  for(const auto& b : jacl::bench::registry()) {
+    if(!std::regex_search(b.name, filter)) continue;
+    if(opts.list) {
+      std::printf("%s\n", b.name.c_str());
+      continue;
+    }
+
+    results.push_back(run(b, opts, perf.get()));
+    if(table) {
+      const auto& r = results.back();
+      std::printf("%-56s %12zu %12.2f %12.2f %14.4g", r.name.c_str(), r.iterations, r.median_ns,
+          r.min_ns, r.items_per_second);
+      if(!r.label.empty()) std::printf(" [%s]", r.label.c_str());
+      for(const auto& counter : r.counters) {
+        std::printf(" %s=%.4g", counter.first.c_str(), counter.second);
+      }
+      std::printf("\n");
+      std::fflush(stdout);
+    }
+  }
+
+  if(opts.json == "-") {
+    write_json(std::cout, results, opts);
+  } else if(!opts.json.empty()) {
+    std::ofstream out{opts.json};
+    write_json(out, results, opts);
+    if(!out) {
+      std::fprintf(stderr, "failed to write %s\n", opts.json.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
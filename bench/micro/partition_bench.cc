@@ -0,0 +1,88 @@
+// Radix partitioning of rows into per-partition small_vectors.
+//
+// Names are partition/<method>/<partitions>. Each iteration scatters 4M
+// 64-bit rows by the top bits of a multiplicative hash into fresh buckets.
+// `push_back` appends row by row, checking the capacity and growing each
+// bucket several times. `partition_by` counts the rows per bucket, sizes each
+// bucket once, and scatters through cache-line write-combining buffers.
+
+#include "bench.hh"
+
+#include "jacl/small_vector_algorithms.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+using jacl::bench::do_not_optimize;
+using jacl::bench::state;
+
+constexpr std::size_t row_count = std::size_t(1) << 22;
+
+using bucket_type = jacl::small_vector<std::uint64_t, 16>;
+
+struct hash_bits {
+  unsigned shift;
+
+  std::size_t operator()(std::uint64_t row) const {
+    return std::size_t((row * 0x9e3779b97f4a7c15ull) >> shift);
+  }
+};
+
+std::vector<std::uint64_t> make_rows() {
+  std::vector<std::uint64_t> rows(row_count);
+  std::uint64_t x = 88172645463325252ull;
+  for(std::uint64_t& row : rows) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    row = x;
+  }
+  return rows;
+}
+
+const std::vector<std::uint64_t>& rows() {
+  static const std::vector<std::uint64_t> r = make_rows();
+  return r;
+}
+
+unsigned log2(std::size_t n) {
+  unsigned bits = 0;
+  while((std::size_t(1) << bits) < n) ++bits;
+  return bits;
+}
+
+template <typename partitionFnT>
+void partition(state& st, std::size_t partitions, partitionFnT partition_fn) {
+  const hash_bits key{64 - log2(partitions)};
+  while(st.keep_running()) {
+    std::vector<bucket_type> buckets(partitions);
+    partition_fn(rows(), key, buckets);
+    do_not_optimize(buckets.data());
+  }
+  st.set_items_processed(st.iterations() * row_count);
+}
+
+const bool registered = [] {
+  for(std::size_t partitions : {16, 64, 256, 1024}) {
+    const std::string suffix = "/" + std::to_string(partitions);
+    jacl::bench::register_benchmark("partition/push_back" + suffix, [partitions](state& st) {
+      partition(st, partitions,
+          [](const std::vector<std::uint64_t>& src, const hash_bits& key,
+              std::vector<bucket_type>& buckets) {
+            for(std::uint64_t row : src) buckets[key(row)].push_back(row);
+          });
+    });
+    jacl::bench::register_benchmark("partition/partition_by" + suffix, [partitions](state& st) {
+      partition(st, partitions,
+          [](const std::vector<std::uint64_t>& src, const hash_bits& key,
+              std::vector<bucket_type>& buckets) { jacl::partition_by(src, key, buckets); });
+    });
+  }
+  return true;
+}();
+
+} // namespace
@@ -0,0 +1,127 @@
+#pragma once
+
+// Hardware performance counters read through Linux perf_event_open(2).
+//
+// The counters are opened as one group so they cover the same instructions.
+// Counters the kernel or the hardware does not support are left out, and on
+// other platforms or without permission (see perf_event_paranoid) the set is
+// empty; benchmarks then report wall time only.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif // defined(__linux__)
+
+namespace jacl {
+namespace bench {
+
+class perf_counters {
+public:
+  perf_counters() {
+#if defined(__linux__)
+    open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open("l1d_misses", PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    open("llc_misses", PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    open("branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#else
+    error_ = "perf_event_open is only available on Linux";
+#endif // defined(__linux__)
+  }
+
+  perf_counters(const perf_counters&)            = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  ~perf_counters() {
+#if defined(__linux__)
+    for(const auto& c : counters_) ::close(c.fd);
+#endif // defined(__linux__)
+  }
+
+  bool available() const noexcept { return !counters_.empty(); }
+
+  /// @brief Why no counter could be opened; empty if available().
+  const std::string& error() const noexcept { return error_; }
+
+  /// @brief Resets and starts all counters.
+  void start() {
+    ioctl_group(PERF_EVENT_IOC_RESET);
+    ioctl_group(PERF_EVENT_IOC_ENABLE);
+  }
+
+  void stop() { ioctl_group(PERF_EVENT_IOC_DISABLE); }
+
+  /// @brief Stops counting without resetting, like state::pause_timing().
+  void pause() { ioctl_group(PERF_EVENT_IOC_DISABLE); }
+
+  void resume() { ioctl_group(PERF_EVENT_IOC_ENABLE); }
+
+  /// @brief Counts since start(), scaled up if the kernel multiplexed the
+  /// counters. Counters that never ran are omitted.
+  std::vector<std::pair<std::string, double>> read() const {
+    std::vector<std::pair<std::string, double>> values;
+#if defined(__linux__)
+    for(const auto& c : counters_) {
+      std::uint64_t data[3];
+      if(::read(c.fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0)
+        continue;
+      values.emplace_back(c.name, static_cast<double>(data[0]) * data[1] / data[2]);
+    }
+#endif // defined(__linux__)
+    return values;
+  }
+
+private:
+#if defined(__linux__)
+  void open(const char* name, std::uint32_t type, std::uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = counters_.empty() ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    const int group = counters_.empty() ? -1 : counters_.front().fd;
+    const long fd   = ::syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+    if(fd < 0) {
+      if(counters_.empty()) error_ = std::string{"perf_event_open: "} + std::strerror(errno);
+      return;
+    }
+    counters_.push_back(counter{name, static_cast<int>(fd)});
+  }
+
+  void ioctl_group(unsigned long request) {
+    if(!counters_.empty()) ::ioctl(counters_.front().fd, request, PERF_IOC_FLAG_GROUP);
+  }
+#else
+  void ioctl_group(unsigned long) {}
+#endif // defined(__linux__)
+
+  struct counter {
+    std::string name;
+    int fd;
+  }; // struct counter
+
+  std::vector<counter> counters_;
+  std::string error_;
+}; // class perf_counters
+
+} // namespace bench
+} // namespace jacl
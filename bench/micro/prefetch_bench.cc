@@ -0,0 +1,81 @@
+// Scans of adjacency lists whose small_vectors spilled to the heap.
+//
+// Names are adjacency_scan/<method>[/<distance>]. The graph has 1M vertices
+// with 5 to 12 neighbors each, past the inline capacity of 4, and the lists
+// are filled in shuffled vertex order so that consecutive vertices' heap
+// buffers lie far apart. Each iteration sums every neighbor id. `plain` walks
+// the lists directly, `prefetch_range` prefetches the buffers <distance>
+// vertices ahead.
+
+#include "bench.hh"
+
+#include "jacl/prefetch_range.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using jacl::bench::do_not_optimize;
+using jacl::bench::state;
+
+constexpr std::size_t vertex_count = std::size_t(1) << 20;
+
+using list_type = jacl::small_vector<std::uint32_t, 4>;
+
+std::vector<list_type> make_graph() {
+  std::mt19937 rng(7);
+  std::vector<std::uint32_t> order(vertex_count);
+  std::iota(order.begin(), order.end(), 0u);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  std::vector<list_type> graph(vertex_count);
+  for(std::uint32_t v : order) {
+    const std::size_t degree = 5 + rng() % 8;
+    for(std::size_t i = 0; i < degree; ++i) graph[v].push_back(rng() % vertex_count);
+  }
+  return graph;
+}
+
+const std::vector<list_type>& graph() {
+  static const std::vector<list_type> g = make_graph();
+  return g;
+}
+
+template <typename rangeT>
+std::uint64_t sum_neighbors(const rangeT& lists) {
+  std::uint64_t sum = 0;
+  for(const list_type& list : lists) {
+    for(std::uint32_t neighbor : list) sum += neighbor;
+  }
+  return sum;
+}
+
+template <typename scanFnT>
+void scan(state& st, scanFnT scan_fn) {
+  const std::vector<list_type>& g = graph();
+  while(st.keep_running()) do_not_optimize(scan_fn(g));
+  st.set_items_processed(st.iterations() * vertex_count);
+}
+
+const bool registered = [] {
+  jacl::bench::register_benchmark("adjacency_scan/plain", [](state& st) {
+    scan(st, [](const std::vector<list_type>& g) { return sum_neighbors(g); });
+  });
+  for(std::size_t distance : {2, 8, 32}) {
+    jacl::bench::register_benchmark("adjacency_scan/prefetch_range/" + std::to_string(distance),
+        [distance](state& st) {
+          scan(st, [distance](const std::vector<list_type>& g) {
+            return sum_neighbors(jacl::prefetch_range(g, distance));
+          });
+        });
+  }
+  return true;
+}();
+
+} // namespace
@@ -0,0 +1,109 @@
+// Cache pollution of large relocations and copies.
+//
+// Names are <operation>/<container>/<MiB>. Each iteration relocates (grows by
+// one element past a full buffer) or copies a vector of <MiB> MiB, then walks
+// a 1 MiB working set that was warm before the operation, standing in for
+// the work that shares the cache with the vector. The walk time is reported
+// as `walk_ns`; the lower it is, the less of the working set the operation
+// evicted. small_vector streams buffers of at least
+// JACL_SMALL_VECTOR_STREAMING_THRESHOLD bytes past the cache, std::vector
+// copies them through it.
+
+#include "bench.hh"
+
+#include "jacl/small_vector.hh"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using jacl::bench::do_not_optimize;
+using jacl::bench::state;
+
+constexpr std::size_t working_set_bytes = std::size_t(1) << 20;
+
+std::uint64_t walk(const std::vector<std::uint64_t>& working_set) {
+  std::uint64_t sum = 0;
+  for(std::uint64_t v : working_set) sum += v;
+  return sum;
+}
+
+template <typename T>
+T fill_value() {
+  return T(1);
+}
+
+// Short enough for the small string buffer, so copies do not allocate.
+template <>
+std::string fill_value<std::string>() {
+  return "value";
+}
+
+enum operation { op_relocate, op_copy };
+
+template <typename vectorT>
+void relocate_or_copy_then_walk(state& st, operation op, std::size_t mib) {
+  using T             = typename vectorT::value_type;
+  const std::size_t n = (mib << 20) / sizeof(T);
+  std::vector<std::uint64_t> working_set(working_set_bytes / sizeof(std::uint64_t), 1);
+
+  vectorT v;
+  vectorT copy;
+  std::chrono::steady_clock::duration walk_time{};
+  while(st.keep_running()) {
+    st.pause_timing();
+    copy = vectorT();
+    v    = vectorT(n, fill_value<T>());
+    do_not_optimize(walk(working_set));
+    st.resume_timing();
+
+    if(op == op_relocate) {
+      v.reserve(v.capacity() + 1);
+    } else {
+      copy = v;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    do_not_optimize(walk(working_set));
+    walk_time += std::chrono::steady_clock::now() - start;
+  }
+  st.set_items_processed(st.iterations() * (mib << 20));
+  st.set_counter("walk_ns",
+      std::chrono::duration<double, std::nano>(walk_time).count() / double(st.iterations()));
+}
+
+template <typename vectorT>
+void add(operation op, const std::string& container, std::size_t mib, std::string label = {}) {
+  jacl::bench::register_benchmark(
+      std::string{op == op_relocate ? "relocate" : "copy"} + "/" + container + "/" +
+          std::to_string(mib) + "MiB",
+      [op, mib](state& st) { relocate_or_copy_then_walk<vectorT>(st, op, mib); },
+      std::move(label));
+}
+
+template <typename T>
+void register_type(const std::string& type, std::size_t mib) {
+  const bool streams = std::is_trivially_copyable<T>::value &&
+                       (mib << 20) >= JACL_SMALL_VECTOR_STREAMING_THRESHOLD &&
+                       JACL_SMALL_VECTOR_STREAMING_THRESHOLD > 0 && JACL_HAS_STREAMING_STORES;
+  for(operation op : {op_relocate, op_copy}) {
+    add<std::vector<T>>(op, "std::vector<" + type + ">", mib);
+    add<jacl::small_vector<T, 16>>(op, "small_vector<" + type + ",16>", mib,
+        streams ? "streaming" : "cached");
+  }
+}
+
+const bool registered = [] {
+  for(std::size_t mib : {2, 16, 64}) register_type<int>("int", mib);
+  // Element-wise relocations prefetch the source instead.
+  register_type<std::string>("string", 16);
+  return true;
+}();
+
+} // namespace
@@ -0,0 +1,223 @@
+// Hot-path microbenchmarks of small_vector against std::vector and std::array.
+//
+// Names are <operation>/<container>/<size>, where <size> is the number of
+// elements. small_vector is measured with several inline capacities so each
+// size is covered in both inline and heap mode; its results are labelled with
+// the mode, so hardware counters can be compared between the two paths.
+
+#include "bench.hh"
+
+#include "jacl/small_vector.hh"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using jacl::bench::do_not_optimize;
+using jacl::bench::state;
+
+template <typename T>
+struct value_traits;
+
+template <>
+struct value_traits<int> {
+  static const char* name() { return "int"; }
+  static int make(std::size_t i) { return static_cast<int>(i); }
+}; // struct value_traits<int>
+
+// Short strings stay within the small string buffer, so the benchmarks measure
+// the non-trivial copy and move paths rather than the string allocations.
+template <>
+struct value_traits<std::string> {
+  static const char* name() { return "string"; }
+  static std::string make(std::size_t i) { return "value" + std::to_string(i % 1000); }
+}; // struct value_traits<std::string>
+
+template <typename containerT>
+containerT make_filled(std::size_t n) {
+  using T = typename containerT::value_type;
+  containerT c;
+  for(std::size_t i = 0; i < n; ++i) c.push_back(value_traits<T>::make(i));
+  return c;
+}
+
+template <typename T, std::size_t sizeN>
+std::array<T, sizeN> make_array() {
+  std::array<T, sizeN> a;
+  for(std::size_t i = 0; i < sizeN; ++i) a[i] = value_traits<T>::make(i);
+  return a;
+}
+
+template <typename containerT>
+void construct_destroy(state& st, std::size_t n) {
+  using T       = typename containerT::value_type;
+  const T value = value_traits<T>::make(n);
+  while(st.keep_running()) {
+    containerT c(n, value);
+    do_not_optimize(c.data());
+  }
+  st.set_items_processed(st.iterations() * n);
+}
+
+template <typename containerT>
+void push_back(state& st, std::size_t n) {
+  using T       = typename containerT::value_type;
+  const T value = value_traits<T>::make(n);
+  while(st.keep_running()) {
+    containerT c;
+    for(std::size_t i = 0; i < n; ++i) c.push_back(value);
+    do_not_optimize(c.data());
+  }
+  st.set_items_processed(st.iterations() * n);
+}
+
+// Insert into and erase from the middle; the size is unchanged between
+// iterations, so the container stays in the same storage mode.
+template <typename containerT>
+void insert_erase(state& st, std::size_t n) {
+  using T       = typename containerT::value_type;
+  const T value = value_traits<T>::make(n);
+  auto c        = make_filled<containerT>(n);
+  while(st.keep_running()) {
+    auto it = c.emplace(c.begin() + n / 2, value);
+    c.erase(it);
+    do_not_optimize(c.data());
+  }
+  st.set_items_processed(st.iterations() * 2);
+}
+
+template <typename containerT>
+void copy(state& st, std::size_t n) {
+  const auto source = make_filled<containerT>(n);
+  while(st.keep_running()) {
+    containerT c{source};
+    do_not_optimize(c.data());
+  }
+  st.set_items_processed(st.iterations() * n);
+}
+
+template <typename containerT>
+void move(state& st, std::size_t n) {
+  auto c = make_filled<containerT>(n);
+  while(st.keep_running()) {
+    containerT tmp{std::move(c)};
+    c = std::move(tmp);
+    do_not_optimize(c.data());
+  }
+  st.set_items_processed(st.iterations() * 2);
+}
+
+template <typename containerT>
+void swap(state& st, std::size_t n) {
+  auto a = make_filled<containerT>(n);
+  auto b = make_filled<containerT>(n / 2);
+  while(st.keep_running()) {
+    a.swap(b);
+    do_not_optimize(a.data());
+  }
+  st.set_items_processed(st.iterations());
+}
+
+template <typename T, std::size_t sizeN>
+void array_construct_destroy(state& st, std::size_t) {
+  const T value = value_traits<T>::make(sizeN);
+  while(st.keep_running()) {
+    std::array<T, sizeN> a;
+    a.fill(value);
+    do_not_optimize(a.data());
+  }
+  st.set_items_processed(st.iterations() * sizeN);
+}
+
+template <typename T, std::size_t sizeN>
+void array_copy(state& st, std::size_t) {
+  const auto source = make_array<T, sizeN>();
+  while(st.keep_running()) {
+    std::array<T, sizeN> a{source};
+    do_not_optimize(a.data());
+  }
+  st.set_items_processed(st.iterations() * sizeN);
+}
+
+template <typename T, std::size_t sizeN>
+void array_swap(state& st, std::size_t) {
+  auto a = make_array<T, sizeN>();
+  auto b = make_array<T, sizeN>();
+  while(st.keep_running()) {
+    a.swap(b);
+    do_not_optimize(a.data());
+  }
+  st.set_items_processed(st.iterations());
+}
+
+using benchmark_fn = void (*)(state&, std::size_t);
+
+enum operation { op_construct_destroy, op_push_back, op_insert_erase, op_copy, op_move, op_swap };
+
+constexpr const char* operation_names[] = {
+    "construct_destroy", "push_back", "insert_erase", "copy", "move", "swap"};
+
+constexpr std::size_t element_counts[] = {4, 16, 64, 256};
+
+template <typename containerT>
+benchmark_fn container_benchmark(operation op) {
+  switch(op) {
+  case op_construct_destroy: return &construct_destroy<containerT>;
+  case op_push_back: return &push_back<containerT>;
+  case op_insert_erase: return &insert_erase<containerT>;
+  case op_copy: return &copy<containerT>;
+  case op_move: return &move<containerT>;
+  case op_swap: return &swap<containerT>;
+  }
+  return nullptr;
+}
+
+// std::array has a fixed size and no insertion, so it only takes part in the
+// operations that are meaningful for it.
+template <typename T, std::size_t sizeN>
+benchmark_fn array_benchmark(operation op) {
+  switch(op) {
+  case op_construct_destroy: return &array_construct_destroy<T, sizeN>;
+  case op_copy: return &array_copy<T, sizeN>;
+  case op_swap: return &array_swap<T, sizeN>;
+  default: return nullptr;
+  }
+}
+
+void add(operation op, const std::string& container, std::size_t n, benchmark_fn fn,
+    std::string label = {}) {
+  if(fn == nullptr) return;
+  jacl::bench::register_benchmark(
+      std::string{operation_names[op]} + "/" + container + "/" + std::to_string(n),
+      [fn, n](state& st) { fn(st, n); }, std::move(label));
+}
+
+template <typename T, std::size_t... sizeNs>
+void register_type(std::index_sequence<sizeNs...>) {
+  const std::string type = value_traits<T>::name();
+  for(operation op : {op_construct_destroy, op_push_back, op_insert_erase, op_copy, op_move,
+          op_swap}) {
+    for(std::size_t n : element_counts) {
+      add(op, "std::vector<" + type + ">", n, container_benchmark<std::vector<T>>(op));
+      ((n == sizeNs ? add(op, "std::array<" + type + "," + std::to_string(sizeNs) + ">", n,
+                          array_benchmark<T, sizeNs>(op))
+                    : void()),
+          ...);
+      (add(op, "small_vector<" + type + "," + std::to_string(sizeNs) + ">", n,
+           container_benchmark<jacl::small_vector<T, sizeNs>>(op), n <= sizeNs ? "inline" : "heap"),
+          ...);
+    }
+  }
+}
+
+const bool registered = [] {
+  register_type<int>(std::index_sequence<4, 16, 64>{});
+  register_type<std::string>(std::index_sequence<4, 16, 64>{});
+  return true;
+}();
+
+} // namespace
@@ -0,0 +1,524 @@
+// Replays a small_vector operation trace (see jacl/small_vector_trace.hh)
+// against several container configurations and reports time and allocations.
+//
+// Usage: small_vector_replay <trace> [--type=<id>] [--repetitions=<n>] [--json=<file>|-]
+//
+// Every configuration replays the same operations: small_vector with inline
+// sizes 1 to 32 and std::vector, each with its default growth and with capacity
+// doubling emulated through reserve(), on a counting heap allocator and on a
+// counting arena allocator. Element types are replaced by trivially copyable
+// blobs of the traced size, rounded up to a power of two (at most 256 bytes).
+// Timings include destroying the vectors still alive at the end of the trace.
+
+#include "../micro/bench.hh"
+
+#include "jacl/small_vector_trace.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Allocation statistics of one replay.
+struct allocation_counters {
+  std::uint64_t allocations{};
+  std::uint64_t bytes{};
+  std::uint64_t live_bytes{};
+  std::uint64_t peak_bytes{};
+
+  void allocate(std::size_t n) {
+    ++allocations;
+    bytes      += n;
+    live_bytes += n;
+    peak_bytes  = std::max(peak_bytes, live_bytes);
+  }
+
+  void deallocate(std::size_t n) { live_bytes -= n; }
+}; // struct allocation_counters
+
+allocation_counters counters;
+
+template <typename T>
+struct counting_allocator {
+  using value_type = T;
+
+  counting_allocator() = default;
+  template <typename U>
+  counting_allocator(const counting_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    counters.allocate(n * sizeof(T));
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    counters.deallocate(n * sizeof(T));
+    std::allocator<T>{}.deallocate(p, n);
+  }
+
+  bool operator==(const counting_allocator&) const noexcept { return true; }
+  bool operator!=(const counting_allocator&) const noexcept { return false; }
+}; // struct counting_allocator
+
+// Monotonic arena shared by every arena_allocator; memory is reclaimed only by
+// reset() between replays.
+class arena {
+public:
+  static arena& instance() {
+    static arena a;
+    return a;
+  }
+
+  void* allocate(std::size_t n) {
+    n = (n + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    if(blocks_.empty() || used_ + n > block_size_) {
+      const std::size_t size = std::max(n, block_size_);
+      blocks_.emplace_back(new unsigned char[size]);
+      used_ = 0;
+    }
+    void* p = blocks_.back().get() + used_;
+    used_  += n;
+    return p;
+  }
+
+  void reset() {
+    blocks_.clear();
+    used_ = 0;
+  }
+
+private:
+  static constexpr std::size_t block_size_ = std::size_t{1} << 20;
+  std::vector<std::unique_ptr<unsigned char[]>> blocks_;
+  std::size_t used_{};
+}; // class arena
+
+template <typename T>
+struct arena_allocator {
+  using value_type = T;
+
+  arena_allocator() = default;
+  template <typename U>
+  arena_allocator(const arena_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    counters.allocate(n * sizeof(T));
+    return static_cast<T*>(arena::instance().allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T*, std::size_t n) noexcept { counters.deallocate(n * sizeof(T)); }
+
+  bool operator==(const arena_allocator&) const noexcept { return true; }
+  bool operator!=(const arena_allocator&) const noexcept { return false; }
+}; // struct arena_allocator
+
+template <std::size_t sizeN>
+struct blob {
+  unsigned char bytes[sizeN];
+}; // struct blob
+
+constexpr std::size_t blob_sizes[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+constexpr std::size_t blob_count   = sizeof(blob_sizes) / sizeof(blob_sizes[0]);
+
+std::uint8_t blob_bucket(std::uint32_t value_size) {
+  std::size_t bucket = 0;
+  while(bucket + 1 < blob_count && blob_sizes[bucket] < value_size) ++bucket;
+  return bucket;
+}
+
+// A trace record with objects renumbered densely per blob size.
+struct step {
+  std::uint32_t object;
+  std::uint32_t other;
+  std::uint32_t size_before;
+  std::uint32_t size_after;
+  std::uint32_t arg;
+  jacl::trace::op op;
+  std::uint8_t bucket;
+}; // struct step
+
+struct program {
+  std::vector<step> steps;
+  std::size_t objects[blob_count]{};
+  std::size_t max_insert{};
+}; // struct program
+
+// Renumbers objects and materializes vectors that were live when the trace
+// started, so that replay only indexes arrays.
+program compile(const jacl::trace::trace_data& trace, long type_filter) {
+  program prog;
+  std::unordered_map<std::uint64_t, std::uint32_t> live;
+
+  auto make = [&](std::uint64_t address, std::uint8_t bucket, std::uint32_t size) {
+    const auto id = static_cast<std::uint32_t>(prog.objects[bucket]++);
+    live[address] = id;
+    if(size != 0) {
+      prog.steps.push_back(step{id, 0, 0, size, 0, jacl::trace::op::resize, bucket});
+    }
+    return id;
+  };
+
+  auto lookup = [&](std::uint64_t address, std::uint8_t bucket, std::uint32_t size) {
+    auto it = live.find(address);
+    return it != live.end() ? it->second : make(address, bucket, size);
+  };
+
+  for(const auto& r : trace.records) {
+    if(type_filter >= 0 && r.type != type_filter) continue;
+    const auto bucket = blob_bucket(trace.types[r.type].value_size);
+    const auto op     = static_cast<jacl::trace::op>(r.op);
+
+    step s{0, 0, r.size_before, r.size_after, r.arg, op, bucket};
+    switch(op) {
+    case jacl::trace::op::construct:
+    case jacl::trace::op::copy_construct:
+    case jacl::trace::op::move_construct:
+      if(op != jacl::trace::op::construct) s.other = lookup(r.other, bucket, r.size_after);
+      s.object = make(r.object, bucket, 0);
+      break;
+    case jacl::trace::op::copy_assign:
+    case jacl::trace::op::move_assign:
+      s.other  = lookup(r.other, bucket, r.size_after);
+      s.object = lookup(r.object, bucket, r.size_before);
+      break;
+    case jacl::trace::op::swap:
+      s.other  = lookup(r.other, bucket, r.size_after);
+      s.object = lookup(r.object, bucket, r.size_before);
+      break;
+    default: s.object = lookup(r.object, bucket, r.size_before); break;
+    }
+    if(op == jacl::trace::op::insert && r.size_after > r.size_before) {
+      prog.max_insert = std::max<std::size_t>(prog.max_insert, r.size_after - r.size_before);
+    }
+    prog.steps.push_back(s);
+    if(op == jacl::trace::op::destroy) live.erase(r.object);
+  }
+  return prog;
+}
+
+template <template <typename> class containerOf>
+class replayer {
+public:
+  replayer(const program& prog, bool doubling) :
+      prog_{prog}, doubling_{doubling}, scratch_(prog.max_insert * blob_sizes[blob_count - 1]) {}
+
+  // Returns the number of steps whose resulting size differs from the trace.
+  std::size_t run(bool verify) {
+    return run(verify, std::make_index_sequence<blob_count>{});
+  }
+
+private:
+  template <std::size_t bucketN>
+  using pool = std::vector<containerOf<blob<blob_sizes[bucketN]>>>;
+
+  template <std::size_t... bucketN>
+  std::size_t run(bool verify, std::index_sequence<bucketN...>) {
+    std::tuple<pool<bucketN>...> pools{pool<bucketN>(prog_.objects[bucketN])...};
+    std::size_t diverged = 0;
+    for(const step& s : prog_.steps) {
+      // Selects the pool of the step's blob size.
+      static_cast<void>(((s.bucket == bucketN &&
+                             (diverged += execute(std::get<bucketN>(pools), s, verify), true)) ||
+                         ...));
+    }
+    jacl::bench::do_not_optimize(pools);
+    return diverged;
+  }
+
+  template <typename containerT>
+  void grow_for(containerT& c, std::size_t extra) {
+    if(doubling_ && c.size() + extra > c.capacity()) {
+      c.reserve(std::max<std::size_t>(2 * c.capacity(), c.size() + extra));
+    }
+  }
+
+  template <typename containerT>
+  std::size_t execute(std::vector<containerT>& pool, const step& s, bool verify) {
+    using value_type = typename containerT::value_type;
+    containerT& c    = pool[s.object];
+
+    switch(s.op) {
+    case jacl::trace::op::construct:
+    case jacl::trace::op::resize: c.resize(s.size_after); break;
+    case jacl::trace::op::copy_construct:
+    case jacl::trace::op::copy_assign: c = pool[s.other]; break;
+    case jacl::trace::op::move_construct:
+    case jacl::trace::op::move_assign: c = std::move(pool[s.other]); break;
+    case jacl::trace::op::destroy:
+      c.clear();
+      c.shrink_to_fit();
+      return 0;
+    case jacl::trace::op::assign: c.assign(s.size_after, value_type{}); break;
+    case jacl::trace::op::emplace_back:
+      grow_for(c, 1);
+      c.emplace_back();
+      break;
+    case jacl::trace::op::pop_back:
+      if(!c.empty()) c.pop_back();
+      break;
+    case jacl::trace::op::insert: {
+      const std::size_t n   = s.size_after - std::min(s.size_after, s.size_before);
+      const std::size_t pos = std::min<std::size_t>(s.arg, c.size());
+      grow_for(c, n);
+      if(n == 1) {
+        c.emplace(c.begin() + pos);
+      } else {
+        const auto* first = reinterpret_cast<const value_type*>(scratch_.data());
+        c.insert(c.begin() + pos, first, first + n);
+      }
+      break;
+    }
+    case jacl::trace::op::erase: {
+      const std::size_t pos = std::min<std::size_t>(s.arg, c.size());
+      const std::size_t n   = std::min<std::size_t>(
+          s.size_before - std::min(s.size_before, s.size_after), c.size() - pos);
+      c.erase(c.begin() + pos, c.begin() + pos + n);
+      break;
+    }
+    case jacl::trace::op::clear: c.clear(); break;
+    case jacl::trace::op::reserve: c.reserve(s.arg); break;
+    case jacl::trace::op::shrink_to_fit: c.shrink_to_fit(); break;
+    case jacl::trace::op::swap: c.swap(pool[s.other]); break;
+    }
+    return verify && c.size() != s.size_after ? 1 : 0;
+  }
+
+  const program& prog_;
+  bool doubling_;
+  // Source of blobs for range insertion; blobs have no alignment requirement.
+  std::vector<unsigned char> scratch_;
+}; // class replayer
+
+struct result {
+  std::string name;
+  double median_ms{};
+  double min_ms{};
+  allocation_counters allocations;
+  std::size_t diverged{};
+}; // struct result
+
+template <template <typename> class containerOf>
+result measure(const std::string& name, const program& prog, bool doubling, std::size_t repetitions,
+    bool uses_arena) {
+  replayer<containerOf> r{prog, doubling};
+
+  result res;
+  res.name = name;
+  counters = allocation_counters{};
+  res.diverged = r.run(true);
+  res.allocations = counters;
+  if(uses_arena) arena::instance().reset();
+
+  std::vector<double> times;
+  for(std::size_t i = 0; i < repetitions; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    r.run(false);
+    const auto stop = std::chrono::steady_clock::now();
+    times.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+    if(uses_arena) arena::instance().reset();
+  }
+  std::sort(times.begin(), times.end());
+  res.median_ms = times[times.size() / 2];
+  res.min_ms    = times.front();
+  return res;
+}
+
+template <std::size_t sizeN, template <typename> class allocOf>
+struct small_vector_of {
+  template <typename T>
+  using type = jacl::small_vector<T, sizeN, allocOf<T>>;
+}; // struct small_vector_of
+
+template <template <typename> class allocOf>
+struct std_vector_of {
+  template <typename T>
+  using type = std::vector<T, allocOf<T>>;
+}; // struct std_vector_of
+
+struct configuration {
+  std::string name;
+  result (*measure)(const std::string&, const program&, bool, std::size_t, bool);
+  bool arena;
+}; // struct configuration
+
+template <template <typename> class allocOf>
+void add_configurations(std::vector<configuration>& configs, const char* allocator, bool arena) {
+  const std::string suffix = std::string{"/"} + allocator;
+  configs.push_back(
+      {"small_vector<1>" + suffix, &measure<small_vector_of<1, allocOf>::template type>, arena});
+  configs.push_back(
+      {"small_vector<2>" + suffix, &measure<small_vector_of<2, allocOf>::template type>, arena});
+  configs.push_back(
+      {"small_vector<4>" + suffix, &measure<small_vector_of<4, allocOf>::template type>, arena});
+  configs.push_back(
+      {"small_vector<8>" + suffix, &measure<small_vector_of<8, allocOf>::template type>, arena});
+  configs.push_back(
+      {"small_vector<16>" + suffix, &measure<small_vector_of<16, allocOf>::template type>, arena});
+  configs.push_back(
+      {"small_vector<32>" + suffix, &measure<small_vector_of<32, allocOf>::template type>, arena});
+  configs.push_back(
+      {"std::vector" + suffix, &measure<std_vector_of<allocOf>::template type>, arena});
+}
+
+struct options {
+  std::string trace;
+  long type{-1};
+  std::size_t repetitions{5};
+  std::string json;
+}; // struct options
+
+bool parse_flag(const char* arg, const char* flag, std::string& value) {
+  const std::size_t len = std::strlen(flag);
+  if(std::strncmp(arg, flag, len) != 0 || arg[len] != '=') return false;
+  value = arg + len + 1;
+  return true;
+}
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for(int i = 1; i < argc; ++i) {
+    std::string value;
+    if(parse_flag(argv[i], "--type", value)) {
+      opts.type = std::strtol(value.c_str(), nullptr, 10);
+    } else if(parse_flag(argv[i], "--repetitions", value)) {
+      opts.repetitions = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+    } else if(parse_flag(argv[i], "--json", value)) {
+      opts.json = value;
+    } else if(argv[i][0] != '-' && opts.trace.empty()) {
+      opts.trace = argv[i];
+    } else {
+      opts.trace.clear();
+      break;
+    }
+  }
+  if(opts.trace.empty()) {
+    std::fprintf(stderr,
+        "usage: %s <trace> [--type=<id>] [--repetitions=<n>] [--json=<file>|-]\n", argv[0]);
+    std::exit(2);
+  }
+  return opts;
+}
+
+std::string json_escape(const std::string& s) {
+  std::string out;
+  for(char c : s) {
+    if(c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+void write_json(std::ostream& out, const std::vector<result>& results, const options& opts,
+    const program& prog) {
+  out << "{\n  \"context\": {\n";
+  out << "    \"trace\": \"" << json_escape(opts.trace) << "\",\n";
+  out << "    \"steps\": " << prog.steps.size() << ",\n";
+  out << "    \"repetitions\": " << opts.repetitions << "\n";
+  out << "  },\n  \"configurations\": [";
+  for(std::size_t i = 0; i < results.size(); ++i) {
+    const auto& r = results[i];
+    out << (i ? ",\n" : "\n") << "    {\n";
+    out << "      \"name\": \"" << json_escape(r.name) << "\",\n";
+    out << "      \"median_ms\": " << r.median_ms << ",\n";
+    out << "      \"min_ms\": " << r.min_ms << ",\n";
+    out << "      \"allocations\": " << r.allocations.allocations << ",\n";
+    out << "      \"allocated_bytes\": " << r.allocations.bytes << ",\n";
+    out << "      \"peak_bytes\": " << r.allocations.peak_bytes << ",\n";
+    out << "      \"diverged_steps\": " << r.diverged << "\n";
+    out << "    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void print_summary(const jacl::trace::trace_data& trace, const program& prog) {
+  std::vector<std::size_t> records(trace.types.size());
+  std::vector<std::size_t> heap(trace.types.size());
+  std::vector<std::uint32_t> max_size(trace.types.size());
+  for(const auto& r : trace.records) {
+    ++records[r.type];
+    if(r.flags & jacl::trace::flag_heap) ++heap[r.type];
+    max_size[r.type] = std::max(max_size[r.type], r.size_after);
+  }
+
+  std::printf("%zu records, %zu replay steps\n", trace.records.size(), prog.steps.size());
+  std::printf("%-4s %-40s %6s %6s %10s %8s %8s\n", "id", "type", "value", "N", "records", "heap%",
+      "max size");
+  for(const auto& t : trace.types) {
+    const double heap_pct = records[t.id] ? 100.0 * heap[t.id] / records[t.id] : 0.0;
+    std::printf("%-4u %-40.40s %6u %6u %10zu %8.1f %8u\n", t.id, t.name.c_str(), t.value_size,
+        t.inline_size, records[t.id], heap_pct, max_size[t.id]);
+  }
+  std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const options opts = parse_options(argc, argv);
+
+  jacl::trace::trace_data trace;
+  try {
+    trace = jacl::trace::read(opts.trace.c_str());
+  } catch(const std::exception& e) {
+    std::fprintf(stderr, "%s: %s\n", opts.trace.c_str(), e.what());
+    return 1;
+  }
+  if(opts.type >= static_cast<long>(trace.types.size())) {
+    std::fprintf(stderr, "%s: no type with id %ld\n", opts.trace.c_str(), opts.type);
+    return 1;
+  }
+
+  const program prog = compile(trace, opts.type);
+  const bool table   = opts.json != "-";
+  if(table) print_summary(trace, prog);
+
+  std::vector<configuration> configs;
+  add_configurations<counting_allocator>(configs, "heap", false);
+  add_configurations<arena_allocator>(configs, "arena", true);
+
+  if(table) {
+    std::printf("%-40s %12s %12s %12s %14s %12s %9s\n", "configuration", "median ms", "min ms",
+        "allocations", "bytes", "peak bytes", "diverged");
+  }
+
+  std::vector<result> results;
+  for(const auto& config : configs) {
+    for(const bool doubling : {false, true}) {
+      const std::string name = config.name + (doubling ? "/grow2x" : "/default");
+      results.push_back(config.measure(name, prog, doubling, opts.repetitions, config.arena));
+      if(table) {
+        const auto& r = results.back();
+        std::printf("%-40s %12.3f %12.3f %12llu %14llu %12llu %9zu\n", r.name.c_str(), r.median_ms,
+            r.min_ms, static_cast<unsigned long long>(r.allocations.allocations),
+            static_cast<unsigned long long>(r.allocations.bytes),
+            static_cast<unsigned long long>(r.allocations.peak_bytes), r.diverged);
+        std::fflush(stdout);
+      }
+    }
+  }
+
+  if(opts.json == "-") {
+    write_json(std::cout, results, opts, prog);
+  } else if(!opts.json.empty()) {
+    std::ofstream out{opts.json};
+    write_json(out, results, opts, prog);
+    if(!out) {
+      std::fprintf(stderr, "failed to write %s\n", opts.json.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
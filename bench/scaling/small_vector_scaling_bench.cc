@@ -0,0 +1,385 @@
+// Multi-threaded spill benchmark: every thread repeatedly builds a batch of
+// small_vectors, grows them past the inline capacity and destroys them, so
+// nearly every unit of work allocates and frees heap buffers.
+//
+// Usage: small_vector_scaling_bench [--threads=<max>] [--min-time=<seconds>]
+//                                   [--repetitions=<n>] [--json=<file>|-]
+//
+// Each allocator is run on 1, 2, 4, ... threads up to --threads (by default
+// the number of hardware threads) and reported as throughput, speedup over one
+// thread, and scaling efficiency (speedup / threads). The pool allocator also
+// reports how often its lock was contended.
+
+#include "../micro/bench.hh"
+
+#include "jacl/small_vector.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define JACL_BENCH_HAS_PMR 1
+#endif
+#endif
+#if !defined(JACL_BENCH_HAS_PMR)
+#define JACL_BENCH_HAS_PMR 0
+#endif // !defined(JACL_BENCH_HAS_PMR)
+
+namespace {
+
+constexpr std::size_t inline_capacity = 8;
+constexpr std::size_t batch_size      = 16;
+
+// Sizes in [inline_capacity / 2, 8 * inline_capacity), so most vectors spill
+// and some reallocate several times.
+std::size_t target_size(std::uint32_t& seed) {
+  seed = seed * 1664525u + 1013904223u;
+  return inline_capacity / 2 + (seed >> 8) % (8 * inline_capacity - inline_capacity / 2);
+}
+
+// A central pool of power-of-two size classes behind one mutex, as used by
+// allocators without per-thread caches.
+class central_pool {
+public:
+  static central_pool& instance() {
+    static central_pool pool;
+    return pool;
+  }
+
+  ~central_pool() {
+    for(auto& list : free_) {
+      for(void* p : list) ::operator delete(p);
+    }
+  }
+
+  void* allocate(std::size_t bytes) {
+    const std::size_t cls = size_class(bytes);
+    lock();
+    void* p = nullptr;
+    if(!free_[cls].empty()) {
+      p = free_[cls].back();
+      free_[cls].pop_back();
+    }
+    mutex_.unlock();
+    return p ? p : ::operator new(std::size_t{16} << cls);
+  }
+
+  void deallocate(void* p, std::size_t bytes) {
+    const std::size_t cls = size_class(bytes);
+    lock();
+    free_[cls].push_back(p);
+    mutex_.unlock();
+  }
+
+  /// @brief Returns the number of contended lock acquisitions and resets it.
+  std::uint64_t take_contended() { return contended_.exchange(0, std::memory_order_relaxed); }
+
+private:
+  static std::size_t size_class(std::size_t bytes) {
+    std::size_t cls = 0;
+    while((std::size_t{16} << cls) < bytes) ++cls;
+    return cls;
+  }
+
+  void lock() {
+    if(!mutex_.try_lock()) {
+      contended_.fetch_add(1, std::memory_order_relaxed);
+      mutex_.lock();
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<void*> free_[48];
+  std::atomic<std::uint64_t> contended_{0};
+}; // class central_pool
+
+template <typename T>
+struct pool_allocator {
+  using value_type = T;
+
+  pool_allocator() = default;
+  template <typename U>
+  pool_allocator(const pool_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(central_pool::instance().allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    central_pool::instance().deallocate(p, n * sizeof(T));
+  }
+
+  bool operator==(const pool_allocator&) const noexcept { return true; }
+  bool operator!=(const pool_allocator&) const noexcept { return false; }
+}; // struct pool_allocator
+
+// One unit of work: build a batch of vectors, grow each past the inline
+// capacity, then destroy the batch.
+template <typename vectorT, typename makeT>
+std::uint64_t run_batch(std::uint32_t& seed, makeT make) {
+  std::uint64_t sum = 0;
+  {
+    std::vector<vectorT> batch;
+    batch.reserve(batch_size);
+    for(std::size_t i = 0; i < batch_size; ++i) {
+      batch.push_back(make());
+      const std::size_t n = target_size(seed);
+      for(std::size_t k = 0; k < n; ++k) batch.back().push_back(static_cast<int>(k));
+      sum += batch.back().size();
+    }
+    jacl::bench::do_not_optimize(batch);
+  }
+  return sum;
+}
+
+struct allocator_case {
+  const char* name;
+  // Runs units until `stop` is set and returns the number of units.
+  std::uint64_t (*worker)(const std::atomic<bool>& stop);
+  bool reports_contention;
+}; // struct allocator_case
+
+template <typename makeBatchT>
+std::uint64_t run_until(const std::atomic<bool>& stop, makeBatchT run) {
+  std::uint64_t units = 0;
+  while(!stop.load(std::memory_order_relaxed)) {
+    run();
+    ++units;
+  }
+  return units;
+}
+
+std::uint32_t thread_seed() {
+  static std::atomic<std::uint32_t> next{1};
+  return next.fetch_add(0x9e3779b9u, std::memory_order_relaxed);
+}
+
+std::uint64_t std_allocator_worker(const std::atomic<bool>& stop) {
+  using vector = jacl::small_vector<int, inline_capacity>;
+  std::uint32_t seed = thread_seed();
+  return run_until(stop, [&] { return run_batch<vector>(seed, [] { return vector{}; }); });
+}
+
+std::uint64_t pool_allocator_worker(const std::atomic<bool>& stop) {
+  using vector = jacl::small_vector<int, inline_capacity, pool_allocator<int>>;
+  std::uint32_t seed = thread_seed();
+  return run_until(stop, [&] { return run_batch<vector>(seed, [] { return vector{}; }); });
+}
+
+#if JACL_BENCH_HAS_PMR
+
+std::uint64_t pmr_pool_worker(const std::atomic<bool>& stop) {
+  static std::pmr::synchronized_pool_resource shared;
+  using allocator = std::pmr::polymorphic_allocator<int>;
+  using vector    = jacl::small_vector<int, inline_capacity, allocator>;
+  std::uint32_t seed = thread_seed();
+  return run_until(
+      stop, [&] { return run_batch<vector>(seed, [] { return vector{allocator{&shared}}; }); });
+}
+
+// Each thread owns a monotonic arena that is released after every unit, so
+// frees cost nothing and threads never share allocator state.
+std::uint64_t pmr_arena_worker(const std::atomic<bool>& stop) {
+  using allocator = std::pmr::polymorphic_allocator<int>;
+  using vector    = jacl::small_vector<int, inline_capacity, allocator>;
+  std::unique_ptr<unsigned char[]> buffer{new unsigned char[std::size_t{64} << 10]};
+  std::pmr::monotonic_buffer_resource arena{buffer.get(), std::size_t{64} << 10};
+  std::uint32_t seed = thread_seed();
+  return run_until(stop, [&] {
+    const auto sum = run_batch<vector>(seed, [&] { return vector{allocator{&arena}}; });
+    arena.release();
+    return sum;
+  });
+}
+
+#endif // JACL_BENCH_HAS_PMR
+
+const allocator_case allocator_cases[] = {
+    {"std::allocator", &std_allocator_worker, false},
+    {"central_pool", &pool_allocator_worker, true},
+#if JACL_BENCH_HAS_PMR
+    {"pmr::synchronized_pool", &pmr_pool_worker, false},
+    {"pmr::monotonic_arena", &pmr_arena_worker, false},
+#endif // JACL_BENCH_HAS_PMR
+};
+
+struct measurement {
+  double units_per_second;
+  double contended_per_unit;
+}; // struct measurement
+
+measurement measure(const allocator_case& c, std::size_t threads, double min_time) {
+  std::atomic<bool> stop{false};
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::uint64_t> units(threads);
+  std::vector<std::thread> pool;
+  for(std::size_t t = 0; t < threads; ++t) {
+    pool.emplace_back([&, t] {
+      ready.fetch_add(1);
+      while(!go.load()) std::this_thread::yield();
+      units[t] = c.worker(stop);
+    });
+  }
+  while(ready.load() != threads) std::this_thread::yield();
+
+  central_pool::instance().take_contended();
+  const auto start = std::chrono::steady_clock::now();
+  go.store(true);
+  std::this_thread::sleep_for(std::chrono::duration<double>(min_time));
+  stop.store(true);
+  for(auto& t : pool) t.join();
+  const auto stop_time = std::chrono::steady_clock::now();
+
+  std::uint64_t total = 0;
+  for(auto u : units) total += u;
+  const double seconds = std::chrono::duration<double>(stop_time - start).count();
+  const auto contended = central_pool::instance().take_contended();
+  return measurement{total / seconds, total ? static_cast<double>(contended) / total : 0.0};
+}
+
+struct result {
+  std::string allocator;
+  std::size_t threads;
+  double units_per_second;
+  double speedup;
+  double efficiency;
+  double contended_per_unit;
+  bool reports_contention;
+}; // struct result
+
+struct options {
+  std::size_t threads{std::max(1u, std::thread::hardware_concurrency())};
+  double min_time{0.2};
+  std::size_t repetitions{3};
+  std::string json;
+}; // struct options
+
+bool parse_flag(const char* arg, const char* flag, std::string& value) {
+  const std::size_t len = std::strlen(flag);
+  if(std::strncmp(arg, flag, len) != 0 || arg[len] != '=') return false;
+  value = arg + len + 1;
+  return true;
+}
+
+options parse_options(int argc, char** argv) {
+  options opts;
+  for(int i = 1; i < argc; ++i) {
+    std::string value;
+    if(parse_flag(argv[i], "--threads", value)) {
+      opts.threads = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+    } else if(parse_flag(argv[i], "--min-time", value)) {
+      opts.min_time = std::strtod(value.c_str(), nullptr);
+    } else if(parse_flag(argv[i], "--repetitions", value)) {
+      opts.repetitions = std::max<std::size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+    } else if(parse_flag(argv[i], "--json", value)) {
+      opts.json = value;
+    } else {
+      std::fprintf(stderr,
+          "usage: %s [--threads=<max>] [--min-time=<seconds>] [--repetitions=<n>] "
+          "[--json=<file>|-]\n",
+          argv[0]);
+      std::exit(2);
+    }
+  }
+  return opts;
+}
+
+std::vector<std::size_t> thread_counts(std::size_t max) {
+  std::vector<std::size_t> counts;
+  for(std::size_t n = 1; n < max; n *= 2) counts.push_back(n);
+  counts.push_back(max);
+  return counts;
+}
+
+void write_json(std::ostream& out, const std::vector<result>& results, const options& opts) {
+  out << "{\n  \"context\": {\n";
+  out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+  out << "    \"inline_capacity\": " << inline_capacity << ",\n";
+  out << "    \"batch_size\": " << batch_size << ",\n";
+  out << "    \"min_time\": " << opts.min_time << ",\n";
+  out << "    \"repetitions\": " << opts.repetitions << "\n";
+  out << "  },\n  \"benchmarks\": [";
+  for(std::size_t i = 0; i < results.size(); ++i) {
+    const auto& r = results[i];
+    out << (i ? ",\n" : "\n") << "    {\n";
+    out << "      \"allocator\": \"" << r.allocator << "\",\n";
+    out << "      \"threads\": " << r.threads << ",\n";
+    out << "      \"units_per_second\": " << r.units_per_second << ",\n";
+    out << "      \"speedup\": " << r.speedup << ",\n";
+    out << "      \"efficiency\": " << r.efficiency;
+    if(r.reports_contention) out << ",\n      \"contended_per_unit\": " << r.contended_per_unit;
+    out << "\n    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const options opts = parse_options(argc, argv);
+  const bool table   = opts.json != "-";
+
+  if(table) {
+    std::printf("%-24s %8s %14s %9s %11s %15s\n", "allocator", "threads", "units/s", "speedup",
+        "efficiency", "contended/unit");
+  }
+
+  std::vector<result> results;
+  for(const auto& c : allocator_cases) {
+    double single = 0;
+    for(std::size_t threads : thread_counts(opts.threads)) {
+      std::vector<measurement> reps;
+      for(std::size_t rep = 0; rep < opts.repetitions; ++rep) {
+        reps.push_back(measure(c, threads, opts.min_time));
+      }
+      std::sort(reps.begin(), reps.end(), [](const measurement& l, const measurement& r) {
+        return l.units_per_second < r.units_per_second;
+      });
+      const measurement& m = reps[reps.size() / 2];
+      if(threads == 1) single = m.units_per_second;
+
+      const double speedup = single > 0 ? m.units_per_second / single : 0.0;
+      results.push_back(result{c.name, threads, m.units_per_second, speedup, speedup / threads,
+          m.contended_per_unit, c.reports_contention});
+      if(table) {
+        std::printf("%-24s %8zu %14.4g %9.2f %11.2f", c.name, threads, m.units_per_second, speedup,
+            speedup / threads);
+        if(c.reports_contention) {
+          std::printf(" %15.4f\n", m.contended_per_unit);
+        } else {
+          std::printf(" %15s\n", "-");
+        }
+        std::fflush(stdout);
+      }
+    }
+  }
+
+  if(opts.json == "-") {
+    write_json(std::cout, results, opts);
+  } else if(!opts.json.empty()) {
+    std::ofstream out{opts.json};
+    write_json(out, results, opts);
+    if(!out) {
+      std::fprintf(stderr, "failed to write %s\n", opts.json.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <utility>
+
+namespace jacl {
+
+/**
+ * @brief A small vector that is sorted on demand.
+ *
+ * `lazy_sorted_small_vector` wraps a `small_vector` and tracks the length of
+ * its sorted prefix. Appends go to an unsorted tail. The first read after an
+ * append sorts the tail, then merges it into the prefix from the back, using
+ * the spare capacity past the end as the merge buffer. An append-then-query
+ * cycle of `k` elements on `n` thus costs O(k log k + n) instead of the
+ * O(n log n) of sorting everything, and elements of the prefix below the
+ * smallest appended one do not move at all.
+ *
+ * Reads are `const` but may sort, so a vector with an unsorted tail must not
+ * be read from several threads at once. `sort()` first makes concurrent
+ * reads safe.
+ *
+ * @tparam valueT The type of the elements.
+ * @tparam sizeN The static capacity of the underlying small vector.
+ * @tparam compareT The strict weak ordering of the elements.
+ * @tparam allocT The allocator type of the underlying small vector.
+ */
+template <typename valueT, size_t sizeN, typename compareT = std::less<valueT>,
+    typename allocT = std::allocator<valueT>>
+class lazy_sorted_small_vector {
+  using vector_type = small_vector<valueT, sizeN, allocT>;
+
+public:
+  using value_type             = typename vector_type::value_type;
+  using allocator_type         = typename vector_type::allocator_type;
+  using const_reference        = typename vector_type::const_reference;
+  using size_type              = typename vector_type::size_type;
+  using difference_type        = typename vector_type::difference_type;
+  using const_pointer          = typename vector_type::const_pointer;
+  using const_iterator         = typename vector_type::const_iterator;
+  using const_reverse_iterator = typename vector_type::const_reverse_iterator;
+  using value_compare          = compareT;
+
+#if __cplusplus >= 201703L
+  static constexpr size_type static_capacity = sizeN;
+#else
+  enum { static_capacity = sizeN };
+#endif // __cplusplus >= 201703L
+
+  lazy_sorted_small_vector() = default;
+
+  explicit lazy_sorted_small_vector(
+      const compareT& comp, const allocator_type& a = allocator_type{})
+      : data_{a}, comp_{comp} {}
+
+  lazy_sorted_small_vector(std::initializer_list<value_type> il, const compareT& comp = compareT{})
+      : data_{il}, comp_{comp} {}
+
+  /**
+   * @brief The underlying vector, sorted.
+   */
+  const vector_type& get() const {
+    sort();
+    return data_;
+  }
+
+  const allocator_type& get_allocator() const noexcept { return data_.get_allocator(); }
+  value_compare value_comp() const { return comp_; }
+
+  size_type size() const noexcept { return data_.size(); }
+  size_type capacity() const noexcept { return data_.capacity(); }
+  bool empty() const noexcept { return data_.empty(); }
+  void reserve(size_type n) { data_.reserve(n); }
+
+  /// @brief Whether no element was appended since the last sort.
+  bool is_sorted() const noexcept { return sorted_ == data_.size(); }
+
+  /// @brief The number of elements appended since the last sort.
+  size_type unsorted_size() const noexcept { return data_.size() - sorted_; }
+
+  void push_back(const value_type& x) { data_.push_back(x); }
+  void push_back(value_type&& x) { data_.push_back(std::move(x)); }
+  template <class... Args>
+  void emplace_back(Args&&... args) {
+    data_.emplace_back(std::forward<Args>(args)...);
+  }
+
+  template <typename iterT>
+  void append(iterT first, iterT last) {
+    data_.insert(data_.end(), first, last);
+  }
+
+  /**
+   * @brief Removes the element at `pos`, which must come from a read since the
+   * last append.
+   */
+  const_iterator erase(const_iterator pos) {
+    sort();
+    const_iterator result = data_.erase(pos);
+    sorted_               = data_.size();
+    return result;
+  }
+
+  const_iterator erase(const_iterator first, const_iterator last) {
+    sort();
+    const_iterator result = data_.erase(first, last);
+    sorted_               = data_.size();
+    return result;
+  }
+
+  void clear() noexcept {
+    data_.clear();
+    sorted_ = 0;
+  }
+
+  const_iterator begin() const {
+    sort();
+    return data_.cbegin();
+  }
+  const_iterator end() const {
+    sort();
+    return data_.cend();
+  }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+  const_reverse_iterator rbegin() const { return const_reverse_iterator{end()}; }
+  const_reverse_iterator rend() const { return const_reverse_iterator{begin()}; }
+
+  const_reference operator[](size_type n) const {
+    sort();
+    return data_[n];
+  }
+  const_reference at(size_type n) const {
+    sort();
+    return data_.at(n);
+  }
+  const_reference front() const {
+    sort();
+    return data_.front();
+  }
+  const_reference back() const {
+    sort();
+    return data_.back();
+  }
+  const_pointer data() const {
+    sort();
+    return data_.data();
+  }
+
+  template <typename keyT>
+  const_iterator lower_bound(const keyT& key) const {
+    return std::lower_bound(begin(), end(), key, comp_);
+  }
+
+  template <typename keyT>
+  const_iterator upper_bound(const keyT& key) const {
+    return std::upper_bound(begin(), end(), key, comp_);
+  }
+
+  template <typename keyT>
+  std::pair<const_iterator, const_iterator> equal_range(const keyT& key) const {
+    return std::equal_range(begin(), end(), key, comp_);
+  }
+
+  template <typename keyT>
+  bool contains(const keyT& key) const {
+    return std::binary_search(begin(), end(), key, comp_);
+  }
+
+  /**
+   * @brief Sorts the elements appended since the last sort and merges them
+   * into the sorted prefix. Equal elements keep their order of insertion.
+   *
+   * @complexity O(k log k + n) for `k` appended elements out of `n`.
+   */
+  void sort() const {
+    const size_type n = data_.size();
+    if(sorted_ == n) return;
+
+    const auto tail = data_.begin() + sorted_;
+    std::stable_sort(tail, data_.end(), comp_);
+    if(sorted_ != 0 && comp_(*tail, *(tail - 1))) merge_tail();
+    sorted_ = n;
+  }
+
+private:
+  // Moves the sorted tail past the end, then merges it and the prefix into
+  // place from the back.
+  void merge_tail() const {
+    const size_type n = data_.size();
+    const size_type k = n - sorted_;
+    if(data_.capacity() < n + k) data_.reserve(n + k);
+    for(size_type i = sorted_; i < n; ++i) data_.emplace_back(std::move(data_[i]));
+
+    size_type out = n;
+    size_type a   = sorted_;
+    size_type b   = n + k;
+    while(b != n) {
+      if(a != 0 && comp_(data_[b - 1], data_[a - 1])) {
+        data_[--out] = std::move(data_[--a]);
+      } else {
+        data_[--out] = std::move(data_[--b]);
+      }
+    }
+    data_.erase(data_.begin() + n, data_.end());
+  }
+
+  mutable vector_type data_;
+  mutable size_type sorted_{};
+  compareT comp_{};
+}; // class lazy_sorted_small_vector
+
+} // namespace jacl
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace jacl {
+
+/**
+ * @brief An allocator adaptor that keeps `paddingBytes` readable bytes after
+ * every buffer.
+ *
+ * Each allocation of `n` elements requests enough extra elements from
+ * `allocT` to cover `paddingBytes`. `small_vector` recognizes the
+ * `padding_bytes` member and pads its inline buffer the same way, so for a
+ * `small_vector<T, N, padded_allocator<T, P>>` the range
+ * `[data(), data() + capacity() + P bytes)` is always readable, inline or on the
+ * heap. SIMD kernels can then load whole vectors over the tail without
+ * bounds checks. The padding bytes hold unspecified values and must not be
+ * written.
+ *
+ * @tparam valueT The type of the elements.
+ * @tparam paddingBytes The number of readable bytes guaranteed past the capacity,
+ * e.g. 32 or 64 for AVX2 or AVX-512 loads.
+ * @tparam allocT The underlying allocator.
+ */
+template <typename valueT, std::size_t paddingBytes, typename allocT = std::allocator<valueT>>
+class padded_allocator : private allocT {
+  using base_traits = std::allocator_traits<allocT>;
+
+  static_assert(std::is_same<valueT, typename base_traits::value_type>::value,
+      "padded_allocator: valueT must be the same as the allocator's value_type");
+
+public:
+  using value_type      = valueT;
+  using pointer         = typename base_traits::pointer;
+  using const_pointer   = typename base_traits::const_pointer;
+  using size_type       = typename base_traits::size_type;
+  using difference_type = typename base_traits::difference_type;
+
+  using propagate_on_container_copy_assignment =
+      typename base_traits::propagate_on_container_copy_assignment;
+  using propagate_on_container_move_assignment =
+      typename base_traits::propagate_on_container_move_assignment;
+  using propagate_on_container_swap = typename base_traits::propagate_on_container_swap;
+  using is_always_equal             = typename std::is_empty<allocT>::type;
+
+  template <typename otherT>
+  struct rebind {
+    using other = padded_allocator<otherT, paddingBytes,
+        typename base_traits::template rebind_alloc<otherT>>;
+  }; // struct rebind
+
+  static constexpr std::size_t padding_bytes = paddingBytes;
+
+  /// @brief Whole elements added to every allocation to cover the padding.
+  static constexpr size_type padding_elements =
+      (paddingBytes + sizeof(value_type) - 1) / sizeof(value_type);
+
+  padded_allocator() = default;
+
+  padded_allocator(const allocT& a) noexcept(std::is_nothrow_copy_constructible<allocT>::value) :
+      allocT(a) {}
+
+  template <typename otherT, typename otherAllocT>
+  padded_allocator(const padded_allocator<otherT, paddingBytes, otherAllocT>& other) noexcept :
+      allocT(other.underlying()) {}
+
+  pointer allocate(size_type n) {
+    return base_traits::allocate(base(), n + size_type(padding_elements));
+  }
+
+  void deallocate(pointer p, size_type n) noexcept {
+    base_traits::deallocate(base(), p, n + size_type(padding_elements));
+  }
+
+  padded_allocator select_on_container_copy_construction() const {
+    return padded_allocator(base_traits::select_on_container_copy_construction(base()));
+  }
+
+  template <typename otherT, typename otherAllocT>
+  bool operator==(const padded_allocator<otherT, paddingBytes, otherAllocT>& other) const noexcept {
+    return underlying() == other.underlying();
+  }
+
+  template <typename otherT, typename otherAllocT>
+  bool operator!=(const padded_allocator<otherT, paddingBytes, otherAllocT>& other) const noexcept {
+    return !(*this == other);
+  }
+
+  /// @brief The adapted allocator.
+  const allocT& underlying() const noexcept { return *this; }
+
+private:
+  allocT& base() noexcept { return *this; }
+  const allocT& base() const noexcept { return *this; }
+}; // class padded_allocator
+
+#if __cplusplus < 201703L
+template <typename valueT, std::size_t paddingBytes, typename allocT>
+constexpr std::size_t padded_allocator<valueT, paddingBytes, allocT>::padding_bytes;
+
+template <typename valueT, std::size_t paddingBytes, typename allocT>
+constexpr typename padded_allocator<valueT, paddingBytes, allocT>::size_type
+    padded_allocator<valueT, paddingBytes, allocT>::padding_elements;
+#endif // __cplusplus < 201703L
+
+/**
+ * @brief A small_vector whose buffers stay readable for `paddingBytes` bytes
+ * past `data() + capacity()`.
+ */
+template <typename valueT, std::size_t sizeN, std::size_t paddingBytes = 64>
+using padded_small_vector = small_vector<valueT, sizeN, padded_allocator<valueT, paddingBytes>>;
+
+} // namespace jacl
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace jacl {
+
+/**
+ * @brief An immutable vector whose updates return new versions that share
+ * unchanged storage with the old ones.
+ *
+ * Up to `sizeN` elements are stored in a flat inline array, which every
+ * update copies. Larger vectors are stored in a radix tree of chunks of
+ * `2^bitsN` elements, with the last, possibly partial chunk kept apart as
+ * the tail. `push_back`, `pop_back` and `set` copy the tail or the path from
+ * the root to one chunk, O(log n) nodes, and share every other node with the
+ * original version. Element access walks the same path.
+ *
+ * Nodes are reference counted with `std::shared_ptr`, so versions may be read
+ * and updated from different threads concurrently.
+ *
+ * @tparam valueT The type of the elements.
+ * @tparam sizeN The number of elements stored inline.
+ * @tparam bitsN The log2 of the chunk size and of the tree's branching factor.
+ */
+template <typename valueT, size_t sizeN, unsigned bitsN = 5>
+class persistent_small_vector {
+  static_assert(sizeN > 0, "persistent_small_vector: sizeN must be greater than 0");
+  static_assert(bitsN > 0 && bitsN < 16, "persistent_small_vector: bitsN must be in [1, 16)");
+
+public:
+  using value_type      = valueT;
+  using size_type       = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using const_reference = const value_type&;
+  using const_pointer   = const value_type*;
+
+#if __cplusplus >= 201703L
+  static constexpr size_type static_capacity = sizeN;
+  static constexpr size_type chunk_size      = size_type(1) << bitsN;
+#else
+  enum : size_type { static_capacity = sizeN, chunk_size = size_type(1) << bitsN };
+#endif // __cplusplus >= 201703L
+
+  /// @brief Random access iterator over the elements of one version.
+  class const_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = valueT;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const valueT*;
+    using reference         = const valueT&;
+
+    const_iterator() = default;
+
+    reference operator*() const { return (*vec_)[i_]; }
+    pointer operator->() const { return &(*vec_)[i_]; }
+    reference operator[](difference_type n) const { return (*vec_)[i_ + n]; }
+
+    const_iterator& operator++() {
+      ++i_;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      ++i_;
+      return result;
+    }
+    const_iterator& operator--() {
+      --i_;
+      return *this;
+    }
+    const_iterator operator--(int) {
+      const_iterator result = *this;
+      --i_;
+      return result;
+    }
+    const_iterator& operator+=(difference_type n) {
+      i_ += n;
+      return *this;
+    }
+    const_iterator& operator-=(difference_type n) {
+      i_ -= n;
+      return *this;
+    }
+    friend const_iterator operator+(const_iterator it, difference_type n) { return it += n; }
+    friend const_iterator operator+(difference_type n, const_iterator it) { return it += n; }
+    friend const_iterator operator-(const_iterator it, difference_type n) { return it -= n; }
+    friend difference_type operator-(const const_iterator& a, const const_iterator& b) {
+      return difference_type(a.i_) - difference_type(b.i_);
+    }
+
+    friend bool operator==(const const_iterator& a, const const_iterator& b) {
+      return a.i_ == b.i_;
+    }
+    friend bool operator!=(const const_iterator& a, const const_iterator& b) {
+      return a.i_ != b.i_;
+    }
+    friend bool operator<(const const_iterator& a, const const_iterator& b) { return a.i_ < b.i_; }
+    friend bool operator>(const const_iterator& a, const const_iterator& b) { return a.i_ > b.i_; }
+    friend bool operator<=(const const_iterator& a, const const_iterator& b) {
+      return a.i_ <= b.i_;
+    }
+    friend bool operator>=(const const_iterator& a, const const_iterator& b) {
+      return a.i_ >= b.i_;
+    }
+
+  private:
+    friend class persistent_small_vector;
+
+    const_iterator(const persistent_small_vector* vec, size_type i) : vec_{vec}, i_{i} {}
+
+    const persistent_small_vector* vec_{};
+    size_type i_{};
+  }; // class const_iterator
+
+  using iterator               = const_iterator;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+  using reverse_iterator       = const_reverse_iterator;
+
+  persistent_small_vector() = default;
+
+  persistent_small_vector(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+
+  template <typename iterT,
+      typename = typename std::enable_if<std::is_base_of<std::input_iterator_tag,
+          typename std::iterator_traits<iterT>::iterator_category>::value>::type>
+  persistent_small_vector(iterT first, iterT last) {
+    assign(first, last);
+  }
+
+  size_type size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  /// @brief Whether the elements are stored in the inline array.
+  bool is_inline() const noexcept { return size_ <= sizeN; }
+
+  const_reference operator[](size_type i) const {
+    if(is_inline()) return flat_[i];
+    return (*leaf_for(i))[i & mask];
+  }
+
+  const_reference at(size_type i) const {
+    if(i >= size_) {
+#if !JACL_NO_EXCEPTIONS
+      throw std::out_of_range{"persistent_small_vector::at"};
+#else
+      std::abort();
+#endif // JACL_NO_EXCEPTIONS
+    }
+    return (*this)[i];
+  }
+
+  const_reference front() const { return (*this)[0]; }
+  const_reference back() const { return (*this)[size_ - 1]; }
+
+  const_iterator begin() const noexcept { return const_iterator{this, 0}; }
+  const_iterator end() const noexcept { return const_iterator{this, size_}; }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+  const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+  const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+  /**
+   * @brief Returns a version with `value` appended.
+   *
+   * @complexity O(log n) new nodes past the inline capacity.
+   */
+  persistent_small_vector push_back(value_type value) const {
+    persistent_small_vector result{*this};
+    result.append(std::move(value));
+    return result;
+  }
+
+  /**
+   * @brief Returns a version without the last element, which must exist.
+   *
+   * @complexity O(log n) new nodes past the inline capacity.
+   */
+  persistent_small_vector pop_back() const {
+    persistent_small_vector result{*this};
+    result.remove_last();
+    return result;
+  }
+
+  /**
+   * @brief Returns a version with the element at `i` replaced by `value`.
+   *
+   * @complexity O(log n) new nodes past the inline capacity.
+   */
+  persistent_small_vector set(size_type i, value_type value) const {
+    persistent_small_vector result{*this};
+    result.replace(i, std::move(value));
+    return result;
+  }
+
+  friend bool operator==(const persistent_small_vector& a, const persistent_small_vector& b) {
+    if(a.size_ != b.size_) return false;
+    for(size_type i = 0; i < a.size_; ++i) {
+      if(!(a[i] == b[i])) return false;
+    }
+    return true;
+  }
+
+  friend bool operator!=(const persistent_small_vector& a, const persistent_small_vector& b) {
+    return !(a == b);
+  }
+
+private:
+  static constexpr size_type mask = (size_type(1) << bitsN) - 1;
+
+  // Chunks hold 2^bitsN elements; all chunks in the tree are full.
+  using leaf     = small_vector<value_type, size_type(1) << bitsN>;
+  using leaf_ptr = std::shared_ptr<const leaf>;
+  // Children are inner nodes above level `bitsN` and chunks at it.
+  using node_ptr = std::shared_ptr<const void>;
+
+  struct inner {
+    small_vector<node_ptr, size_type(1) << bitsN> children;
+  }; // struct inner
+
+  using inner_ptr = std::shared_ptr<const inner>;
+
+  static const inner* as_inner(const node_ptr& p) noexcept {
+    return static_cast<const inner*>(p.get());
+  }
+  static const leaf* as_leaf(const node_ptr& p) noexcept {
+    return static_cast<const leaf*>(p.get());
+  }
+
+  size_type tail_offset() const noexcept { return size_ - tail_->size(); }
+
+  const leaf* leaf_for(size_type i) const noexcept {
+    if(i >= tail_offset()) return tail_.get();
+    const inner* node = root_.get();
+    for(unsigned level = shift_; level > bitsN; level -= bitsN) {
+      node = as_inner(node->children[(i >> level) & mask]);
+    }
+    return as_leaf(node->children[(i >> bitsN) & mask]);
+  }
+
+  leaf_ptr shared_leaf_for(size_type i) const {
+    const inner* node = root_.get();
+    for(unsigned level = shift_; level > bitsN; level -= bitsN) {
+      node = as_inner(node->children[(i >> level) & mask]);
+    }
+    return std::static_pointer_cast<const leaf>(node->children[(i >> bitsN) & mask]);
+  }
+
+  template <typename iterT>
+  void assign(iterT first, iterT last) {
+    for(; first != last && flat_.size() < sizeN; ++first) flat_.push_back(*first);
+    size_ = flat_.size();
+    for(; first != last; ++first) append(*first);
+  }
+
+  // Moves the inline elements into an empty tree.
+  void to_tree() {
+    root_  = std::make_shared<inner>();
+    shift_ = bitsN;
+    std::shared_ptr<leaf> chunk = std::make_shared<leaf>();
+    for(size_type i = 0; i < flat_.size(); ++i) {
+      if(chunk->size() == chunk_size) {
+        push_tail(std::move(chunk), i);
+        chunk = std::make_shared<leaf>();
+      }
+      chunk->push_back(std::move(flat_[i]));
+    }
+    tail_ = std::move(chunk);
+    flat_.clear();
+  }
+
+  // Copies the first `sizeN` elements back into the inline array.
+  void to_flat() {
+    for(size_type i = 0; i < sizeN; ++i) flat_.push_back((*this)[i]);
+    root_.reset();
+    tail_.reset();
+    shift_ = 0;
+  }
+
+  void append(value_type value) {
+    if(is_inline()) {
+      if(size_ < sizeN) {
+        flat_.push_back(std::move(value));
+        ++size_;
+        return;
+      }
+      to_tree();
+    }
+
+    std::shared_ptr<leaf> chunk;
+    if(tail_->size() < chunk_size) {
+      chunk = std::make_shared<leaf>(*tail_);
+    } else {
+      push_tail(std::move(tail_), size_);
+      chunk = std::make_shared<leaf>();
+    }
+    chunk->push_back(std::move(value));
+    tail_ = std::move(chunk);
+    ++size_;
+  }
+
+  // Adds the full chunk `tail` to the tree, which with it holds `count`
+  // elements.
+  void push_tail(leaf_ptr tail, size_type count) {
+    if((count >> bitsN) > (size_type(1) << shift_)) {
+      // The tree is full: add a level.
+      std::shared_ptr<inner> root = std::make_shared<inner>();
+      root->children.push_back(std::move(root_));
+      root->children.push_back(new_path(shift_, std::move(tail)));
+      root_ = std::move(root);
+      shift_ += bitsN;
+    } else {
+      root_ = push_tail(shift_, root_.get(), std::move(tail), count);
+    }
+  }
+
+  static inner_ptr push_tail(unsigned level, const inner* parent, leaf_ptr tail, size_type count) {
+    std::shared_ptr<inner> node = std::make_shared<inner>(*parent);
+    const size_type i           = ((count - 1) >> level) & mask;
+    node_ptr child;
+    if(level == bitsN) {
+      child = std::move(tail);
+    } else if(i < node->children.size()) {
+      child = push_tail(level - bitsN, as_inner(node->children[i]), std::move(tail), count);
+    } else {
+      child = new_path(level - bitsN, std::move(tail));
+    }
+    if(i < node->children.size()) {
+      node->children[i] = std::move(child);
+    } else {
+      node->children.push_back(std::move(child));
+    }
+    return node;
+  }
+
+  static node_ptr new_path(unsigned level, leaf_ptr tail) {
+    if(level == 0) return tail;
+    std::shared_ptr<inner> node = std::make_shared<inner>();
+    node->children.push_back(new_path(level - bitsN, std::move(tail)));
+    return node;
+  }
+
+  void remove_last() {
+    if(is_inline()) {
+      flat_.pop_back();
+    } else if(size_ == sizeN + 1) {
+      to_flat();
+    } else if(tail_->size() > 1) {
+      std::shared_ptr<leaf> chunk = std::make_shared<leaf>(*tail_);
+      chunk->pop_back();
+      tail_ = std::move(chunk);
+    } else {
+      // The tail empties: the last chunk of the tree becomes the tail.
+      leaf_ptr tail  = shared_leaf_for(size_ - 2);
+      inner_ptr root = pop_tail(shift_, root_.get(), size_);
+      if(!root) root = std::make_shared<inner>();
+      if(shift_ > bitsN && root->children.size() == 1) {
+        root = std::static_pointer_cast<const inner>(root->children[0]);
+        shift_ -= bitsN;
+      }
+      root_ = std::move(root);
+      tail_ = std::move(tail);
+    }
+    --size_;
+  }
+
+  // Removes the last chunk from the tree, which with the tail holds `count`
+  // elements. Returns null if the subtree becomes empty.
+  static inner_ptr pop_tail(unsigned level, const inner* node, size_type count) {
+    const size_type i = ((count - 2) >> level) & mask;
+    if(level > bitsN) {
+      inner_ptr child = pop_tail(level - bitsN, as_inner(node->children[i]), count);
+      if(!child && i == 0) return nullptr;
+      std::shared_ptr<inner> copy = std::make_shared<inner>(*node);
+      if(child) {
+        copy->children[i] = std::move(child);
+      } else {
+        copy->children.pop_back();
+      }
+      return copy;
+    }
+    if(i == 0) return nullptr;
+    std::shared_ptr<inner> copy = std::make_shared<inner>(*node);
+    copy->children.pop_back();
+    return copy;
+  }
+
+  void replace(size_type i, value_type value) {
+    if(is_inline()) {
+      flat_[i] = std::move(value);
+    } else if(i >= tail_offset()) {
+      std::shared_ptr<leaf> chunk = std::make_shared<leaf>(*tail_);
+      (*chunk)[i & mask]          = std::move(value);
+      tail_                       = std::move(chunk);
+    } else {
+      root_ = replace(shift_, root_.get(), i, std::move(value));
+    }
+  }
+
+  static inner_ptr replace(unsigned level, const inner* node, size_type i, value_type value) {
+    std::shared_ptr<inner> copy = std::make_shared<inner>(*node);
+    node_ptr& child             = copy->children[(i >> level) & mask];
+    if(level == bitsN) {
+      std::shared_ptr<leaf> chunk = std::make_shared<leaf>(*as_leaf(child));
+      (*chunk)[i & mask]          = std::move(value);
+      child                       = std::move(chunk);
+    } else {
+      child = replace(level - bitsN, as_inner(child), i, std::move(value));
+    }
+    return copy;
+  }
+
+  size_type size_{};
+  small_vector<value_type, sizeN> flat_; // The elements while size_ <= sizeN.
+  inner_ptr root_;                       // The full chunks while size_ > sizeN.
+  leaf_ptr tail_;                        // The last chunk while size_ > sizeN.
+  unsigned shift_{};                     // bitsN times the height of the tree.
+}; // class persistent_small_vector
+
+} // namespace jacl
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#ifndef JACL_PREFETCH_RANGE_DISTANCE
+// The number of elements `prefetch_range` looks ahead by default.
+#define JACL_PREFETCH_RANGE_DISTANCE 8
+#endif // JACL_PREFETCH_RANGE_DISTANCE
+
+namespace jacl {
+namespace internal {
+
+// Prefetches the first cache line of the heap buffer of `v`. An inline buffer
+// lies within `v` itself, which the iteration reaches in order.
+template <typename valueT, size_t sizeN, typename allocT>
+void prefetch_buffer(const small_vector<valueT, sizeN, allocT>& v) noexcept {
+  if(v.heap_bytes() != 0) JACL_PREFETCH(v.data());
+}
+
+} // namespace internal
+
+/**
+ * @brief A forward iterator over small vectors that prefetches the heap buffer
+ * of the vector a fixed distance ahead on every increment.
+ *
+ * @tparam iterT The underlying iterator, at least a forward iterator.
+ */
+template <typename iterT>
+class prefetch_iterator {
+  using traits = std::iterator_traits<iterT>;
+
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type        = typename traits::value_type;
+  using difference_type   = typename traits::difference_type;
+  using pointer           = typename traits::pointer;
+  using reference         = typename traits::reference;
+
+  prefetch_iterator() = default;
+
+  prefetch_iterator(iterT it, iterT ahead, iterT last) : it_{it}, ahead_{ahead}, last_{last} {}
+
+  /// @brief The underlying iterator to the current element.
+  const iterT& base() const noexcept { return it_; }
+
+  reference operator*() const { return *it_; }
+  pointer operator->() const { return std::addressof(*it_); }
+
+  prefetch_iterator& operator++() {
+    if(ahead_ != last_) {
+      internal::prefetch_buffer(*ahead_);
+      ++ahead_;
+    }
+    ++it_;
+    return *this;
+  }
+  prefetch_iterator operator++(int) {
+    prefetch_iterator result = *this;
+    ++*this;
+    return result;
+  }
+
+  friend bool operator==(const prefetch_iterator& a, const prefetch_iterator& b) {
+    return a.it_ == b.it_;
+  }
+  friend bool operator!=(const prefetch_iterator& a, const prefetch_iterator& b) {
+    return a.it_ != b.it_;
+  }
+
+private:
+  iterT it_{};
+  iterT ahead_{};
+  iterT last_{};
+}; // class prefetch_iterator
+
+/**
+ * @brief A view of a range of small vectors whose iteration prefetches the
+ * heap buffers of the vectors `distance` elements ahead; see `prefetch_range`.
+ *
+ * @tparam iterT The iterator of the underlying range.
+ */
+template <typename iterT>
+class prefetched_range {
+public:
+  using iterator = prefetch_iterator<iterT>;
+
+  prefetched_range(iterT first, iterT last, std::size_t distance)
+      : first_{first}, last_{last}, distance_{distance} {}
+
+  /// @brief Prefetches the buffers of the first `distance` vectors.
+  iterator begin() const {
+    iterT ahead = distance_ == 0 ? last_ : first_;
+    for(std::size_t i = 0; i < distance_ && ahead != last_; ++i, ++ahead) {
+      internal::prefetch_buffer(*ahead);
+    }
+    return {first_, ahead, last_};
+  }
+  iterator end() const { return {last_, last_, last_}; }
+
+private:
+  iterT first_;
+  iterT last_;
+  std::size_t distance_;
+}; // class prefetched_range
+
+/**
+ * @brief Adapts a range of small vectors, such as a
+ * `std::vector<small_vector<T, N>>`, so that iterating it prefetches the heap
+ * buffers of the vectors `distance` elements ahead of the current one.
+ *
+ * Each spilled vector keeps its elements in a separate allocation, and a scan
+ * that reads them takes a cache miss per vector. Prefetching ahead overlaps
+ * those misses with the work on the current vectors. Vectors whose elements
+ * are inline are skipped. The range must outlive the view.
+ *
+ * @param r The range of small vectors.
+ * @param distance The number of vectors to look ahead; 0 disables prefetching.
+ */
+template <typename rangeT>
+prefetched_range<decltype(std::begin(std::declval<rangeT&>()))> prefetch_range(
+    rangeT& r, std::size_t distance = JACL_PREFETCH_RANGE_DISTANCE) {
+  return {std::begin(r), std::end(r), distance};
+}
+
+} // namespace jacl
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace jacl {
+
+/**
+ * @brief Shrinks a vector once its size falls to `1 / shrinkRatioN` of its
+ * capacity, to `targetRatioN` times its size.
+ *
+ * The gap between the two ratios is the hysteresis: after a shrink the size
+ * must fall by another factor of `shrinkRatioN / targetRatioN` before the
+ * next shrink, or grow past the new capacity before the next reallocation,
+ * so alternating growth and removal cannot reallocate on every operation.
+ *
+ * @tparam shrinkRatioN Shrink when `size * shrinkRatioN <= capacity`.
+ * @tparam targetRatioN Shrink to a capacity of `size * targetRatioN`.
+ */
+template <std::size_t shrinkRatioN = 4, std::size_t targetRatioN = 2>
+struct hysteresis_shrink_policy {
+  static_assert(targetRatioN >= 1 && shrinkRatioN > targetRatioN,
+      "hysteresis_shrink_policy: shrinkRatioN must be greater than targetRatioN");
+
+  /**
+   * @brief The capacity to shrink to, or `capacity` to keep the buffer. A
+   * result of at most `inline_capacity` moves the elements back inline.
+   */
+  static std::size_t shrink_target(
+      std::size_t size, std::size_t capacity, std::size_t inline_capacity) noexcept {
+    if(capacity <= inline_capacity || size * shrinkRatioN > capacity) return capacity;
+    const std::size_t target = size * targetRatioN;
+    return target <= inline_capacity ? inline_capacity : target;
+  }
+}; // struct hysteresis_shrink_policy
+
+/**
+ * @brief A small vector that gives back heap memory as it empties.
+ *
+ * `shrinking_small_vector` wraps a `small_vector` and asks `shrinkPolicyT`
+ * after every `pop_back`, `erase`, `clear` and shrinking `resize` whether the
+ * heap buffer is too large for the remaining elements. If so, the elements
+ * move back to the inline buffer or to a smaller heap buffer. Long-lived
+ * vectors that once held many elements thus do not keep a large buffer
+ * forever.
+ *
+ * Vectors of element types that may throw when moved never shrink, and a
+ * shrink into a smaller heap buffer is skipped if the allocation fails, so
+ * removing elements never throws.
+ *
+ * @tparam valueT The type of the elements.
+ * @tparam sizeN The static capacity of the underlying small vector.
+ * @tparam shrinkPolicyT Provides `shrink_target(size, capacity, inline_capacity)`;
+ * see `hysteresis_shrink_policy`.
+ * @tparam allocT The allocator type of the underlying small vector.
+ */
+template <typename valueT, size_t sizeN, typename shrinkPolicyT = hysteresis_shrink_policy<>,
+    typename allocT = std::allocator<valueT>>
+class shrinking_small_vector {
+  using vector_type = small_vector<valueT, sizeN, allocT>;
+
+public:
+  using value_type             = typename vector_type::value_type;
+  using allocator_type         = typename vector_type::allocator_type;
+  using reference              = typename vector_type::reference;
+  using const_reference        = typename vector_type::const_reference;
+  using size_type              = typename vector_type::size_type;
+  using difference_type        = typename vector_type::difference_type;
+  using pointer                = typename vector_type::pointer;
+  using const_pointer          = typename vector_type::const_pointer;
+  using iterator               = typename vector_type::iterator;
+  using const_iterator         = typename vector_type::const_iterator;
+  using reverse_iterator       = typename vector_type::reverse_iterator;
+  using const_reverse_iterator = typename vector_type::const_reverse_iterator;
+  using shrink_policy          = shrinkPolicyT;
+
+#if __cplusplus >= 201703L
+  static constexpr size_type static_capacity = sizeN;
+#else
+  enum { static_capacity = sizeN };
+#endif // __cplusplus >= 201703L
+
+  shrinking_small_vector() = default;
+
+  explicit shrinking_small_vector(const allocator_type& a) : data_{a} {}
+
+  explicit shrinking_small_vector(vector_type v) : data_{std::move(v)} {}
+
+  shrinking_small_vector(std::initializer_list<value_type> il) : data_{il} {}
+
+  /**
+   * @brief The underlying vector.
+   */
+  const vector_type& get() const noexcept { return data_; }
+
+  const allocator_type& get_allocator() const noexcept { return data_.get_allocator(); }
+
+  iterator begin() noexcept { return data_.begin(); }
+  const_iterator begin() const noexcept { return data_.begin(); }
+  iterator end() noexcept { return data_.end(); }
+  const_iterator end() const noexcept { return data_.end(); }
+  const_iterator cbegin() const noexcept { return data_.cbegin(); }
+  const_iterator cend() const noexcept { return data_.cend(); }
+  reverse_iterator rbegin() noexcept { return data_.rbegin(); }
+  const_reverse_iterator rbegin() const noexcept { return data_.rbegin(); }
+  reverse_iterator rend() noexcept { return data_.rend(); }
+  const_reverse_iterator rend() const noexcept { return data_.rend(); }
+
+  size_type size() const noexcept { return data_.size(); }
+  size_type capacity() const noexcept { return data_.capacity(); }
+  bool empty() const noexcept { return data_.empty(); }
+  size_type heap_bytes() const noexcept { return data_.heap_bytes(); }
+
+  reference operator[](size_type n) { return data_[n]; }
+  const_reference operator[](size_type n) const { return data_[n]; }
+  reference at(size_type n) { return data_.at(n); }
+  const_reference at(size_type n) const { return data_.at(n); }
+
+  reference front() { return data_.front(); }
+  const_reference front() const { return data_.front(); }
+  reference back() { return data_.back(); }
+  const_reference back() const { return data_.back(); }
+
+  pointer data() noexcept { return data_.data(); }
+  const_pointer data() const noexcept { return data_.data(); }
+
+  void push_back(const value_type& x) { data_.push_back(x); }
+  void push_back(value_type&& x) { data_.push_back(std::move(x)); }
+  template <class... Args>
+  reference emplace_back(Args&&... args) {
+    return data_.emplace_back(std::forward<Args>(args)...);
+  }
+
+  void pop_back() {
+    data_.pop_back();
+    maybe_shrink();
+  }
+
+  template <typename... Args>
+  iterator emplace(const_iterator position, Args&&... args) {
+    return data_.emplace(position, std::forward<Args>(args)...);
+  }
+
+  iterator insert(const_iterator position, const value_type& value) {
+    return data_.emplace(position, value);
+  }
+  iterator insert(const_iterator position, value_type&& value) {
+    return data_.emplace(position, std::move(value));
+  }
+
+  template <typename iterT>
+  iterator insert(const_iterator position, iterT first, iterT last) {
+    return data_.insert(position, first, last);
+  }
+
+  iterator insert(const_iterator position, std::initializer_list<value_type> il) {
+    return data_.insert(position, il.begin(), il.end());
+  }
+
+  iterator erase(const_iterator position) { return erase(position, position + 1); }
+
+  /**
+   * @brief Erases `[first, last)`. If the vector shrinks, the returned
+   * iterator points into the new buffer.
+   */
+  iterator erase(const_iterator first, const_iterator last) {
+    const size_type offset = first - cbegin();
+    data_.erase(first, last);
+    maybe_shrink();
+    return begin() + offset;
+  }
+
+  void clear() noexcept {
+    data_.clear();
+    maybe_shrink();
+  }
+
+  void reserve(size_type sz) { data_.reserve(sz); }
+
+  /**
+   * @brief Releases the heap buffer if the elements fit inline, or else
+   * reallocates to the exact size, regardless of the policy.
+   */
+  void shrink_to_fit() noexcept { data_.shrink_to_fit(); }
+
+  void resize(size_type sz) {
+    data_.resize(sz);
+    maybe_shrink();
+  }
+
+  void resize(size_type sz, const value_type& value) {
+    data_.resize(sz, value);
+    maybe_shrink();
+  }
+
+  template <typename iterT>
+  void assign(iterT first, iterT last) {
+    data_.assign(first, last);
+    maybe_shrink();
+  }
+
+  void assign(size_type sz, const value_type& val) {
+    data_.assign(sz, val);
+    maybe_shrink();
+  }
+
+  void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+
+  void swap(shrinking_small_vector& other) noexcept(
+      noexcept(std::declval<vector_type&>().swap(std::declval<vector_type&>()))) {
+    data_.swap(other.data_);
+  }
+
+private:
+  void maybe_shrink() noexcept {
+    JACL_IF_CONSTEXPR(!std::is_nothrow_move_constructible<value_type>::value) { return; }
+
+    const size_type cap    = data_.capacity();
+    const size_type target = shrink_policy::shrink_target(data_.size(), cap, static_capacity);
+    if(JACL_LIKELY(target >= cap)) return;
+
+    if(target <= static_capacity) {
+      data_.shrink_to_fit();
+    } else {
+      reallocate(target);
+    }
+  }
+
+  void reallocate(size_type target) noexcept {
+    vector_type smaller{data_.get_allocator()};
+#if !JACL_NO_EXCEPTIONS
+    try {
+      smaller.reserve(target);
+    } catch(...) {
+      // Keeping the larger buffer is always safe.
+      return;
+    }
+#else
+    smaller.reserve(target);
+#endif // !JACL_NO_EXCEPTIONS
+    smaller.assign(std::make_move_iterator(data_.begin()), std::make_move_iterator(data_.end()));
+    data_.swap(smaller);
+  }
+
+  vector_type data_;
+}; // class shrinking_small_vector
+
+} // namespace jacl
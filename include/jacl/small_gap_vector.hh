@@ -0,0 +1,478 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace jacl {
+
+/**
+ * @brief A small vector with a movable gap for edits around a cursor.
+ *
+ * The buffer holds the elements before the gap at its start and the elements
+ * after the gap at its end; the slots in between are unconstructed. `insert`
+ * and `erase` first move the gap to the edited position, relocating only the
+ * elements between the old and the new position, then fill or widen the gap.
+ * Edits near the previous one are thus O(1) amortized instead of shifting the
+ * whole tail, at the cost of a branch on every indexed access. Like
+ * `small_vector`, up to `sizeN` elements are stored inline.
+ *
+ * The elements are contiguous in two spans, before and after the gap
+ * (`spans()`), or in one after `make_contiguous()`.
+ *
+ * Relocating elements must not throw, so `valueT` must be nothrow move
+ * constructible.
+ *
+ * @tparam valueT The type of the elements.
+ * @tparam sizeN The number of elements stored inline.
+ * @tparam allocT The allocator of the heap buffer.
+ */
+template <typename valueT, size_t sizeN, typename allocT = std::allocator<valueT>>
+class small_gap_vector : private allocT {
+  static_assert(sizeN > 0, "small_gap_vector: sizeN must be greater than 0");
+  static_assert(std::is_nothrow_move_constructible<valueT>::value,
+      "small_gap_vector: valueT must be nothrow move constructible");
+
+  using allocator_traits = std::allocator_traits<allocT>;
+
+  template <bool constN>
+  class basic_iterator {
+    using owner_type =
+        typename std::conditional<constN, const small_gap_vector, small_gap_vector>::type;
+
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = valueT;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = typename std::conditional<constN, const valueT*, valueT*>::type;
+    using reference         = typename std::conditional<constN, const valueT&, valueT&>::type;
+
+    basic_iterator() = default;
+
+    template <bool otherN, typename = typename std::enable_if<constN && !otherN>::type>
+    basic_iterator(const basic_iterator<otherN>& other) noexcept
+        : owner_{other.owner_}, i_{other.i_} {}
+
+    reference operator*() const { return (*owner_)[i_]; }
+    pointer operator->() const { return &(*owner_)[i_]; }
+    reference operator[](difference_type n) const { return (*owner_)[i_ + std::size_t(n)]; }
+
+    basic_iterator& operator++() noexcept {
+      ++i_;
+      return *this;
+    }
+    basic_iterator operator++(int) noexcept {
+      basic_iterator result = *this;
+      ++i_;
+      return result;
+    }
+    basic_iterator& operator--() noexcept {
+      --i_;
+      return *this;
+    }
+    basic_iterator operator--(int) noexcept {
+      basic_iterator result = *this;
+      --i_;
+      return result;
+    }
+    basic_iterator& operator+=(difference_type n) noexcept {
+      i_ += std::size_t(n);
+      return *this;
+    }
+    basic_iterator& operator-=(difference_type n) noexcept {
+      i_ -= std::size_t(n);
+      return *this;
+    }
+    friend basic_iterator operator+(basic_iterator it, difference_type n) noexcept {
+      return it += n;
+    }
+    friend basic_iterator operator+(difference_type n, basic_iterator it) noexcept {
+      return it += n;
+    }
+    friend basic_iterator operator-(basic_iterator it, difference_type n) noexcept {
+      return it -= n;
+    }
+    friend difference_type operator-(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return difference_type(a.i_) - difference_type(b.i_);
+    }
+
+    friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.i_ == b.i_;
+    }
+    friend bool operator!=(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.i_ != b.i_;
+    }
+    friend bool operator<(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.i_ < b.i_;
+    }
+    friend bool operator>(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.i_ > b.i_;
+    }
+    friend bool operator<=(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.i_ <= b.i_;
+    }
+    friend bool operator>=(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.i_ >= b.i_;
+    }
+
+  private:
+    friend class small_gap_vector;
+    template <bool>
+    friend class basic_iterator;
+
+    basic_iterator(owner_type* owner, std::size_t i) noexcept : owner_{owner}, i_{i} {}
+
+    owner_type* owner_{};
+    std::size_t i_{};
+  }; // class basic_iterator
+
+public:
+  using value_type             = valueT;
+  using allocator_type         = allocT;
+  using reference              = value_type&;
+  using const_reference        = const value_type&;
+  using size_type              = std::size_t;
+  using difference_type        = std::ptrdiff_t;
+  using pointer                = typename allocator_traits::pointer;
+  using const_pointer          = typename allocator_traits::const_pointer;
+  using iterator               = basic_iterator<false>;
+  using const_iterator         = basic_iterator<true>;
+  using reverse_iterator       = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+#if __cplusplus >= 201703L
+  static constexpr size_type static_capacity = sizeN;
+#else
+  enum { static_capacity = sizeN };
+#endif // __cplusplus >= 201703L
+
+  /// @brief A contiguous run of elements.
+  template <typename pointerT>
+  struct basic_span {
+    pointerT data;
+    size_type size;
+
+    pointerT begin() const noexcept { return data; }
+    pointerT end() const noexcept { return data + size; }
+    bool empty() const noexcept { return size == 0; }
+  }; // struct basic_span
+
+  using span       = basic_span<pointer>;
+  using const_span = basic_span<const_pointer>;
+
+  small_gap_vector() noexcept(noexcept(allocT())) : allocT() {}
+
+  explicit small_gap_vector(const allocator_type& a) noexcept : allocT(a) {}
+
+  small_gap_vector(std::initializer_list<value_type> il, const allocator_type& a = allocator_type{})
+      : allocT(a) {
+    // The destructor does not run if a constructor throws.
+    defer_fail { release(); };
+    insert(end(), il.begin(), il.end());
+  }
+
+  template <typename iterT,
+      typename = typename std::enable_if<std::is_base_of<std::forward_iterator_tag,
+          typename std::iterator_traits<iterT>::iterator_category>::value>::type>
+  small_gap_vector(iterT first, iterT last, const allocator_type& a = allocator_type{})
+      : allocT(a) {
+    defer_fail { release(); };
+    insert(end(), first, last);
+  }
+
+  small_gap_vector(const small_gap_vector& other)
+      : allocT(allocator_traits::select_on_container_copy_construction(other.allocator())) {
+    defer_fail { release(); };
+    copy_from(other);
+  }
+
+  small_gap_vector(small_gap_vector&& other) noexcept : allocT(std::move(other.allocator())) {
+    steal_or_relocate(other);
+  }
+
+  ~small_gap_vector() { release(); }
+
+  small_gap_vector& operator=(const small_gap_vector& other) {
+    if(this != &other) {
+      clear();
+      JACL_IF_CONSTEXPR(allocator_traits::propagate_on_container_copy_assignment::value) {
+        if(allocator() != other.allocator()) {
+          release();
+          allocator() = other.allocator();
+        }
+      }
+      copy_from(other);
+    }
+    return *this;
+  }
+
+  small_gap_vector& operator=(small_gap_vector&& other) noexcept(
+      allocator_traits::propagate_on_container_move_assignment::value) {
+    if(this != &other) {
+      release();
+      JACL_IF_CONSTEXPR(allocator_traits::propagate_on_container_move_assignment::value) {
+        allocator() = std::move(other.allocator());
+      }
+      steal_or_relocate(other);
+    }
+    return *this;
+  }
+
+  allocator_type get_allocator() const noexcept { return allocator(); }
+
+  iterator begin() noexcept { return {this, 0}; }
+  const_iterator begin() const noexcept { return {this, 0}; }
+  iterator end() noexcept { return {this, size()}; }
+  const_iterator end() const noexcept { return {this, size()}; }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+  reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+  const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+  reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+  const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+  size_type size() const noexcept { return capacity_ - (gap_end_ - gap_begin_); }
+  bool empty() const noexcept { return size() == 0; }
+  size_type capacity() const noexcept { return capacity_; }
+  bool is_heap_allocated() const noexcept { return capacity_ > sizeN; }
+
+  /// @brief The index of the first element after the gap.
+  size_type gap_position() const noexcept { return gap_begin_; }
+
+  reference operator[](size_type n) {
+    return data_[n < gap_begin_ ? n : n + gap_end_ - gap_begin_];
+  }
+  const_reference operator[](size_type n) const {
+    return data_[n < gap_begin_ ? n : n + gap_end_ - gap_begin_];
+  }
+
+  reference front() { return (*this)[0]; }
+  const_reference front() const { return (*this)[0]; }
+  reference back() { return (*this)[size() - 1]; }
+  const_reference back() const { return (*this)[size() - 1]; }
+
+  /// @brief The elements before and after the gap.
+  std::pair<span, span> spans() noexcept {
+    return {span{data_, gap_begin_}, span{data_ + gap_end_, capacity_ - gap_end_}};
+  }
+  std::pair<const_span, const_span> spans() const noexcept {
+    return {const_span{data_, gap_begin_}, const_span{data_ + gap_end_, capacity_ - gap_end_}};
+  }
+
+  /**
+   * @brief Moves the gap to the end, so that all elements are contiguous.
+   *
+   * @return A pointer to the first element.
+   */
+  pointer make_contiguous() noexcept {
+    move_gap(size());
+    return data_;
+  }
+
+  /**
+   * @brief Moves the gap before the element at `n`, ahead of edits there.
+   *
+   * @complexity Linear in the distance between the old and new position.
+   */
+  void move_gap(size_type n) noexcept {
+    if(gap_begin_ == gap_end_) {
+      gap_begin_ = gap_end_ = n;
+    } else if(n < gap_begin_) {
+      const size_type count = gap_begin_ - n;
+      relocate_backward(data_ + gap_end_ - count, data_ + n, count);
+      gap_begin_ = n;
+      gap_end_ -= count;
+    } else if(n > gap_begin_) {
+      const size_type count = n - gap_begin_;
+      relocate_forward(data_ + gap_begin_, data_ + gap_end_, count);
+      gap_begin_ = n;
+      gap_end_ += count;
+    }
+  }
+
+  void reserve(size_type n) {
+    if(n > capacity_) reallocate(n);
+  }
+
+  void push_back(const value_type& x) { emplace(cend(), x); }
+  void push_back(value_type&& x) { emplace(cend(), std::move(x)); }
+  template <class... Args>
+  reference emplace_back(Args&&... args) {
+    return *emplace(cend(), std::forward<Args>(args)...);
+  }
+  void pop_back() { erase(cend() - 1); }
+
+  iterator insert(const_iterator pos, const value_type& x) { return emplace(pos, x); }
+  iterator insert(const_iterator pos, value_type&& x) { return emplace(pos, std::move(x)); }
+
+  template <typename iterT,
+      typename = typename std::enable_if<std::is_base_of<std::forward_iterator_tag,
+          typename std::iterator_traits<iterT>::iterator_category>::value>::type>
+  iterator insert(const_iterator pos, iterT first, iterT last) {
+    const size_type i = pos.i_;
+    const size_type n = size_type(std::distance(first, last));
+    if(gap_end_ - gap_begin_ < n) reallocate(std::max(2 * capacity_, size() + n));
+    move_gap(i);
+    for(; first != last; ++first) {
+      allocator_traits::construct(allocator(), data_ + gap_begin_, *first);
+      ++gap_begin_;
+    }
+    return {this, i};
+  }
+
+  /**
+   * @brief Constructs an element before `pos`.
+   *
+   * @complexity O(1) amortized plus the distance the gap moves.
+   */
+  template <class... Args>
+  iterator emplace(const_iterator pos, Args&&... args) {
+    const size_type i = pos.i_;
+    // The arguments may refer to elements that moving the gap relocates.
+    value_type value(std::forward<Args>(args)...);
+    if(gap_begin_ == gap_end_) reallocate(2 * capacity_);
+    move_gap(i);
+    allocator_traits::construct(allocator(), data_ + gap_begin_, std::move(value));
+    ++gap_begin_;
+    return {this, i};
+  }
+
+  /**
+   * @brief Erases the element at `pos`.
+   *
+   * @complexity O(1) plus the distance the gap moves.
+   */
+  iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    const size_type i = first.i_;
+    const size_type n = last.i_ - first.i_;
+    move_gap(i);
+    destroy_n(data_ + gap_end_, n);
+    gap_end_ += n;
+    return {this, i};
+  }
+
+  void clear() noexcept {
+    destroy_n(data_, gap_begin_);
+    destroy_n(data_ + gap_end_, capacity_ - gap_end_);
+    gap_begin_ = 0;
+    gap_end_   = capacity_;
+  }
+
+private:
+  allocator_type& allocator() noexcept { return *this; }
+  const allocator_type& allocator() const noexcept { return *this; }
+
+  pointer inline_data() noexcept { return inline_data_; }
+
+  void destroy_n(pointer p, size_type n) noexcept {
+    JACL_IF_CONSTEXPR(!std::is_trivially_destructible<value_type>::value) {
+      for(size_type i = 0; i < n; ++i) allocator_traits::destroy(allocator(), p + i);
+    }
+  }
+
+  // Relocation moves each element and destroys the source. The ranges may
+  // overlap if `dest` precedes `src` (forward) or follows it (backward).
+  void relocate_forward(pointer dest, pointer src, size_type n) noexcept {
+    JACL_IF_CONSTEXPR(std::is_trivially_copyable<value_type>::value) {
+      if(n != 0) std::memmove(static_cast<void*>(dest), src, n * sizeof(value_type));
+    } else {
+      for(size_type i = 0; i < n; ++i) {
+        allocator_traits::construct(allocator(), dest + i, std::move(src[i]));
+        allocator_traits::destroy(allocator(), src + i);
+      }
+    }
+  }
+
+  void relocate_backward(pointer dest, pointer src, size_type n) noexcept {
+    JACL_IF_CONSTEXPR(std::is_trivially_copyable<value_type>::value) {
+      if(n != 0) std::memmove(static_cast<void*>(dest), src, n * sizeof(value_type));
+    } else {
+      for(size_type i = n; i-- > 0;) {
+        allocator_traits::construct(allocator(), dest + i, std::move(src[i]));
+        allocator_traits::destroy(allocator(), src + i);
+      }
+    }
+  }
+
+  // Moves the elements to a heap buffer of `new_capacity`, keeping the gap at
+  // the same position.
+  void reallocate(size_type new_capacity) {
+    pointer p               = allocator_traits::allocate(allocator(), new_capacity);
+    const size_type after   = capacity_ - gap_end_;
+    const size_type new_end = new_capacity - after;
+    relocate_forward(p, data_, gap_begin_);
+    relocate_forward(p + new_end, data_ + gap_end_, after);
+    if(is_heap_allocated()) allocator_traits::deallocate(allocator(), data_, capacity_);
+    data_     = p;
+    capacity_ = new_capacity;
+    gap_end_  = new_end;
+  }
+
+  // Destroys the elements and frees the heap buffer, leaving an empty vector
+  // on the inline buffer.
+  void release() noexcept {
+    clear();
+    if(is_heap_allocated()) allocator_traits::deallocate(allocator(), data_, capacity_);
+    data_      = inline_data();
+    capacity_  = sizeN;
+    gap_begin_ = 0;
+    gap_end_   = sizeN;
+  }
+
+  // Copies the elements of `other` into this empty vector, behind one gap at
+  // the same position.
+  void copy_from(const small_gap_vector& other) {
+    const size_type n = other.size();
+    if(n > capacity_) reallocate(n);
+    const std::pair<const_span, const_span> halves = other.spans();
+    insert(end(), halves.first.begin(), halves.first.end());
+    insert(end(), halves.second.begin(), halves.second.end());
+    move_gap(other.gap_begin_);
+  }
+
+  // Takes the elements of `other` into this empty vector: its heap buffer if
+  // the allocators allow, otherwise one element at a time.
+  void steal_or_relocate(small_gap_vector& other) {
+    if(other.is_heap_allocated() && allocator() == other.allocator()) {
+      data_       = other.data_;
+      capacity_   = other.capacity_;
+      gap_begin_  = other.gap_begin_;
+      gap_end_    = other.gap_end_;
+      other.data_ = other.inline_data();
+    } else {
+      if(other.capacity_ > capacity_) reallocate(other.capacity_);
+      const size_type after = other.capacity_ - other.gap_end_;
+      relocate_forward(data_, other.data_, other.gap_begin_);
+      relocate_forward(data_ + capacity_ - after, other.data_ + other.gap_end_, after);
+      gap_begin_ = other.gap_begin_;
+      gap_end_   = capacity_ - after;
+      if(other.is_heap_allocated()) {
+        allocator_traits::deallocate(other.allocator(), other.data_, other.capacity_);
+      }
+      other.data_ = other.inline_data();
+    }
+    other.capacity_  = sizeN;
+    other.gap_begin_ = 0;
+    other.gap_end_   = sizeN;
+  }
+
+  // Elements in the inline buffer are constructed and destroyed explicitly.
+  union {
+    value_type inline_data_[sizeN];
+  };
+  pointer data_{inline_data()};
+  size_type capacity_{sizeN};
+  size_type gap_begin_{};
+  size_type gap_end_{sizeN};
+}; // class small_gap_vector
+
+} // namespace jacl
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif // defined(_MSC_VER) && !defined(__clang__)
+
+namespace jacl {
+namespace internal {
+
+// The number of trailing zero bits of a non-zero word.
+inline unsigned ctz64(std::uint64_t x) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return unsigned(__builtin_ctzll(x));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long i;
+  _BitScanForward64(&i, x);
+  return unsigned(i);
+#else
+  unsigned n = 0;
+  for(; (x & 1) == 0; x >>= 1) ++n;
+  return n;
+#endif // defined(__GNUC__) || defined(__clang__)
+}
+
+// The number of leading zero bits of a non-zero word.
+inline unsigned clz64(std::uint64_t x) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return unsigned(__builtin_clzll(x));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long i;
+  _BitScanReverse64(&i, x);
+  return 63 - unsigned(i);
+#else
+  unsigned n = 0;
+  for(; (x >> 63) == 0; x <<= 1) ++n;
+  return n;
+#endif // defined(__GNUC__) || defined(__clang__)
+}
+
+// The number of set bits of a word.
+inline unsigned popcount64(std::uint64_t x) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+  return unsigned(__builtin_popcountll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  return unsigned(__popcnt64(x));
+#else
+  unsigned n = 0;
+  for(; x != 0; x &= x - 1) ++n;
+  return n;
+#endif // defined(__GNUC__) || defined(__clang__)
+}
+
+} // namespace internal
+
+/**
+ * @brief A small vector with order-preserving O(1) amortized erase.
+ *
+ * `small_tombstone_vector` wraps a `small_vector` of slots and a bitmap of the
+ * slots whose element was erased. `erase` only sets the slot's bit; iteration
+ * skips erased slots by scanning the bitmap a 64-bit word at a time. Once more
+ * than `compactPercentN` percent of the slots are erased, one pass moves the
+ * remaining elements to the front in runs, in their original order, and
+ * destroys the erased ones. Erasing the last element removes its slot
+ * directly.
+ *
+ * Erased elements stay alive until the next compaction. Appends and
+ * compactions invalidate iterators.
+ *
+ * @tparam valueT The type of the elements.
+ * @tparam sizeN The static capacity of the underlying small vector.
+ * @tparam compactPercentN Compact when more than this percentage of the slots
+ * are erased.
+ * @tparam allocT The allocator type of the underlying small vector.
+ */
+template <typename valueT, size_t sizeN, unsigned compactPercentN = 25,
+    typename allocT = std::allocator<valueT>>
+class small_tombstone_vector {
+  static_assert(compactPercentN > 0 && compactPercentN < 100,
+      "small_tombstone_vector: compactPercentN must be in (0, 100)");
+
+  using vector_type = small_vector<valueT, sizeN, allocT>;
+  using word_type   = std::uint64_t;
+  using bitmap_type = small_vector<word_type, (sizeN + 63) / 64>;
+
+  template <bool constN>
+  class basic_iterator {
+    using owner_type = typename std::conditional<constN, const small_tombstone_vector,
+        small_tombstone_vector>::type;
+
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = valueT;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = typename std::conditional<constN, const valueT*, valueT*>::type;
+    using reference         = typename std::conditional<constN, const valueT&, valueT&>::type;
+
+    basic_iterator() = default;
+
+    template <bool otherN, typename = typename std::enable_if<constN && !otherN>::type>
+    basic_iterator(const basic_iterator<otherN>& other) noexcept
+        : owner_{other.owner_}, slot_{other.slot_} {}
+
+    /// @brief The index of the element's slot in the underlying vector.
+    std::size_t slot() const noexcept { return slot_; }
+
+    reference operator*() const { return owner_->data_[slot_]; }
+    pointer operator->() const { return &owner_->data_[slot_]; }
+
+    basic_iterator& operator++() noexcept {
+      slot_ = owner_->next_live(slot_ + 1);
+      return *this;
+    }
+    basic_iterator operator++(int) noexcept {
+      basic_iterator result = *this;
+      ++*this;
+      return result;
+    }
+    basic_iterator& operator--() noexcept {
+      slot_ = owner_->prev_live(slot_);
+      return *this;
+    }
+    basic_iterator operator--(int) noexcept {
+      basic_iterator result = *this;
+      --*this;
+      return result;
+    }
+
+    friend bool operator==(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.slot_ == b.slot_;
+    }
+    friend bool operator!=(const basic_iterator& a, const basic_iterator& b) noexcept {
+      return a.slot_ != b.slot_;
+    }
+
+  private:
+    friend class small_tombstone_vector;
+    template <bool>
+    friend class basic_iterator;
+
+    basic_iterator(owner_type* owner, std::size_t slot) noexcept : owner_{owner}, slot_{slot} {}
+
+    owner_type* owner_{};
+    std::size_t slot_{};
+  }; // class basic_iterator
+
+public:
+  using value_type             = typename vector_type::value_type;
+  using allocator_type         = typename vector_type::allocator_type;
+  using reference              = typename vector_type::reference;
+  using const_reference        = typename vector_type::const_reference;
+  using size_type              = typename vector_type::size_type;
+  using difference_type        = typename vector_type::difference_type;
+  using iterator               = basic_iterator<false>;
+  using const_iterator         = basic_iterator<true>;
+  using reverse_iterator       = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+#if __cplusplus >= 201703L
+  static constexpr size_type static_capacity = sizeN;
+#else
+  enum { static_capacity = sizeN };
+#endif // __cplusplus >= 201703L
+
+  small_tombstone_vector() = default;
+
+  explicit small_tombstone_vector(const allocator_type& a) : data_{a} {}
+
+  small_tombstone_vector(std::initializer_list<value_type> il) : data_{il} {
+    dead_bits_.assign(words(data_.size()), 0);
+  }
+
+  /**
+   * @brief The underlying vector, compacted first so that it holds exactly the
+   * elements.
+   */
+  const vector_type& compacted() {
+    compact();
+    return data_;
+  }
+
+  const allocator_type& get_allocator() const noexcept { return data_.get_allocator(); }
+
+  iterator begin() noexcept { return {this, next_live(0)}; }
+  const_iterator begin() const noexcept { return {this, next_live(0)}; }
+  iterator end() noexcept { return {this, data_.size()}; }
+  const_iterator end() const noexcept { return {this, data_.size()}; }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+  reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+  const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+  reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+  const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+  size_type size() const noexcept { return data_.size() - dead_; }
+  bool empty() const noexcept { return size() == 0; }
+  size_type capacity() const noexcept { return data_.capacity(); }
+
+  /// @brief The number of slots, erased or not.
+  size_type slot_count() const noexcept { return data_.size(); }
+
+  /// @brief The number of erased elements awaiting compaction.
+  size_type erased_count() const noexcept { return dead_; }
+
+  reference front() { return *begin(); }
+  const_reference front() const { return *begin(); }
+  // The last slot is never erased.
+  reference back() { return data_.back(); }
+  const_reference back() const { return data_.back(); }
+
+  void push_back(const value_type& x) { emplace_back(x); }
+  void push_back(value_type&& x) { emplace_back(std::move(x)); }
+  template <class... Args>
+  reference emplace_back(Args&&... args) {
+    if(data_.size() % 64 == 0) dead_bits_.push_back(0);
+    return data_.emplace_back(std::forward<Args>(args)...);
+  }
+
+  void pop_back() { erase(const_iterator{this, prev_live(data_.size())}); }
+
+  /**
+   * @brief Erases the element at `pos`.
+   *
+   * @return An iterator to the element that followed it.
+   * @complexity O(1) amortized; O(size) when it triggers a compaction.
+   */
+  iterator erase(const_iterator pos) {
+    const size_type slot = pos.slot_;
+    if(slot + 1 == data_.size()) {
+      data_.pop_back();
+      trim();
+      return end();
+    }
+
+    dead_bits_[slot / 64] |= word_type(1) << (slot % 64);
+    ++dead_;
+    size_type next = next_live(slot + 1);
+    if(dead_ * 100 > data_.size() * compactPercentN) {
+      next -= erased_before(next);
+      compact();
+    }
+    return {this, next};
+  }
+
+  void clear() noexcept {
+    data_.clear();
+    dead_bits_.clear();
+    dead_ = 0;
+  }
+
+  /**
+   * @brief Destroys the erased elements and moves the others to the front of
+   * the underlying vector, keeping their order.
+   */
+  void compact() {
+    if(dead_ == 0) return;
+    const size_type n = data_.size();
+    size_type out     = next_dead(0);
+    for(size_type first = next_live(out); first != n;) {
+      const size_type last = next_dead(first);
+      std::move(data_.begin() + first, data_.begin() + last, data_.begin() + out);
+      out += last - first;
+      first = next_live(last);
+    }
+    data_.erase(data_.begin() + out, data_.end());
+    dead_bits_.assign(words(out), 0);
+    dead_ = 0;
+  }
+
+private:
+  static size_type words(size_type slots) noexcept { return (slots + 63) / 64; }
+
+  // The first slot at or after `slot` whose element is not erased, or the
+  // slot count. Bits past the last slot are clear.
+  size_type next_live(size_type slot) const noexcept {
+    const size_type n = data_.size();
+    while(slot < n) {
+      const word_type live = ~dead_bits_[slot / 64] >> (slot % 64);
+      if(live != 0) return std::min(n, slot + size_type(internal::ctz64(live)));
+      slot = (slot / 64 + 1) * 64;
+    }
+    return n;
+  }
+
+  // The first erased slot at or after `slot`, or the slot count.
+  size_type next_dead(size_type slot) const noexcept {
+    const size_type n = data_.size();
+    while(slot < n) {
+      const word_type dead = dead_bits_[slot / 64] >> (slot % 64);
+      if(dead != 0) return slot + size_type(internal::ctz64(dead));
+      slot = (slot / 64 + 1) * 64;
+    }
+    return n;
+  }
+
+  // The last slot before `slot` whose element is not erased.
+  size_type prev_live(size_type slot) const noexcept {
+    while(slot > 0) {
+      const size_type last  = slot - 1;
+      const word_type below = ~word_type(0) >> (63 - last % 64);
+      const word_type live  = ~dead_bits_[last / 64] & below;
+      if(live != 0) return last / 64 * 64 + 63 - size_type(internal::clz64(live));
+      slot = last / 64 * 64;
+    }
+    return 0;
+  }
+
+  size_type erased_before(size_type slot) const noexcept {
+    size_type count = 0;
+    for(size_type w = 0; w < slot / 64; ++w) {
+      count += size_type(internal::popcount64(dead_bits_[w]));
+    }
+    if(slot % 64 != 0) {
+      const word_type below = ~word_type(0) >> (64 - slot % 64);
+      count += size_type(internal::popcount64(dead_bits_[slot / 64] & below));
+    }
+    return count;
+  }
+
+  // Drops erased slots from the end, so that the last slot is live.
+  void trim() {
+    while(!data_.empty()) {
+      const size_type last = data_.size() - 1;
+      word_type& word      = dead_bits_[last / 64];
+      const word_type bit  = word_type(1) << (last % 64);
+      if((word & bit) == 0) break;
+      word &= ~bit;
+      --dead_;
+      data_.pop_back();
+    }
+    dead_bits_.resize(words(data_.size()));
+  }
+
+  vector_type data_;
+  bitmap_type dead_bits_;
+  size_type dead_{};
+}; // class small_tombstone_vector
+
+} // namespace jacl
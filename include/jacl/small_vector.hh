@@ -3,12 +3,14 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <deferral.hh>
 #include <initializer_list>
 #include <iterator>
 #include <limits>
 #include <memory>
 #include <stdexcept>
+#include <type_traits>
 
 #if defined(__has_include) && __has_include(<version>)
 #include <version>
@@ -103,6 +105,177 @@
 #define JACL_TO_ADDRESSES_SUPPORTED 0
 #endif // defined(__cpp_lib_to_address) && __cpp_lib_to_address >= 201711
 
+// small_vector is usable in constant expressions when the standard library
+// supports constexpr allocation (C++20).
+#if defined(__cpp_lib_is_constant_evaluated) && __cpp_lib_is_constant_evaluated >= 201811 && \
+    defined(__cpp_constexpr_dynamic_alloc) && __cpp_constexpr_dynamic_alloc >= 201907 &&     \
+    defined(__cpp_lib_constexpr_dynamic_alloc) && __cpp_lib_constexpr_dynamic_alloc >= 201907
+#define JACL_CONSTEXPR20_SUPPORTED     1
+#define JACL_CONSTEXPR20               constexpr
+#define JACL_IS_CONSTANT_EVALUATED()   std::is_constant_evaluated()
+#else
+#define JACL_CONSTEXPR20_SUPPORTED     0
+#define JACL_CONSTEXPR20
+#define JACL_IS_CONSTANT_EVALUATED()   false
+#endif // defined(__cpp_lib_is_constant_evaluated) && ...
+
+// Consumers of the small_vector_instantiations library define this to 1 so the
+// specializations listed in JACL_SMALL_VECTOR_COMMON_INSTANTIATIONS are
+// instantiated once in the library instead of in every translation unit.
+#if !defined(JACL_SMALL_VECTOR_EXTERN_TEMPLATES)
+#define JACL_SMALL_VECTOR_EXTERN_TEMPLATES 0
+#endif // !defined(JACL_SMALL_VECTOR_EXTERN_TEMPLATES)
+
+// Operation tracing (see small_vector_trace.hh) is compiled out unless
+// JACL_SMALL_VECTOR_TRACE is defined to 1.
+#if !defined(JACL_SMALL_VECTOR_TRACE)
+#define JACL_SMALL_VECTOR_TRACE 0
+#endif // !defined(JACL_SMALL_VECTOR_TRACE)
+
+#if JACL_SMALL_VECTOR_TRACE
+#include "small_vector_trace.hh"
+#define JACL_SMALL_VECTOR_TRACE_SCOPE(...) \
+  internal::trace_scope<this_type> jacl_trace_scope_(this, __VA_ARGS__)
+#else
+#define JACL_SMALL_VECTOR_TRACE_SCOPE(...)
+#endif // JACL_SMALL_VECTOR_TRACE
+
+// Per-specialization statistics (see small_vector_stats.hh) are compiled out
+// unless JACL_SMALL_VECTOR_STATS is defined to 1.
+#if !defined(JACL_SMALL_VECTOR_STATS)
+#define JACL_SMALL_VECTOR_STATS 0
+#endif // !defined(JACL_SMALL_VECTOR_STATS)
+
+#if JACL_SMALL_VECTOR_STATS
+#include "small_vector_stats.hh"
+#define JACL_SMALL_VECTOR_STATS_RECORD(event, value)                                     \
+  do {                                                                                   \
+    if(!JACL_IS_CONSTANT_EVALUATED())                                                    \
+      internal::stats_recorder<this_type>::record(                                       \
+          internal::stats_event::event, std::uint64_t(value));                           \
+  } while(0)
+#else
+#define JACL_SMALL_VECTOR_STATS_RECORD(event, value) \
+  do {                                               \
+  } while(0)
+#endif // JACL_SMALL_VECTOR_STATS
+
+// Size profiling (see small_vector_profile.hh) is compiled out unless
+// JACL_SMALL_VECTOR_PROFILE is defined to 1.
+#if !defined(JACL_SMALL_VECTOR_PROFILE)
+#define JACL_SMALL_VECTOR_PROFILE 0
+#endif // !defined(JACL_SMALL_VECTOR_PROFILE)
+
+#if JACL_SMALL_VECTOR_PROFILE
+#include "small_vector_profile.hh"
+#define JACL_SMALL_VECTOR_PROFILE_OBSERVE(vec, size) (vec).profile_.observe(size)
+#define JACL_SMALL_VECTOR_PROFILE_DESTROY()                                      \
+  do {                                                                           \
+    if(!JACL_IS_CONSTANT_EVALUATED())                                            \
+      internal::profile_recorder<this_type>::record(profile_, size_);            \
+  } while(0)
+#else
+#define JACL_SMALL_VECTOR_PROFILE_OBSERVE(vec, size) \
+  do {                                               \
+  } while(0)
+#define JACL_SMALL_VECTOR_PROFILE_DESTROY() \
+  do {                                      \
+  } while(0)
+#endif // JACL_SMALL_VECTOR_PROFILE
+
+// Heap accounting hooks (see small_vector_memory_hooks.hh) are compiled out
+// unless JACL_SMALL_VECTOR_MEMORY_HOOKS is defined to 1.
+#if !defined(JACL_SMALL_VECTOR_MEMORY_HOOKS)
+#define JACL_SMALL_VECTOR_MEMORY_HOOKS 0
+#endif // !defined(JACL_SMALL_VECTOR_MEMORY_HOOKS)
+
+#if JACL_SMALL_VECTOR_MEMORY_HOOKS
+#include "small_vector_memory_hooks.hh"
+#define JACL_SMALL_VECTOR_MEMORY_RECORD(op, ptr, n)                                        \
+  do {                                                                                     \
+    if(!JACL_IS_CONSTANT_EVALUATED())                                                      \
+      internal::memory_recorder<this_type>::record(                                        \
+          memory::operation::op, static_cast<const void*>(ptr), (n) * sizeof(value_type)); \
+  } while(0)
+#else
+#define JACL_SMALL_VECTOR_MEMORY_RECORD(op, ptr, n) \
+  do {                                              \
+  } while(0)
+#endif // JACL_SMALL_VECTOR_MEMORY_HOOKS
+
+// USDT probes (sys/sdt.h) on spills, reallocations, shrinks to inline storage
+// and deallocations are compiled out unless JACL_SMALL_VECTOR_USDT is defined
+// to 1. Every probe of the `jacl` provider carries the element size, the inline
+// capacity, the size, and the old and new capacity (0 when a buffer is
+// released), e.g. `usdt:./app:jacl:spill { @[arg1] = hist(arg4); }`.
+#if !defined(JACL_SMALL_VECTOR_USDT)
+#define JACL_SMALL_VECTOR_USDT 0
+#endif // !defined(JACL_SMALL_VECTOR_USDT)
+
+#if JACL_SMALL_VECTOR_USDT
+#include <sys/sdt.h>
+#define JACL_SMALL_VECTOR_PROBE(name, old_cap, new_cap)                                  \
+  do {                                                                                   \
+    if(!JACL_IS_CONSTANT_EVALUATED())                                                    \
+      DTRACE_PROBE5(jacl, name, sizeof(value_type), std::size_t(static_capacity),        \
+          std::size_t(size_), std::size_t(old_cap), std::size_t(new_cap));               \
+  } while(0)
+#else
+#define JACL_SMALL_VECTOR_PROBE(name, old_cap, new_cap) \
+  do {                                                  \
+  } while(0)
+#endif // JACL_SMALL_VECTOR_USDT
+
+// No-heap scopes (see small_vector_no_heap.hh) are checked in debug builds, or
+// when JACL_SMALL_VECTOR_NO_HEAP_CHECKS is defined to 1.
+#if !defined(JACL_SMALL_VECTOR_NO_HEAP_CHECKS)
+#if defined(NDEBUG)
+#define JACL_SMALL_VECTOR_NO_HEAP_CHECKS 0
+#else
+#define JACL_SMALL_VECTOR_NO_HEAP_CHECKS 1
+#endif // defined(NDEBUG)
+#endif // !defined(JACL_SMALL_VECTOR_NO_HEAP_CHECKS)
+
+#if JACL_SMALL_VECTOR_NO_HEAP_CHECKS
+#include "small_vector_no_heap.hh"
+#define JACL_SMALL_VECTOR_NO_HEAP_CHECK(n)                                          \
+  do {                                                                              \
+    if(!JACL_IS_CONSTANT_EVALUATED() && JACL_UNLIKELY(internal::no_heap_current())) \
+      internal::no_heap_violation<this_type>((n) * sizeof(value_type));             \
+  } while(0)
+#else
+#define JACL_SMALL_VECTOR_NO_HEAP_CHECK(n) \
+  do {                                     \
+  } while(0)
+#endif // JACL_SMALL_VECTOR_NO_HEAP_CHECKS
+
+// Relocations and copies of trivially copyable elements of at least this many
+// bytes use non-temporal stores where available (x86 SSE2), so that growing a
+// very large vector does not evict the working set from the cache. Define to 0
+// to always copy through the cache. Both thresholds must be usable in #if.
+#if !defined(JACL_SMALL_VECTOR_STREAMING_THRESHOLD)
+#define JACL_SMALL_VECTOR_STREAMING_THRESHOLD (4u << 20)
+#endif // !defined(JACL_SMALL_VECTOR_STREAMING_THRESHOLD)
+
+// Element-wise relocations and copies of at least this many bytes prefetch the
+// source ahead of the loop. Define to 0 to prefetch in every such loop.
+#if !defined(JACL_SMALL_VECTOR_PREFETCH_THRESHOLD)
+#define JACL_SMALL_VECTOR_PREFETCH_THRESHOLD (64u << 10)
+#endif // !defined(JACL_SMALL_VECTOR_PREFETCH_THRESHOLD)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JACL_HAS_STREAMING_STORES 1
+#else
+#define JACL_HAS_STREAMING_STORES 0
+#endif // defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JACL_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define JACL_PREFETCH(addr) static_cast<void>(addr)
+#endif // defined(__GNUC__) || defined(__clang__)
+
 namespace jacl {
 namespace internal {
 
@@ -138,6 +311,88 @@ struct remove_restrict<ptrT * JACL_RESTRICT const volatile> {
 template <typename ptrT>
 using remove_restrict_t = typename remove_restrict<ptrT>::type;
 
+/**
+ * @brief Bytes past `data() + capacity()` that must stay readable, as given by
+ * the allocator's `padding_bytes` member (see padded_allocator.hh); 0 if it has
+ * none.
+ */
+template <typename allocT, typename = void>
+struct allocator_padding : std::integral_constant<std::size_t, 0> {};
+
+template <typename allocT>
+struct allocator_padding<allocT, typename std::enable_if<sizeof(allocT::padding_bytes) != 0>::type>
+    : std::integral_constant<std::size_t, allocT::padding_bytes> {};
+
+/// @brief C++11 replacement for std::exchange (C++14).
+template <typename T, typename U = T>
+JACL_CONSTEXPR20 T exchange(T& obj, U&& new_value) {
+  T old_value = std::move(obj);
+  obj         = std::forward<U>(new_value);
+  return old_value;
+}
+
+/**
+ * @brief Copies `bytes` bytes with non-temporal stores, which write around the
+ * cache. Falls back to `std::memcpy` where streaming stores are unavailable.
+ *
+ * Not inlined: the call is negligible next to the copy, and inlined copies of
+ * inline buffers trip -Warray-bounds for sizes that cannot occur.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline))
+#elif defined(_MSC_VER)
+__declspec(noinline)
+#endif
+inline void stream_copy(
+    void* JACL_RESTRICT dest, const void* JACL_RESTRICT src, std::size_t bytes) noexcept {
+#if JACL_HAS_STREAMING_STORES
+  auto* d       = static_cast<char*>(dest);
+  const auto* s = static_cast<const char*>(src);
+  // Streaming stores need 16-byte aligned destinations.
+  const std::size_t head = std::min<std::size_t>(
+      bytes, (16 - (reinterpret_cast<std::uintptr_t>(d) & 15)) & 15);
+  std::memcpy(d, s, head);
+  d += head;
+  s += head;
+  bytes -= head;
+
+  constexpr std::size_t prefetch_distance = 512;
+  for(; bytes >= 64; d += 64, s += 64, bytes -= 64) {
+    if(bytes >= prefetch_distance + 64) {
+      _mm_prefetch(s + prefetch_distance, _MM_HINT_NTA);
+    }
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+    const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+  }
+  // Order the streaming stores before any later store, e.g. publishing `dest`.
+  _mm_sfence();
+  std::memcpy(d, s, bytes);
+#else
+  std::memcpy(dest, src, bytes);
+#endif // JACL_HAS_STREAMING_STORES
+}
+
+/**
+ * @brief Copies `bytes` bytes between buffers that do not overlap, streaming
+ * them past the cache if there are at least JACL_SMALL_VECTOR_STREAMING_THRESHOLD.
+ */
+JACL_FORCE_INLINE void copy_bytes(
+    void* JACL_RESTRICT dest, const void* JACL_RESTRICT src, std::size_t bytes) noexcept {
+#if JACL_SMALL_VECTOR_STREAMING_THRESHOLD > 0
+  if(JACL_UNLIKELY(bytes >= JACL_SMALL_VECTOR_STREAMING_THRESHOLD)) {
+    stream_copy(dest, src, bytes);
+    return;
+  }
+#endif // JACL_SMALL_VECTOR_STREAMING_THRESHOLD > 0
+  std::memcpy(dest, src, bytes);
+}
+
 } // namespace internal
 
 /**
@@ -194,12 +449,23 @@ private:
   using this_type          = small_vector<valueT, sizeN, allocT>;
   using internal_size_type = uint32_t;
 
-  pointer data_{reinterpret_cast<pointer>(inline_data_)};
-  internal_size_type size_{};
+  // Elements in the inline buffer are constructed and destroyed explicitly.
+  // While the vector is heap-allocated, the buffer holds the heap capacity.
+  // The union precedes `data_` so that it is initialized first.
+  // Allocators with padding (see padded_allocator.hh) pad heap buffers; the
+  // inline buffer is padded by as many whole elements here.
+  static constexpr size_t inline_padding =
+      (internal::allocator_padding<allocT>::value + sizeof(value_type) - 1) / sizeof(value_type);
+
   union {
-    alignas(value_type) uint8_t inline_data_[sizeof(value_type) * sizeN];
+    value_type inline_data_[sizeN + inline_padding];
     internal_size_type capacity_;
   };
+  pointer data_{init_inline_data()};
+  internal_size_type size_{};
+#if JACL_SMALL_VECTOR_PROFILE
+  internal::profile_state profile_;
+#endif // JACL_SMALL_VECTOR_PROFILE
 
   static constexpr bool value_is_trivially_move_assignable =
       std::is_trivially_move_assignable<value_type>::value;
@@ -219,18 +485,45 @@ private:
    *
    * @return `true` if the data is heap-allocated, `false` otherwise.
    */
-  int is_heap_allocated() const noexcept {
-    return int(data_ != reinterpret_cast<const_pointer>(inline_data_));
+  JACL_CONSTEXPR20 int is_heap_allocated() const noexcept {
+    return int(data_ != inline_data());
+  }
+
+  JACL_CONSTEXPR20 pointer inline_data() noexcept { return inline_data_; }
+  JACL_CONSTEXPR20 const_pointer inline_data() const noexcept { return inline_data_; }
+
+  JACL_CONSTEXPR20 pointer init_inline_data() noexcept {
+    // Called once by every constructor, from the initializer of `data_`.
+    JACL_SMALL_VECTOR_STATS_RECORD(constructions, 1);
+#if JACL_CONSTEXPR20_SUPPORTED
+    // A vector that is constant-initialized may not contain uninitialized
+    // objects, so begin the lifetime of every inline element of trivial types.
+    if constexpr(std::is_trivially_default_constructible<value_type>::value &&
+                 std::is_trivially_copy_assignable<value_type>::value) {
+      if(std::is_constant_evaluated()) {
+        for(size_t i = 0; i < sizeN + inline_padding; ++i) inline_data_[i] = value_type();
+      }
+    }
+#endif // JACL_CONSTEXPR20_SUPPORTED
+    return inline_data_;
   }
 
-  allocator_type& allocator() noexcept { return static_cast<allocator_type&>(*this); }
-  const allocator_type& allocator() const noexcept {
+  JACL_CONSTEXPR20 allocator_type& allocator() noexcept {
+    return static_cast<allocator_type&>(*this);
+  }
+  JACL_CONSTEXPR20 const allocator_type& allocator() const noexcept {
     return static_cast<const allocator_type&>(*this);
   }
 
-  std::pair<pointer, size_type> allocate(internal_size_type n) {
+  JACL_CONSTEXPR20 std::pair<pointer, size_type> allocate(internal_size_type n) {
     check_max_size(n);
+    JACL_SMALL_VECTOR_NO_HEAP_CHECK(n);
+    const auto result = allocate_at_least(n);
+    JACL_SMALL_VECTOR_MEMORY_RECORD(allocate, result.first, result.second);
+    return result;
+  }
 
+  JACL_CONSTEXPR20 std::pair<pointer, size_type> allocate_at_least(internal_size_type n) {
 #if JACL_ALLOCATE_AT_LEAST_SUPPORTED && JACL_CONCEPTS_SUPPORTED
     constexpr bool has_allocate_at_least_in_traits =
         requires(allocator_type a, size_type n) { allocator_traits::alloca_at_least(a, n); };
@@ -249,30 +542,41 @@ private:
     return {allocator_traits::allocate(allocator(), n), n};
   }
 
-  JACL_FORCE_INLINE void deallocate(pointer p, internal_size_type n) {
-    if(p != reinterpret_cast<pointer>(inline_data_))
+  JACL_FORCE_INLINE JACL_CONSTEXPR20 void deallocate(pointer p, internal_size_type n) {
+    if(p != inline_data()) {
+      JACL_SMALL_VECTOR_MEMORY_RECORD(deallocate, p, n);
+      JACL_SMALL_VECTOR_PROBE(dealloc, n, 0);
       allocator_traits::deallocate(allocator(), p, n);
+    }
   }
 
   template <typename... argTs>
-  JACL_FORCE_INLINE pointer construct_at(pointer JACL_RESTRICT p, argTs&&... args) {
+  JACL_FORCE_INLINE JACL_CONSTEXPR20 pointer construct_at(
+      pointer JACL_RESTRICT p, argTs&&... args) {
     JACL_IF_CONSTEXPR(!value_is_trivially_constructible || sizeof...(argTs) > 0) {
       allocator_traits::construct(allocator(), p, std::forward<argTs>(args)...);
     }
+#if JACL_CONSTEXPR20_SUPPORTED
+    else if(JACL_IS_CONSTANT_EVALUATED()) {
+      // Constant evaluation does not allow reading objects whose lifetime has
+      // not begun, even for trivial types.
+      allocator_traits::construct(allocator(), p);
+    }
+#endif // JACL_CONSTEXPR20_SUPPORTED
     return p;
   }
 
-  JACL_FORCE_INLINE void destroy_at(pointer p) noexcept {
+  JACL_FORCE_INLINE JACL_CONSTEXPR20 void destroy_at(pointer p) noexcept {
     JACL_IF_CONSTEXPR(!value_is_trivially_destructible) { p->~value_type(); }
   }
 
-  JACL_FORCE_INLINE void destroy_n(pointer first, internal_size_type n) noexcept {
+  JACL_FORCE_INLINE JACL_CONSTEXPR20 void destroy_n(pointer first, internal_size_type n) noexcept {
     JACL_IF_CONSTEXPR(!value_is_trivially_destructible) {
       for(size_type i = 0; i < n; ++i) destroy_at(first + i);
     }
   }
 
-  void check_max_size(const size_type sz) const {
+  JACL_CONSTEXPR20 void check_max_size(const size_type sz) const {
 #if !defined(JACL_SMALL_VECTOR_DISABLE_MAX_SIZE_CHECK)
     if(JACL_UNLIKELY(sz > max_size())) {
 #if !JACL_NO_EXCEPTIONS
@@ -302,7 +606,7 @@ private:
    * @return iterator The iterator pointing to the first inserted element.
    */
   template <typename construct_cbT, typename grow_cbT>
-  iterator insert_impl(const_iterator position, const internal_size_type n,
+  JACL_CONSTEXPR20 iterator insert_impl(const_iterator position, const internal_size_type n,
       construct_cbT&& construct_cb, grow_cbT&& grow_cb) {
     // Check for valid size and new size.
     if(JACL_UNLIKELY(n == 0)) return const_cast<iterator>(position);
@@ -318,6 +622,7 @@ private:
 
       // Construct the new elements.
       construct_cb(src_first);
+      size_ = new_size;
     } else {
       // Handle cases where we need to allocate a new buffer.
       const internal_size_type new_cap = grow_cb(size_, new_size);
@@ -327,69 +632,189 @@ private:
         pointer dest_position = dest + lo_size;
         construct_cb(dest_position);
         move_data(dest, data_, lo_size);
-        move_data(dest_position + n, position, hi_size);
+        move_data(dest_position + n, data_ + lo_size, hi_size);
         position = dest_position;
         return new_size;
       });
     }
+    JACL_SMALL_VECTOR_STATS_RECORD(peak_size, size_);
+    JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, size_);
 
     return const_cast<iterator>(position);
   }
 
-  void copy_data(
+  /**
+   * @brief Construct `n` elements at `dest` with `construct(i)`.
+   *
+   * If a construction throws, the elements that were already constructed are
+   * destroyed before the exception propagates.
+   */
+  template <typename constructT>
+  JACL_CONSTEXPR20 void construct_n(
+      pointer JACL_RESTRICT dest, internal_size_type n, constructT&& construct) {
+    construct_n(n, construct, [&](internal_size_type i) { destroy_n(dest, i); });
+  }
+
+  /**
+   * @brief Construct `n` elements with `construct(i)`.
+   *
+   * If a construction throws, `rollback(i)` destroys the `i` elements that
+   * were already constructed before the exception propagates.
+   */
+  template <typename constructT, typename rollbackT>
+  JACL_CONSTEXPR20 void construct_n(
+      internal_size_type n, constructT& construct, const rollbackT& rollback) {
+    if(JACL_IS_CONSTANT_EVALUATED()) {
+      // A throw ends constant evaluation, so there is nothing to roll back.
+      for(internal_size_type i = 0; i < n; ++i) construct(i);
+    } else {
+      construct_n_guarded(n, construct, rollback);
+    }
+  }
+
+  template <typename constructT, typename rollbackT>
+  void construct_n_guarded(
+      internal_size_type n, constructT& construct, const rollbackT& rollback) {
+    internal_size_type i = 0;
+    defer_fail { rollback(i); };
+    for(; i < n; ++i) construct(i);
+  }
+
+  // Element-wise loops over at least JACL_SMALL_VECTOR_PREFETCH_THRESHOLD bytes
+  // prefetch the element `prefetch_distance` ahead, about 512 bytes.
+  static constexpr internal_size_type prefetch_distance =
+      sizeof(value_type) >= 512 ? 1 : internal_size_type(512 / sizeof(value_type));
+
+  static constexpr bool is_prefetch_worthy(internal_size_type n) noexcept {
+#if JACL_SMALL_VECTOR_PREFETCH_THRESHOLD > 0
+    return std::size_t(n) * sizeof(value_type) >= JACL_SMALL_VECTOR_PREFETCH_THRESHOLD;
+#else
+    return n > 0;
+#endif // JACL_SMALL_VECTOR_PREFETCH_THRESHOLD > 0
+  }
+
+  static constexpr internal_size_type prefetch_index(
+      internal_size_type i, internal_size_type n) noexcept {
+    return n - i > prefetch_distance ? i + prefetch_distance : n - 1;
+  }
+
+  JACL_CONSTEXPR20 void copy_data(
       pointer JACL_RESTRICT dest, const_pointer JACL_RESTRICT src, internal_size_type n) {
     JACL_IF_CONSTEXPR(value_is_trivially_copy_constructible && value_is_trivially_copy_assignable) {
-      std::memcpy(dest, src, n * sizeof(value_type));
+      if(!JACL_IS_CONSTANT_EVALUATED()) {
+        internal::copy_bytes(static_cast<void*>(dest), src, n * sizeof(value_type));
+        return;
+      }
     }
-    else {
-      internal_size_type i = 0;
-      defer_fail { destroy_n(dest, i); };
-      for(; i < n; ++i) { construct_at(dest + i, src[i]); }
+    if(!JACL_IS_CONSTANT_EVALUATED() && JACL_UNLIKELY(is_prefetch_worthy(n))) {
+      construct_n(dest, n, [&](internal_size_type i) {
+        JACL_PREFETCH(src + prefetch_index(i, n));
+        construct_at(dest + i, src[i]);
+      });
+      return;
     }
+    construct_n(dest, n, [&](internal_size_type i) { construct_at(dest + i, src[i]); });
   }
 
-  void move_data(pointer JACL_RESTRICT dest, pointer JACL_RESTRICT src, internal_size_type n) {
+  JACL_CONSTEXPR20 void move_data(
+      pointer JACL_RESTRICT dest, pointer JACL_RESTRICT src, internal_size_type n) {
     JACL_IF_CONSTEXPR(value_is_trivially_move_constructible && value_is_trivially_destructible) {
-      std::memcpy(dest, src, n * sizeof(value_type));
+      if(!JACL_IS_CONSTANT_EVALUATED()) {
+        internal::copy_bytes(static_cast<void*>(dest), src, n * sizeof(value_type));
+        return;
+      }
     }
-    else {
-      internal_size_type i = 0;
-      defer_fail { destroy_n(dest, i); };
-      for(; i < n; ++i) {
+    if(!JACL_IS_CONSTANT_EVALUATED() && JACL_UNLIKELY(is_prefetch_worthy(n))) {
+      construct_n(dest, n, [&](internal_size_type i) {
+        JACL_PREFETCH(src + prefetch_index(i, n));
         construct_at(dest + i, std::move(src[i]));
         destroy_at(src + i);
+      });
+      return;
+    }
+    construct_n(dest, n, [&](internal_size_type i) {
+      construct_at(dest + i, std::move(src[i]));
+      destroy_at(src + i);
+    });
+  }
+
+  JACL_CONSTEXPR20 void move_data_forwards(pointer dest, pointer src, internal_size_type n) {
+    // `dest` precedes `src` and the ranges may overlap.
+    JACL_IF_CONSTEXPR(value_is_trivially_move_constructible && value_is_trivially_destructible) {
+      if(!JACL_IS_CONSTANT_EVALUATED()) {
+        std::memmove(static_cast<void*>(dest), src, n * sizeof(value_type));
+        return;
       }
     }
+    construct_n(dest, n, [&](internal_size_type i) {
+      construct_at(dest + i, std::move(src[i]));
+      destroy_at(src + i);
+    });
   }
 
-  void move_data_backwards(
+  JACL_CONSTEXPR20 void move_data_backwards(
       pointer JACL_RESTRICT dest, pointer JACL_RESTRICT src, internal_size_type n) {
+    // `dest` and `src` point one past the end of the ranges, and `src` is
+    // `end()`.
     JACL_IF_CONSTEXPR(value_is_trivially_move_constructible && value_is_trivially_destructible) {
-      std::memmove(dest, src, n * sizeof(value_type));
-    }
-    else {
-      internal_size_type i = n;
-      defer_fail { destroy_n(dest, n); };
-      while(i-- > 0) {
-        --dest;
-        --src;
-        construct_at(dest, std::move(*src));
-        destroy_at(src);
+      if(!JACL_IS_CONSTANT_EVALUATED()) {
+        std::memmove(static_cast<void*>(dest - n), src - n, n * sizeof(value_type));
+        return;
       }
     }
+    // Construct from the back so that overlapping ranges are not clobbered.
+    // If a move throws, the `i` elements built so far are `[dest - i, dest)`
+    // and their sources, the last `i` elements, are already destroyed. Drop
+    // both so that the vector stays valid with its first `size_ - i` elements.
+    auto construct = [&](internal_size_type i) {
+      construct_at(dest - i - 1, std::move(*(src - i - 1)));
+      destroy_at(src - i - 1);
+    };
+    construct_n(n, construct, [&](internal_size_type i) {
+      destroy_n(dest - i, i);
+      size_ -= i;
+    });
   }
 
   template <typename... argTs>
-  void fill_data(pointer JACL_RESTRICT dest, internal_size_type n, argTs&&... value) {
-    JACL_IF_CONSTEXPR(sizeof...(argTs) == 0 && value_is_trivially_constructible) return;
-    internal_size_type i = 0;
-    defer_fail { destroy_n(dest, i); };
-    for(; i < n; ++i) { construct_at(dest + i, std::forward<argTs>(value)...); }
+  JACL_CONSTEXPR20 void fill_data(
+      pointer JACL_RESTRICT dest, internal_size_type n, argTs&&... value) {
+    JACL_IF_CONSTEXPR(sizeof...(argTs) == 0 && value_is_trivially_constructible) {
+      if(!JACL_IS_CONSTANT_EVALUATED()) return;
+    }
+    construct_n(dest, n,
+        [&](internal_size_type i) { construct_at(dest + i, std::forward<argTs>(value)...); });
+  }
+
+  template <typename iterT>
+  JACL_CONSTEXPR20 void copy_iter(pointer JACL_RESTRICT dest, iterT first, internal_size_type n) {
+    construct_n(dest, n, [&](internal_size_type i) { construct_at(dest + i, *first++); });
   }
 
   template <typename callbackT>
-  void alloc_assign_internal(
+  JACL_CONSTEXPR20 void alloc_assign_internal(
       internal_size_type req_cap, internal_size_type cur_cap, callbackT&& cb) {
+    if(is_heap_allocated()) {
+      JACL_SMALL_VECTOR_STATS_RECORD(reallocations, 1);
+      JACL_SMALL_VECTOR_PROBE(realloc, cur_cap, req_cap);
+    } else {
+      JACL_SMALL_VECTOR_STATS_RECORD(spills, 1);
+      JACL_SMALL_VECTOR_PROBE(spill, cur_cap, req_cap);
+    }
+    JACL_SMALL_VECTOR_STATS_RECORD(bytes_relocated, size_ * sizeof(value_type));
+    if(JACL_IS_CONSTANT_EVALUATED()) {
+      auto alloc_result = allocate(req_cap);
+      size_             = cb(alloc_result.first);
+      deallocate(data_, cur_cap);
+      data_     = alloc_result.first;
+      capacity_ = alloc_result.second;
+    } else {
+      alloc_assign_guarded(req_cap, cur_cap, cb);
+    }
+  }
+
+  template <typename callbackT>
+  void alloc_assign_guarded(internal_size_type req_cap, internal_size_type cur_cap, callbackT& cb) {
     auto alloc_result      = allocate(req_cap);
     pointer new_data       = alloc_result.first;
     size_type new_capacity = alloc_result.second;
@@ -401,47 +826,51 @@ private:
     size_ = cb(new_data);
 
     std::swap(data_, new_data);
-    capacity_ = std::exchange(new_capacity, cur_cap);
+    capacity_ = internal::exchange(new_capacity, cur_cap);
   }
 
   template <typename callbackT>
-  void assign_internal(internal_size_type sz, internal_size_type cur_cap, callbackT&& cb) {
+  JACL_CONSTEXPR20 void assign_internal(
+      internal_size_type sz, internal_size_type cur_cap, callbackT&& cb) {
     if(sz > cur_cap) {
+      // The current elements are replaced, not moved to the new buffer.
+      clear();
       alloc_assign_internal(sz, cur_cap, std::forward<callbackT>(cb));
     } else {
       destroy_n(data_, size_);
       size_ = cb(data_);
     }
+    JACL_SMALL_VECTOR_STATS_RECORD(peak_size, size_);
+    JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, size_);
   }
 
-  void move_internal(small_vector&& other) {
+  JACL_CONSTEXPR20 void move_internal(small_vector&& other) {
     clear();
 
     if(other.is_heap_allocated()) {
       deallocate(data_, capacity());
 
       // Take ownership of the heap-allocated data from the other vector.
-      data_     = std::exchange(other.data_, reinterpret_cast<pointer>(other.inline_data_));
+      data_     = internal::exchange(other.data_, other.inline_data());
       capacity_ = other.capacity_;
     } else {
       // Copy into the existing buffer. `other` is using inline data, so this
       // vecor is guaranteed to have enough capacity.
       move_data(data_, other.data_, other.size_);
-      other.data_ = reinterpret_cast<pointer>(other.inline_data_);
+      other.data_ = other.inline_data();
     }
 
-    size_ = std::exchange(other.size_, 0);
+    size_ = internal::exchange(other.size_, 0);
+    JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, size_);
   }
 
   template <typename iterT>
-  void assign_iter(iterT first, iterT last, internal_size_type cur_cap) {
+  JACL_CONSTEXPR20 void assign_iter(iterT first, iterT last, internal_size_type cur_cap) {
     JACL_IF_CONSTEXPR(std::is_base_of<std::random_access_iterator_tag,
         typename std::iterator_traits<iterT>::iterator_category>::value) {
-      size_t sz = std::distance(first, last);
+      const auto sz = internal_size_type(std::distance(first, last));
       assign_internal(sz, cur_cap, [&](pointer JACL_RESTRICT dest) {
-        size_t i = 0;
-        defer_fail { destroy_n(dest, i); };
-        for(; i < sz; ++i) construct_at(dest + i, *first++);
+        copy_iter(dest, first, sz);
         return sz;
       });
     }
@@ -463,7 +892,10 @@ public:
    * @note This constructor is noexcept if the allocator's default constructor
    *       is noexcept.
    */
-  small_vector() noexcept(std::is_nothrow_default_constructible<allocator_type>::value) = default;
+  JACL_CONSTEXPR20 small_vector() noexcept(
+      std::is_nothrow_default_constructible<allocator_type>::value) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::construct);
+  }
 
   /**
    * @brief Constructs an empty small_vector with the given allocator.
@@ -473,11 +905,14 @@ public:
    *
    * @param a The allocator to use for memory allocation and deallocation
    */
-  explicit small_vector(const allocator_type& a) noexcept(
-      std::is_nothrow_copy_constructible<allocator_type>::value) : allocator_type{a} {}
+  explicit JACL_CONSTEXPR20 small_vector(const allocator_type& a) noexcept(
+      std::is_nothrow_copy_constructible<allocator_type>::value) : allocator_type{a} {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::construct);
+  }
 
-  explicit small_vector(size_type n, const allocator_type& a = allocator_type{}) :
+  explicit JACL_CONSTEXPR20 small_vector(size_type n, const allocator_type& a = allocator_type{}) :
       allocator_type{a} {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::construct);
     assign_internal(n, static_capacity, [&](pointer JACL_RESTRICT dest) {
       fill_data(dest, n);
       return n;
@@ -498,10 +933,11 @@ public:
    *
    * @throws May throw if the allocator copy constructor throws, otherwise noexcept
    */
-  small_vector(size_type n, const value_type& value,
+  JACL_CONSTEXPR20 small_vector(size_type n, const value_type& value,
       const allocator_type& a =
           allocator_type{}) noexcept(std::is_nothrow_copy_constructible<allocator_type>::value) :
       allocator_type{a} {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::construct);
     assign_internal(n, static_capacity, [&](pointer JACL_RESTRICT dest) {
       fill_data(dest, n, value);
       return n;
@@ -527,8 +963,11 @@ public:
   template <typename iterT,
       typename = typename std::enable_if<std::is_base_of<std::input_iterator_tag,
           typename std::iterator_traits<iterT>::iterator_category>::value>::type>
-  small_vector(iterT first, iterT last, const allocator_type& a = allocator_type{}) noexcept(
-      std::is_nothrow_copy_constructible<allocator_type>::value) : allocator_type{a} {
+  JACL_CONSTEXPR20 small_vector(iterT first, iterT last,
+      const allocator_type& a =
+          allocator_type{}) noexcept(std::is_nothrow_copy_constructible<allocator_type>::value) :
+      allocator_type{a} {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::construct);
     assign_iter(first, last, static_capacity);
   }
 
@@ -547,10 +986,11 @@ public:
    * @note This constructor is noexcept if both the value_type and allocator_type
    *       have nothrow copy constructors.
    */
-  small_vector(const small_vector& other) noexcept(
+  JACL_CONSTEXPR20 small_vector(const small_vector& other) noexcept(
       std::is_nothrow_copy_constructible<value_type>::value &&
       std::is_nothrow_copy_constructible<allocator_type>::value) :
       allocator_type{allocator_traits::select_on_container_copy_construction(other.allocator())} {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::copy_construct, 0, &other);
     assign_internal(other.size_, static_capacity, [&](pointer JACL_RESTRICT dest) {
       copy_data(dest, other.data_, other.size_);
       return other.size_;
@@ -575,9 +1015,10 @@ public:
    * @complexity Linear with the number of elements in `other` if moving from inline storage.
    * Otherwise constant time if moving from heap storage.
    */
-  small_vector(small_vector&& other) noexcept(
+  JACL_CONSTEXPR20 small_vector(small_vector&& other) noexcept(
       std::is_nothrow_move_constructible<allocator_type>::value) :
       allocator_type{std::move(static_cast<allocator_type&>(other))} {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::move_construct, 0, &other);
     move_internal(std::move(other));
   }
 
@@ -596,7 +1037,7 @@ public:
    *
    * @note This constructor allows syntax like: small_vector<int> v = {1, 2, 3, 4};
    */
-  small_vector(std::initializer_list<value_type> il) noexcept(
+  JACL_CONSTEXPR20 small_vector(std::initializer_list<value_type> il) noexcept(
       std::is_nothrow_copy_constructible<value_type>::value &&
       std::is_nothrow_copy_constructible<allocator_type>::value) :
       small_vector{il.begin(), il.end(), allocator_type{}} {}
@@ -612,14 +1053,17 @@ public:
    *
    * @throws No exceptions if both value_type and allocator_type are nothrow copy constructible
    */
-  small_vector(std::initializer_list<value_type> il, const allocator_type& a) noexcept(
+  JACL_CONSTEXPR20 small_vector(
+      std::initializer_list<value_type> il, const allocator_type& a) noexcept(
       std::is_nothrow_copy_constructible<value_type>::value &&
       std::is_nothrow_copy_constructible<allocator_type>::value) :
       small_vector{il.begin(), il.end(), a} {}
 
-  ~small_vector() {
+  JACL_CONSTEXPR20 ~small_vector() {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::destroy);
+    JACL_SMALL_VECTOR_PROFILE_DESTROY();
     destroy_n(data_, size_);
-    deallocate(data_, capacity_);
+    deallocate(data_, capacity());
   }
 
   /**
@@ -636,14 +1080,15 @@ public:
    * @param other The small_vector to copy from
    * @return Reference to this small_vector after assignment
    */
-  small_vector& operator=(const small_vector& other) {
+  JACL_CONSTEXPR20 small_vector& operator=(const small_vector& other) {
     if(this == &other) return *this;
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::copy_assign, 0, &other);
 
     JACL_IF_CONSTEXPR(allocator_traits::propagate_on_container_copy_assignment::value) {
       if(other.is_heap_allocated() && allocator() != other.allocator()) {
         clear();
-        deallocate(data_, capacity_);
-        data_       = reinterpret_cast<pointer>(inline_data_);
+        deallocate(data_, capacity());
+        data_       = inline_data();
         allocator() = other.allocator();
       }
     }
@@ -670,19 +1115,20 @@ public:
    * @param other The small_vector to move from
    * @return Reference to this small_vector after the move assignment
    */
-  small_vector& operator=(small_vector&& other)
+  JACL_CONSTEXPR20 small_vector& operator=(small_vector&& other)
 #if __cplusplus >= 201703L
       noexcept(allocator_traits::propagate_on_container_move_assignment::value ||
                allocator_traits::is_always_equal::value)
 #endif // __cplusplus >= 201703L
   {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::move_assign, 0, &other);
     // Destroy existing elements to make room for the new elements.
 
     JACL_IF_CONSTEXPR(allocator_traits::propagate_on_container_move_assignment::value) {
       if(allocator() != other.allocator()) {
         clear();
-        deallocate(data_, capacity_);
-        data_       = reinterpret_cast<pointer>(inline_data_);
+        deallocate(data_, capacity());
+        data_       = inline_data();
         allocator() = std::move(other.allocator());
       }
     }
@@ -692,13 +1138,15 @@ public:
     return *this;
   }
 
-  small_vector& operator=(std::initializer_list<value_type> il) {
+  JACL_CONSTEXPR20 small_vector& operator=(std::initializer_list<value_type> il) {
     assign(il.begin(), il.end());
     return *this;
   }
 
-  template <typename iterT>
-  void assign(iterT first, iterT last) {
+  template <typename iterT,
+      typename = typename std::enable_if<std::is_base_of<std::input_iterator_tag,
+          typename std::iterator_traits<iterT>::iterator_category>::value>::type>
+  JACL_CONSTEXPR20 void assign(iterT first, iterT last) {
     static_assert(
         std::is_constructible<value_type, typename std::iterator_traits<iterT>::reference>::value,
         "small_vector::assign: value type is not constructible from the "
@@ -706,60 +1154,82 @@ public:
     static_assert(!std::is_base_of<std::output_iterator_tag,
                       typename std::iterator_traits<iterT>::iterator_category>::value,
         "small_vector::assign: output iterators are not allowed");
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::assign);
     assign_iter(first, last, capacity());
   }
 
-  void assign(size_type sz, const value_type& val) {
+  JACL_CONSTEXPR20 void assign(size_type sz, const value_type& val) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::assign);
     assign_internal(sz, capacity(), [&](pointer JACL_RESTRICT dest) {
       fill_data(dest, sz, val);
       return sz;
     });
   }
 
-  void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+  JACL_CONSTEXPR20 void assign(std::initializer_list<value_type> il) {
+    assign(il.begin(), il.end());
+  }
 
-  const allocator_type& get_allocator() const noexcept { return *this; }
+  JACL_CONSTEXPR20 const allocator_type& get_allocator() const noexcept { return *this; }
 
-  iterator begin() noexcept { return data_; }
+  JACL_CONSTEXPR20 iterator begin() noexcept { return data_; }
 
-  const_iterator begin() const noexcept { return data_; }
+  JACL_CONSTEXPR20 const_iterator begin() const noexcept { return data_; }
 
-  iterator end() noexcept { return data_ + size_; }
+  JACL_CONSTEXPR20 iterator end() noexcept { return data_ + size_; }
 
-  const_iterator end() const noexcept { return data_ + size_; }
+  JACL_CONSTEXPR20 const_iterator end() const noexcept { return data_ + size_; }
 
-  reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+  JACL_CONSTEXPR20 reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
 
-  const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+  JACL_CONSTEXPR20 const_reverse_iterator rbegin() const noexcept {
+    return const_reverse_iterator(end());
+  }
 
-  reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+  JACL_CONSTEXPR20 reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
 
-  const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+  JACL_CONSTEXPR20 const_reverse_iterator rend() const noexcept {
+    return const_reverse_iterator(begin());
+  }
 
-  const_iterator cbegin() const noexcept { return begin(); }
+  JACL_CONSTEXPR20 const_iterator cbegin() const noexcept { return begin(); }
 
-  const_iterator cend() const noexcept { return end(); }
+  JACL_CONSTEXPR20 const_iterator cend() const noexcept { return end(); }
 
-  const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+  JACL_CONSTEXPR20 const_reverse_iterator crbegin() const noexcept { return rbegin(); }
 
-  const_reverse_iterator crend() const noexcept { return rend(); }
+  JACL_CONSTEXPR20 const_reverse_iterator crend() const noexcept { return rend(); }
 
-  size_type size() const noexcept { return size_; }
+  JACL_CONSTEXPR20 size_type size() const noexcept { return size_; }
 
   static constexpr size_type max_size() noexcept {
     return std::numeric_limits<internal_size_type>::max() / sizeof(value_type);
   }
 
-  size_type capacity() const noexcept { return is_heap_allocated() ? capacity_ : static_capacity; }
+  JACL_CONSTEXPR20 size_type capacity() const noexcept {
+    return is_heap_allocated() ? size_type(capacity_) : size_type(static_capacity);
+  }
 
-  bool empty() const noexcept { return size_ == 0; }
+  /**
+   * @brief Bytes of the heap buffer owned by the vector; 0 while inline.
+   */
+  JACL_CONSTEXPR20 size_type heap_bytes() const noexcept {
+    return is_heap_allocated() ? size_type(capacity_) * sizeof(value_type) : 0;
+  }
 
-  reference operator[](size_type n) { return data_[n]; }
-  const_reference operator[](size_type n) const {
-    const_cast<const_reference>(
-        const_cast<small_vector<valueT, sizeN, allocT>*>(this)->operator[](n));
+  /**
+   * @brief Bytes used by the vector itself and its heap buffer. Memory owned
+   * by the elements is not included.
+   */
+  JACL_CONSTEXPR20 size_type memory_usage() const noexcept {
+    return sizeof(*this) + heap_bytes();
   }
-  reference at(size_type n) {
+
+  JACL_CONSTEXPR20 bool empty() const noexcept { return size_ == 0; }
+
+  JACL_CONSTEXPR20 reference operator[](size_type n) { return data_[n]; }
+  JACL_CONSTEXPR20 const_reference operator[](size_type n) const { return data_[n]; }
+  JACL_CONSTEXPR20 reference at(size_type n) {
     if(n >= size_) {
 #if !JACL_NO_EXCEPTIONS
       throw std::out_of_range{"small_vector::at"};
@@ -769,29 +1239,30 @@ public:
     }
     return data_[n];
   }
-  const_reference at(size_type n) const {
+  JACL_CONSTEXPR20 const_reference at(size_type n) const {
     return const_cast<const_reference>(
         const_cast<small_vector<valueT, sizeN, allocT>*>(this)->at(n));
   }
 
-  reference front() { return data_[0]; }
-  const_reference front() const {
+  JACL_CONSTEXPR20 reference front() { return data_[0]; }
+  JACL_CONSTEXPR20 const_reference front() const {
     return const_cast<const_reference>(
         const_cast<small_vector<valueT, sizeN, allocT>*>(this)->front());
   }
-  reference back() { return data_[size_ - 1]; }
-  const_reference back() const {
+  JACL_CONSTEXPR20 reference back() { return data_[size_ - 1]; }
+  JACL_CONSTEXPR20 const_reference back() const {
     return const_cast<const_reference>(
         const_cast<small_vector<valueT, sizeN, allocT>*>(this)->back());
   }
 
-  pointer data() noexcept { return data_; }
-  const_pointer data() const noexcept { return data_; }
+  JACL_CONSTEXPR20 pointer data() noexcept { return data_; }
+  JACL_CONSTEXPR20 const_pointer data() const noexcept { return data_; }
 
-  void push_back(const value_type& x) { emplace_back(x); }
-  void push_back(value_type&& x) { emplace_back(std::move(x)); }
+  JACL_CONSTEXPR20 void push_back(const value_type& x) { emplace_back(x); }
+  JACL_CONSTEXPR20 void push_back(value_type&& x) { emplace_back(std::move(x)); }
   template <class... Args>
-  reference emplace_back(Args&&... args) {
+  JACL_CONSTEXPR20 reference emplace_back(Args&&... args) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::emplace_back);
     auto cur_cap = capacity();
     if(JACL_UNLIKELY(size_ == cur_cap)) {
       auto new_size = std::min<internal_size_type>(size_ + (size_ >> 1) + 1, max_size());
@@ -800,17 +1271,21 @@ public:
 
     reference result = *construct_at(data_ + size_, std::forward<Args>(args)...);
     ++size_;
+    JACL_SMALL_VECTOR_STATS_RECORD(peak_size, size_);
+    JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, size_);
     return result;
   }
 
-  void pop_back() {
+  JACL_CONSTEXPR20 void pop_back() {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::pop_back);
     const internal_size_type offset = size_ - 1;
     destroy_at(data_ + offset);
     size_ = offset;
   }
 
   template <typename... Args>
-  iterator emplace(const_iterator position, Args&&... args) {
+  JACL_CONSTEXPR20 iterator emplace(const_iterator position, Args&&... args) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::insert, position - cbegin());
     return insert_impl(
         position, 1,
         [&](pointer JACL_RESTRICT const p) { construct_at(p, std::forward<Args>(args)...); },
@@ -820,36 +1295,42 @@ public:
   }
 
   template <typename iterT>
-  iterator insert(const_iterator position, iterT first, iterT last) {
+  JACL_CONSTEXPR20 iterator insert(const_iterator position, iterT first, iterT last) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::insert, position - cbegin());
+    const auto n = internal_size_type(std::distance(first, last));
     return insert_impl(
-        position, std::distance(first, last),
-        [&](pointer JACL_RESTRICT const p) { std::uninitialized_copy(first, last, p); },
+        position, n, [&](pointer JACL_RESTRICT const p) { copy_iter(p, first, n); },
         [](size_type, size_type min_size) { return min_size; });
   }
 
-  iterator insert(const_iterator position, std::initializer_list<value_type> il) {
+  JACL_CONSTEXPR20 iterator insert(const_iterator position, std::initializer_list<value_type> il) {
     return insert(position, il.begin(), il.end());
   }
 
-  iterator erase(const_iterator position) { return erase(position, position + 1); }
+  JACL_CONSTEXPR20 iterator erase(const_iterator position) { return erase(position, position + 1); }
 
-  iterator erase(const_iterator first, const_iterator last) {
-    if(first == last) return const_cast<iterator>(first);
+  JACL_CONSTEXPR20 iterator erase(const_iterator first, const_iterator last) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::erase, first - cbegin());
+    pointer const dest = const_cast<pointer>(first);
+    if(first == last) return dest;
 
-    const auto sz = internal_size_type(std::distance(first, last));
-    destroy_n(first, sz);
-    move_data(first, last, sz);
+    pointer const src = const_cast<pointer>(last);
+    const auto sz     = internal_size_type(std::distance(first, last));
+    destroy_n(dest, sz);
+    move_data_forwards(dest, src, internal_size_type(end() - src));
     size_ -= sz;
 
-    return first;
+    return dest;
   }
 
-  void clear() noexcept {
+  JACL_CONSTEXPR20 void clear() noexcept {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::clear);
     destroy_n(data_, size_);
     size_ = 0;
   }
 
-  void reserve(size_type sz) {
+  JACL_CONSTEXPR20 void reserve(size_type sz) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::reserve, sz);
     size_type cur_cap = capacity();
     if(sz > cur_cap) {
       alloc_assign_internal(sz, cur_cap, [&](pointer JACL_RESTRICT const dest) {
@@ -860,13 +1341,20 @@ public:
     }
   }
 
-  void shrink_to_fit() noexcept {
+  JACL_CONSTEXPR20 void shrink_to_fit() noexcept {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::shrink_to_fit);
+    // The inline buffer cannot shrink.
+    if(!is_heap_allocated()) return;
+
     size_type cur_cap = capacity();
-    if(size_ < static_capacity && cur_cap > static_capacity) {
+    if(size_ <= static_capacity) {
       // Shrink to inline data.
+      JACL_SMALL_VECTOR_STATS_RECORD(shrinks_to_inline, 1);
+      JACL_SMALL_VECTOR_STATS_RECORD(bytes_relocated, size_ * sizeof(value_type));
+      JACL_SMALL_VECTOR_PROBE(shrink_to_inline, cur_cap, static_capacity);
       move_data(inline_data_, data_, size_);
       deallocate(data_, cur_cap);
-      data_ = reinterpret_cast<pointer>(inline_data_);
+      data_ = inline_data();
     } else if(size_ != cur_cap) {
       // Shrink to new allocation.
       alloc_assign_internal(size_, cur_cap, [&](pointer JACL_RESTRICT const dest) {
@@ -877,28 +1365,56 @@ public:
     }
   }
 
-  void resize(size_type sz) {
+  JACL_CONSTEXPR20 void resize(size_type sz) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::resize);
     if(sz > size_) {
       reserve(sz);
       fill_data(data_ + size_, sz - size_);
+      JACL_SMALL_VECTOR_STATS_RECORD(peak_size, sz);
+      JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, sz);
     } else if(sz < size_) {
       destroy_n(data_ + sz, size_ - sz);
     }
     size_ = sz;
   }
 
-  void resize(size_type sz, const value_type& value) {
+  JACL_CONSTEXPR20 void resize(size_type sz, const value_type& value) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::resize);
     if(sz > size_) {
       reserve(sz);
       fill_data(data_ + size_, sz - size_, value);
+      JACL_SMALL_VECTOR_STATS_RECORD(peak_size, sz);
+      JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, sz);
     } else if(sz < size_) {
       destroy_n(data_ + sz, size_ - sz);
     }
     size_ = sz;
   }
 
-  void swap(small_vector& other) noexcept(allocator_traits::propagate_on_container_swap::value ||
-                                          allocator_traits::is_always_equal::value) {
+  /**
+   * @brief Raises the capacity to `sz`, then lets `op(data(), sz)` write the
+   * first `sz` elements and return the new size, at most `sz`.
+   *
+   * As with `std::basic_string::resize_and_overwrite`, elements past the old
+   * size are left uninitialized for `op` to fill, so this is limited to
+   * trivially copyable types.
+   */
+  template <typename opT>
+  JACL_CONSTEXPR20 void resize_and_overwrite(size_type sz, opT op) {
+    static_assert(std::is_trivially_copyable<value_type>::value,
+        "resize_and_overwrite requires a trivially copyable value_type");
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::resize);
+    reserve(sz);
+    const size_type new_size = size_type(op(data_, sz));
+    JACL_SMALL_VECTOR_STATS_RECORD(peak_size, new_size);
+    JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, new_size);
+    size_ = internal_size_type(new_size);
+  }
+
+  JACL_CONSTEXPR20 void swap(small_vector& other) noexcept(
+      allocator_traits::propagate_on_container_swap::value ||
+      allocator_traits::is_always_equal::value) {
+    JACL_SMALL_VECTOR_TRACE_SCOPE(trace::op::swap, 0, &other);
     auto swap_allocator = [](allocator_type& l, allocator_type& r) {
       JACL_IF_CONSTEXPR(allocator_traits::propagate_on_container_swap::value) { std::swap(l, r); }
     };
@@ -925,8 +1441,8 @@ public:
       const auto l_capacity = l.capacity_;
 
       move_data(l.inline_data_, r.data_, r.size_);
-      l.data_ = reinterpret_cast<pointer>(l.inline_data_);
-      l.size_ = other.size_;
+      l.data_ = l.inline_data();
+      l.size_ = r.size_;
 
       r.data_     = l_data;
       r.size_     = l_size;
@@ -934,6 +1450,8 @@ public:
     };
 
     if(this == &other) return;
+    JACL_SMALL_VECTOR_PROFILE_OBSERVE(*this, other.size_);
+    JACL_SMALL_VECTOR_PROFILE_OBSERVE(other, size_);
     switch(is_heap_allocated() | (other.is_heap_allocated() << 1)) {
     case 0x0:
       // Both are inline; swap the elements.
@@ -964,12 +1482,31 @@ public:
   }
 }; // class small_vector
 
+// X-macro listing the (element type, inline size) pairs that are explicitly
+// instantiated by the small_vector_instantiations library.
+#define JACL_SMALL_VECTOR_COMMON_INSTANTIATIONS(X) \
+  X(char, 16)                                       \
+  X(int, 8)                                         \
+  X(unsigned, 8)                                    \
+  X(std::int64_t, 8)                                \
+  X(std::uint64_t, 8)                               \
+  X(float, 8)                                       \
+  X(double, 8)                                      \
+  X(void*, 8)
+
+#if JACL_SMALL_VECTOR_EXTERN_TEMPLATES
+#define JACL_SMALL_VECTOR_EXTERN_TEMPLATE(valueT, sizeN) \
+  extern template class small_vector<valueT, sizeN>;
+JACL_SMALL_VECTOR_COMMON_INSTANTIATIONS(JACL_SMALL_VECTOR_EXTERN_TEMPLATE)
+#undef JACL_SMALL_VECTOR_EXTERN_TEMPLATE
+#endif // JACL_SMALL_VECTOR_EXTERN_TEMPLATES
+
 } // namespace jacl
 
 namespace std {
 
 template <typename valueT, size_t sizeN, typename allocT>
-void swap(jacl::small_vector<valueT, sizeN, allocT>& lhs,
+JACL_CONSTEXPR20 void swap(jacl::small_vector<valueT, sizeN, allocT>& lhs,
     jacl::small_vector<valueT, sizeN, allocT>& rhs) noexcept(noexcept(lhs.swap(rhs))) {
   lhs.swap(rhs);
 }
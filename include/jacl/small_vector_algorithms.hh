@@ -0,0 +1,464 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#ifndef JACL_CONCAT_BYTES_PER_THREAD
+// `concat` of trivially copyable elements starts another copying thread for
+// every this many bytes, up to the thread limit. 0 copies on the calling
+// thread only.
+#define JACL_CONCAT_BYTES_PER_THREAD (4u << 20)
+#endif // JACL_CONCAT_BYTES_PER_THREAD
+
+namespace jacl {
+namespace internal {
+
+// The element iterator of a container in `rangeT`, wrapped to move elements
+// out when the range is an rvalue.
+template <typename rangeT>
+struct range_source {
+  using container_type = typename std::remove_reference<decltype(*std::begin(
+      std::declval<rangeT&>()))>::type;
+  using base_iterator  = decltype(std::begin(std::declval<container_type&>()));
+  using iterator = typename std::conditional<std::is_rvalue_reference<rangeT&&>::value,
+      std::move_iterator<base_iterator>, base_iterator>::type;
+
+  static iterator begin(container_type& c) { return iterator(std::begin(c)); }
+  static iterator end(container_type& c) { return iterator(std::end(c)); }
+}; // struct range_source
+
+template <typename containerT>
+struct is_small_vector : std::false_type {};
+
+template <typename valueT, size_t sizeN, typename allocT>
+struct is_small_vector<small_vector<valueT, sizeN, allocT>> : std::true_type {};
+
+// Reserves room for `n` more elements in containers that can reserve.
+template <typename containerT>
+auto reserve_more(containerT& c, std::size_t n, int) -> decltype(c.reserve(n), void()) {
+  c.reserve(c.size() + n);
+}
+
+template <typename containerT>
+void reserve_more(containerT&, std::size_t, long) {}
+
+/**
+ * @brief A tournament tree over `k` sorted runs whose inner nodes hold the
+ * loser of the match played there and whose root holds the overall winner.
+ *
+ * Replacing the winner replays only the matches on its leaf-to-root path, one
+ * comparison per level, against losers stored contiguously in one array.
+ * Ties go to the run with the lower index, so merges are stable.
+ */
+template <typename iterT, typename compareT>
+class loser_tree {
+public:
+  loser_tree(iterT* cur, const iterT* end, std::size_t k, compareT& comp)
+      : cur_{cur}, end_{end}, comp_{comp} {
+    leaves_ = 1;
+    while(leaves_ < k) leaves_ *= 2;
+    k_ = k;
+
+    small_vector<std::size_t, 64> winner(2 * leaves_);
+    for(std::size_t i = 0; i < leaves_; ++i) winner[leaves_ + i] = i;
+    tree_.resize(leaves_);
+    for(std::size_t node = leaves_ - 1; node >= 1; --node) {
+      const std::size_t a = winner[2 * node];
+      const std::size_t b = winner[2 * node + 1];
+      if(beats(a, b)) {
+        winner[node] = a;
+        tree_[node]  = b;
+      } else {
+        winner[node] = b;
+        tree_[node]  = a;
+      }
+    }
+    tree_[0] = winner[1];
+  }
+
+  /// @brief The run holding the smallest remaining element.
+  std::size_t winner() const noexcept { return tree_[0]; }
+
+  /// @brief Advances the winning run and replays its matches.
+  void pop() {
+    std::size_t w = tree_[0];
+    ++cur_[w];
+    for(std::size_t node = (leaves_ + w) / 2; node >= 1; node /= 2) {
+      if(beats(tree_[node], w)) std::swap(tree_[node], w);
+    }
+    tree_[0] = w;
+  }
+
+private:
+  bool exhausted(std::size_t i) const { return i >= k_ || cur_[i] == end_[i]; }
+
+  bool beats(std::size_t a, std::size_t b) const {
+    if(exhausted(a)) return false;
+    if(exhausted(b)) return true;
+    if(comp_(*cur_[a], *cur_[b])) return true;
+    return !comp_(*cur_[b], *cur_[a]) && a < b;
+  }
+
+  iterT* cur_;
+  const iterT* end_;
+  compareT& comp_;
+  std::size_t k_;
+  std::size_t leaves_;
+  small_vector<std::size_t, 64> tree_;
+}; // class loser_tree
+
+// Two-way merge of arithmetic values into a small vector: the output is
+// written through a pointer into uninitialized capacity and the selection is
+// a conditional move instead of a branch, so unpredictable comparisons cost
+// no mispredictions.
+template <typename iterT, typename outT, typename compareT>
+void merge_two(iterT a, iterT a_end, iterT b, iterT b_end, outT& out, compareT& comp,
+    std::true_type /* branchless */) {
+  using value_type          = typename outT::value_type;
+  const std::size_t old_end = out.size();
+  const std::size_t n       = std::size_t(a_end - a) + std::size_t(b_end - b);
+  out.resize_and_overwrite(old_end + n, [&](value_type* d, std::size_t sz) {
+    d += old_end;
+    while(a != a_end && b != b_end) {
+      const value_type va = *a;
+      const value_type vb = *b;
+      const bool take_b   = comp(vb, va);
+      *d++                = take_b ? vb : va;
+      a += !take_b;
+      b += take_b;
+    }
+    for(; a != a_end; ++a) *d++ = *a;
+    for(; b != b_end; ++b) *d++ = *b;
+    return sz;
+  });
+}
+
+template <typename iterT, typename outT, typename compareT>
+void merge_two(iterT a, iterT a_end, iterT b, iterT b_end, outT& out, compareT& comp,
+    std::false_type /* branchless */) {
+  while(a != a_end && b != b_end) {
+    if(comp(*b, *a)) {
+      out.emplace_back(*b);
+      ++b;
+    } else {
+      out.emplace_back(*a);
+      ++a;
+    }
+  }
+  for(; a != a_end; ++a) out.emplace_back(*a);
+  for(; b != b_end; ++b) out.emplace_back(*b);
+}
+
+template <typename containerT>
+struct concat_result;
+
+template <typename valueT, size_t sizeN, typename allocT>
+struct concat_result<small_vector<valueT, sizeN, allocT>> {
+  using type = small_vector<valueT, sizeN, allocT>;
+}; // struct concat_result
+
+template <typename resultT, typename rangeT>
+struct concat_result_for {
+  using type = resultT;
+}; // struct concat_result_for
+
+template <typename rangeT>
+struct concat_result_for<void, rangeT> {
+  using type = typename concat_result<
+      typename std::remove_const<typename range_source<rangeT>::container_type>::type>::type;
+}; // struct concat_result_for
+
+// Copies elements [first, last) of the concatenation of the segments to
+// `out`. Segment `s` holds the elements [offsets[s], offsets[s + 1]).
+template <typename valueT>
+void copy_segments(const valueT* const* segments, const std::size_t* offsets, std::size_t count,
+    std::size_t first, std::size_t last, valueT* out) noexcept {
+  std::size_t s = std::size_t(std::upper_bound(offsets, offsets + count, first) - offsets) - 1;
+  for(; first < last; ++s) {
+    const std::size_t end = std::min(last, offsets[s + 1]);
+    if(end > first) {
+      std::memcpy(out + first, segments[s] + (first - offsets[s]), (end - first) * sizeof(valueT));
+    }
+    first = end;
+  }
+}
+
+// Splits the concatenation into `threads` equal ranges and copies them
+// concurrently. Ranges whose thread cannot be started are copied by the
+// calling thread.
+template <typename valueT>
+void parallel_copy_segments(const valueT* const* segments, const std::size_t* offsets,
+    std::size_t count, std::size_t threads, valueT* out) {
+  const std::size_t total = offsets[count];
+  small_vector<std::thread, 16> workers;
+#if !JACL_NO_EXCEPTIONS
+  try {
+#endif // !JACL_NO_EXCEPTIONS
+    for(std::size_t t = 1; t < threads; ++t) {
+      workers.emplace_back(copy_segments<valueT>, segments, offsets, count, total * t / threads,
+          total * (t + 1) / threads, out);
+    }
+#if !JACL_NO_EXCEPTIONS
+  } catch(const std::system_error&) {
+  }
+#endif // !JACL_NO_EXCEPTIONS
+  const std::size_t started = workers.size() + 1;
+  copy_segments(segments, offsets, count, 0, total / threads, out);
+  copy_segments(segments, offsets, count, total * started / threads, total, out);
+  for(std::thread& worker : workers) worker.join();
+}
+
+template <typename rangeT, typename resultT>
+void concat_into(rangeT&& inputs, resultT& result, std::size_t total, std::size_t max_threads,
+    std::true_type /* trivially copyable */) {
+  using value_type = typename resultT::value_type;
+  small_vector<const value_type*, 16> segments;
+  small_vector<std::size_t, 16> offsets{0};
+  for(auto& c : inputs) {
+    segments.push_back(c.data());
+    offsets.push_back(offsets.back() + std::size_t(c.size()));
+  }
+
+  std::size_t threads = 1;
+#if JACL_CONCAT_BYTES_PER_THREAD > 0
+  if(max_threads == 0) max_threads = std::thread::hardware_concurrency();
+  const std::size_t by_size = total * sizeof(value_type) / JACL_CONCAT_BYTES_PER_THREAD;
+  threads                   = std::max<std::size_t>(1, std::min(max_threads, by_size));
+#else
+  (void)max_threads;
+#endif // JACL_CONCAT_BYTES_PER_THREAD > 0
+
+  result.resize_and_overwrite(total, [&](value_type* out, std::size_t n) {
+    if(threads > 1) {
+      parallel_copy_segments(segments.data(), offsets.data(), segments.size(), threads, out);
+    } else {
+      copy_segments(segments.data(), offsets.data(), segments.size(), 0, n, out);
+    }
+    return n;
+  });
+}
+
+template <typename rangeT, typename resultT>
+void concat_into(rangeT&& inputs, resultT& result, std::size_t total, std::size_t /* max_threads */,
+    std::false_type /* trivially copyable */) {
+  using source = range_source<rangeT>;
+  result.reserve(total);
+  for(auto& c : inputs) result.insert(result.end(), source::begin(c), source::end(c));
+}
+
+// `x` as an rvalue if it is an element of the rvalue range `rangeT`.
+template <typename rangeT, typename T>
+typename std::conditional<std::is_rvalue_reference<rangeT&&>::value, T&&, T&>::type
+forward_element(T& x) noexcept {
+  return static_cast<
+      typename std::conditional<std::is_rvalue_reference<rangeT&&>::value, T&&, T&>::type>(x);
+}
+
+// The bytes of a software write-combining buffer: one cache line per bucket.
+constexpr std::size_t write_combining_bytes = 64;
+
+// Scatters through a cache-line buffer per bucket, flushed to the bucket a
+// full line at a time. With many buckets, the buffers stay in L1 and each
+// destination line is written whole, instead of every element touching a
+// different destination line.
+template <typename rangeT, typename keyFnT, typename bucketIterT>
+void scatter(rangeT&& src, keyFnT& key_fn, bucketIterT buckets, const std::size_t* counts,
+    std::size_t bucket_count, std::true_type /* write combining */) {
+  using bucket_type = typename std::iterator_traits<bucketIterT>::value_type;
+  using value_type  = typename bucket_type::value_type;
+  constexpr std::size_t element_bytes = sizeof(value_type);
+  constexpr std::size_t line_elements = write_combining_bytes / element_bytes;
+  constexpr std::size_t line_bytes    = line_elements * element_bytes;
+
+  small_vector<unsigned char*, 64> dest(bucket_count);
+  for(std::size_t b = 0; b < bucket_count; ++b) {
+    bucket_type& bucket  = buckets[b];
+    const std::size_t sz = bucket.size();
+    bucket.resize_and_overwrite(sz + counts[b], [](value_type*, std::size_t n) { return n; });
+    dest[b] = reinterpret_cast<unsigned char*>(bucket.data() + sz);
+  }
+
+  small_vector<unsigned char, 1> storage;
+  storage.resize_and_overwrite((bucket_count + 1) * write_combining_bytes,
+      [](unsigned char*, std::size_t n) { return n; });
+  const std::size_t misalignment =
+      reinterpret_cast<std::uintptr_t>(storage.data()) % write_combining_bytes;
+  unsigned char* const lines =
+      storage.data() + (misalignment == 0 ? 0 : write_combining_bytes - misalignment);
+  small_vector<std::uint8_t, 64> fill(bucket_count, 0);
+
+  for(auto& x : src) {
+    const std::size_t b = std::size_t(key_fn(x));
+    unsigned char* line = lines + b * write_combining_bytes;
+    std::size_t slot    = fill[b];
+    std::memcpy(line + slot * element_bytes, std::addressof(x), element_bytes);
+    if(++slot == line_elements) {
+      std::memcpy(dest[b], line, line_bytes);
+      dest[b] += line_bytes;
+      slot = 0;
+    }
+    fill[b] = std::uint8_t(slot);
+  }
+  for(std::size_t b = 0; b < bucket_count; ++b) {
+    if(fill[b] != 0) {
+      std::memcpy(dest[b], lines + b * write_combining_bytes, fill[b] * element_bytes);
+    }
+  }
+}
+
+template <typename rangeT, typename keyFnT, typename bucketIterT>
+void scatter(rangeT&& src, keyFnT& key_fn, bucketIterT buckets, const std::size_t* counts,
+    std::size_t bucket_count, std::false_type /* write combining */) {
+  for(std::size_t b = 0; b < bucket_count; ++b) {
+    buckets[b].reserve(buckets[b].size() + counts[b]);
+  }
+  for(auto& x : src) {
+    buckets[std::size_t(key_fn(x))].emplace_back(forward_element<rangeT>(x));
+  }
+}
+
+} // namespace internal
+
+/**
+ * @brief Concatenates a range of vectors into one `small_vector`.
+ *
+ * The result is allocated once for the total size. Trivially copyable
+ * elements are then copied segment by segment at offsets given by a prefix
+ * sum of the sizes. Past `JACL_CONCAT_BYTES_PER_THREAD` bytes, the copy is
+ * split into equal byte ranges and runs on up to `max_threads` threads
+ * (0: the hardware concurrency). Other elements are copied in order, or
+ * moved if `inputs` is an rvalue.
+ *
+ * @tparam resultT The type of the result. By default, that of the inputs,
+ * which must then be `small_vector`s.
+ * @param inputs A range of contiguous containers, e.g. per-thread results.
+ * @param max_threads The most threads to copy on, including the caller.
+ */
+template <typename resultT = void, typename rangeT>
+typename internal::concat_result_for<resultT, rangeT>::type concat(
+    rangeT&& inputs, std::size_t max_threads = 0) {
+  using result_type = typename internal::concat_result_for<resultT, rangeT>::type;
+  using value_type  = typename result_type::value_type;
+  using source      = internal::range_source<rangeT>;
+  using trivial     = std::integral_constant<bool,
+      std::is_trivially_copyable<value_type>::value &&
+          std::is_same<value_type, typename std::iterator_traits<
+                                       typename source::base_iterator>::value_type>::value>;
+
+  std::size_t total = 0;
+  for(auto& c : inputs) total += std::size_t(std::distance(std::begin(c), std::end(c)));
+
+  result_type result;
+  internal::concat_into(std::forward<rangeT>(inputs), result, total, max_threads, trivial{});
+  return result;
+}
+
+/**
+ * @brief Appends the stable merge of the sorted containers in `inputs` to `out`.
+ *
+ * The output is reserved once for all elements if it has `reserve`. Two
+ * inputs are merged directly, branch-free for arithmetic types appended to a
+ * `small_vector`; more are merged through a loser tree, at one comparison per
+ * level of the tree per element. Once a single input remains, its tail is
+ * appended without comparisons.
+ *
+ * If `inputs` is an rvalue, elements are moved out of the containers, which
+ * then hold moved-from elements; this merges move-only types. Otherwise
+ * elements are copied.
+ *
+ * @param inputs A range of containers, each sorted by `comp`.
+ * @param out The container to append to, e.g. a `small_vector`.
+ * @param comp The strict weak ordering the inputs are sorted by.
+ * @complexity O(n log k) comparisons for `n` elements in `k` inputs.
+ */
+template <typename rangeT, typename outT,
+    typename compareT = std::less<typename outT::value_type>>
+void merge_k(rangeT&& inputs, outT& out, compareT comp = compareT{}) {
+  using source   = internal::range_source<rangeT>;
+  using iterator = typename source::iterator;
+
+  small_vector<iterator, 16> cur;
+  small_vector<iterator, 16> end;
+  std::size_t total = 0;
+  for(auto& c : inputs) {
+    if(std::begin(c) == std::end(c)) continue;
+    cur.push_back(source::begin(c));
+    end.push_back(source::end(c));
+    total += std::size_t(std::distance(std::begin(c), std::end(c)));
+  }
+  internal::reserve_more(out, total, 0);
+
+  const std::size_t k = cur.size();
+  if(k == 0) return;
+  if(k == 2) {
+    using value_type = typename std::iterator_traits<iterator>::value_type;
+    using branchless = std::integral_constant<bool,
+        internal::is_small_vector<outT>::value && std::is_arithmetic<value_type>::value &&
+            std::is_same<value_type, typename outT::value_type>::value>;
+    internal::merge_two(cur[0], end[0], cur[1], end[1], out, comp, branchless{});
+    return;
+  }
+
+  if(k > 2) {
+    internal::loser_tree<iterator, compareT> tree{cur.data(), end.data(), k, comp};
+    for(std::size_t remaining = k; remaining > 1;) {
+      const std::size_t w = tree.winner();
+      out.emplace_back(*cur[w]);
+      tree.pop();
+      if(cur[w] == end[w]) --remaining;
+    }
+  }
+  for(std::size_t i = 0; i < k; ++i) {
+    for(; cur[i] != end[i]; ++cur[i]) out.emplace_back(*cur[i]);
+  }
+}
+
+/**
+ * @brief Appends each element of `src` to `buckets[key_fn(element)]`.
+ *
+ * A first pass counts the elements of each bucket, so that each bucket is
+ * grown once to its final size and no append checks the capacity or spills.
+ * When `src` and the `small_vector` buckets hold the same trivially copyable
+ * type of at most 32 bytes, the scatter pass then goes through software
+ * write-combining buffers: elements collect in a cache-line buffer per
+ * bucket, and reach the bucket a full line at a time. Otherwise elements are
+ * appended one by one, converted to the bucket's element type, and moved if
+ * `src` is an rvalue.
+ *
+ * @param src The range to partition.
+ * @param key_fn Maps an element to its bucket index; called twice per element.
+ * @param buckets A random access range of containers, e.g. a
+ * `std::vector<small_vector<T, N>>`.
+ */
+template <typename rangeT, typename keyFnT, typename bucketsT>
+void partition_by(rangeT&& src, keyFnT key_fn, bucketsT& buckets) {
+  using bucket_iterator = decltype(std::begin(buckets));
+  using bucket_type     = typename std::iterator_traits<bucket_iterator>::value_type;
+  using value_type      = typename bucket_type::value_type;
+  using write_combining = std::integral_constant<bool,
+      internal::is_small_vector<bucket_type>::value &&
+          std::is_trivially_copyable<value_type>::value &&
+          std::is_same<value_type, typename std::decay<decltype(*std::begin(src))>::type>::value &&
+          2 * sizeof(value_type) <= internal::write_combining_bytes>;
+
+  const bucket_iterator first    = std::begin(buckets);
+  const std::size_t bucket_count = std::size_t(std::distance(first, std::end(buckets)));
+  small_vector<std::size_t, 64> counts(bucket_count, 0);
+  for(const auto& x : src) ++counts[std::size_t(key_fn(x))];
+
+  internal::scatter(std::forward<rangeT>(src), key_fn, first, counts.data(), bucket_count,
+      write_combining{});
+}
+
+} // namespace jacl
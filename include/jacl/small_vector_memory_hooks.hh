@@ -0,0 +1,173 @@
+// Heap accounting hooks for small_vector.
+//
+// When JACL_SMALL_VECTOR_MEMORY_HOOKS is defined to 1, every heap buffer a
+// small_vector allocates or releases is reported here. The bytes are added to
+// counters of the calling thread, to the jacl::memory::account installed on
+// that thread by an account_scope, if any, and passed to the process-wide
+// hook set with jacl::memory::set_hook(), if any. This lets per-tenant
+// accounting include vector spills without wrapping every allocator.
+//
+// This header is included by small_vector.hh after its configuration macros
+// when the hooks are enabled, so it uses an include guard that follows the
+// include below instead of `#pragma once`.
+
+#include <jacl/small_vector.hh>
+
+#ifndef JACL_SMALL_VECTOR_MEMORY_HOOKS_HH
+#define JACL_SMALL_VECTOR_MEMORY_HOOKS_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace jacl {
+namespace memory {
+
+enum class operation : unsigned char { allocate, deallocate };
+
+/// @brief One heap allocation or deallocation made by a small_vector.
+struct event {
+  operation op;
+  const void* ptr;
+  std::size_t bytes;
+  std::size_t value_size;      ///< sizeof the element type.
+  std::size_t inline_capacity; ///< N of the small_vector specialization.
+}; // struct event
+
+/// @brief Called on every event, on the thread that caused it.
+using hook = void (*)(const event&);
+
+/// @brief Heap traffic of small_vectors, as seen by a thread or an account.
+struct counters {
+  std::uint64_t allocations;
+  std::uint64_t deallocations;
+  std::uint64_t allocated_bytes;
+  std::uint64_t deallocated_bytes;
+
+  /// @brief Allocated minus deallocated bytes. Negative when buffers
+  /// allocated elsewhere were released here.
+  std::int64_t live_bytes() const noexcept {
+    return std::int64_t(allocated_bytes) - std::int64_t(deallocated_bytes);
+  }
+}; // struct counters
+
+/**
+ * @brief Heap bytes charged to one tenant, from any number of threads.
+ *
+ * Buffers are charged to the account installed on the thread that allocates
+ * or releases them, so a buffer released under another account moves bytes
+ * between the two.
+ */
+class account {
+public:
+  account() noexcept {
+    for(auto& v : values_) v.store(0, std::memory_order_relaxed);
+  }
+
+  account(const account&)            = delete;
+  account& operator=(const account&) = delete;
+
+  counters totals() const noexcept {
+    return counters{values_[0].load(std::memory_order_relaxed),
+        values_[1].load(std::memory_order_relaxed), values_[2].load(std::memory_order_relaxed),
+        values_[3].load(std::memory_order_relaxed)};
+  }
+
+  std::int64_t live_bytes() const noexcept { return totals().live_bytes(); }
+
+  void record(operation op, std::size_t bytes) noexcept {
+    const std::size_t first = op == operation::allocate ? 0 : 1;
+    values_[first].fetch_add(1, std::memory_order_relaxed);
+    values_[first + 2].fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+private:
+  // allocations, deallocations, allocated_bytes, deallocated_bytes
+  std::atomic<std::uint64_t> values_[4];
+}; // class account
+
+} // namespace memory
+
+namespace internal {
+
+struct memory_thread_state {
+  memory::counters totals;
+  memory::account* current;
+}; // struct memory_thread_state
+
+inline memory_thread_state& memory_thread() noexcept {
+  static thread_local memory_thread_state state{};
+  return state;
+}
+
+inline std::atomic<memory::hook>& memory_hook() noexcept {
+  static std::atomic<memory::hook> hook{nullptr};
+  return hook;
+}
+
+/**
+ * @brief Reports the heap buffers of one small_vector specialization.
+ */
+template <typename vectorT>
+struct memory_recorder {
+  static void record(memory::operation op, const void* ptr, std::size_t bytes) noexcept {
+    auto& state = memory_thread();
+    if(op == memory::operation::allocate) {
+      ++state.totals.allocations;
+      state.totals.allocated_bytes += bytes;
+    } else {
+      ++state.totals.deallocations;
+      state.totals.deallocated_bytes += bytes;
+    }
+    if(state.current) state.current->record(op, bytes);
+
+    const memory::hook hook = memory_hook().load(std::memory_order_acquire);
+    if(hook) {
+      hook(memory::event{op, ptr, bytes, sizeof(typename vectorT::value_type),
+          vectorT::static_capacity});
+    }
+  }
+}; // struct memory_recorder
+
+} // namespace internal
+
+namespace memory {
+
+/**
+ * @brief Installs the process-wide hook, or removes it if null.
+ *
+ * @return The previous hook.
+ */
+inline hook set_hook(hook h) noexcept {
+  return internal::memory_hook().exchange(h, std::memory_order_acq_rel);
+}
+
+/**
+ * @brief Returns the heap traffic of small_vectors on the calling thread since
+ * it started. Reading the counters costs a thread-local access.
+ */
+inline counters thread_counters() noexcept { return internal::memory_thread().totals; }
+
+/**
+ * @brief Charges the heap traffic of small_vectors on the calling thread to an
+ * account for the lifetime of the scope. Scopes nest.
+ */
+class account_scope {
+public:
+  explicit account_scope(account& a) noexcept : previous_{internal::memory_thread().current} {
+    internal::memory_thread().current = &a;
+  }
+
+  account_scope(const account_scope&)            = delete;
+  account_scope& operator=(const account_scope&) = delete;
+
+  ~account_scope() { internal::memory_thread().current = previous_; }
+
+private:
+  account* previous_;
+}; // class account_scope
+
+} // namespace memory
+} // namespace jacl
+
+#endif // JACL_SMALL_VECTOR_MEMORY_HOOKS_HH
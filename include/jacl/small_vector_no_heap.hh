@@ -0,0 +1,141 @@
+// No-heap scopes for small_vector.
+//
+// While a jacl::no_heap_scope is active on a thread, any heap allocation made
+// by a small_vector on that thread is a violation, handled by the action of
+// the innermost scope: abort, log the allocation with a backtrace to stderr,
+// or only count it. Scopes are meant for latency-critical regions where a
+// spill past the inline capacity is a bug.
+//
+// Allocations are checked when JACL_SMALL_VECTOR_NO_HEAP_CHECKS is 1, which
+// is the default unless NDEBUG is defined. Defining it to 1 in release builds
+// costs one thread-local load when a vector allocates; nothing is checked
+// while a vector stays inline. Without checks, scopes still compile but never
+// see a violation.
+//
+// This header is included by small_vector.hh after its configuration macros
+// when checks are enabled, so it uses an include guard that follows the
+// include below instead of `#pragma once`.
+
+#include <jacl/small_vector.hh>
+
+#ifndef JACL_SMALL_VECTOR_NO_HEAP_HH
+#define JACL_SMALL_VECTOR_NO_HEAP_HH
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#if !defined(JACL_HAS_RTTI)
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define JACL_HAS_RTTI 1
+#else
+#define JACL_HAS_RTTI 0
+#endif // defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#endif // !defined(JACL_HAS_RTTI)
+
+#if JACL_HAS_RTTI
+#include <typeinfo>
+#endif // JACL_HAS_RTTI
+
+#if defined(__has_include)
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define JACL_HAS_BACKTRACE 1
+#endif // __has_include(<execinfo.h>)
+#endif // defined(__has_include)
+
+#if !defined(JACL_HAS_BACKTRACE)
+#define JACL_HAS_BACKTRACE 0
+#endif // !defined(JACL_HAS_BACKTRACE)
+
+namespace jacl {
+
+/// @brief What a no_heap_scope does when a small_vector allocates inside it.
+enum class no_heap_action : unsigned char {
+  abort, ///< Log the allocation and its backtrace, then call std::abort().
+  log,   ///< Log the allocation and its backtrace to stderr, then continue.
+  count, ///< Only count the allocation; see no_heap_scope::violations().
+};
+
+class no_heap_scope;
+
+namespace internal {
+
+inline no_heap_scope*& no_heap_current() noexcept {
+  static thread_local no_heap_scope* current = nullptr;
+  return current;
+}
+
+} // namespace internal
+
+/**
+ * @brief Forbids small_vector heap allocations on the calling thread for the
+ * lifetime of the scope.
+ *
+ * Scopes nest; the innermost one decides the action and counts the
+ * violation. A scope must be destroyed on the thread that created it.
+ */
+class no_heap_scope {
+public:
+  explicit no_heap_scope(no_heap_action action = no_heap_action::abort) noexcept
+      : action_{action}, previous_{internal::no_heap_current()} {
+    internal::no_heap_current() = this;
+  }
+
+  no_heap_scope(const no_heap_scope&)            = delete;
+  no_heap_scope& operator=(const no_heap_scope&) = delete;
+
+  ~no_heap_scope() { internal::no_heap_current() = previous_; }
+
+  no_heap_action action() const noexcept { return action_; }
+
+  /// @brief Heap allocations seen by this scope so far.
+  std::size_t violations() const noexcept { return violations_; }
+
+  /// @brief Handles a violation; called by small_vector.
+  void violation(const char* value_type, std::size_t inline_capacity, std::size_t bytes) {
+    ++violations_;
+    if(action_ == no_heap_action::count) return;
+
+    std::fprintf(stderr,
+        "jacl::no_heap_scope: small_vector<%s, %zu> allocated %zu bytes on the heap\n",
+        value_type, inline_capacity, bytes);
+#if JACL_HAS_BACKTRACE
+    void* frames[64];
+    const int depth = ::backtrace(frames, 64);
+    ::backtrace_symbols_fd(frames, depth, 2);
+#endif // JACL_HAS_BACKTRACE
+    std::fflush(stderr);
+    if(action_ == no_heap_action::abort) std::abort();
+  }
+
+private:
+  no_heap_action action_;
+  no_heap_scope* previous_;
+  std::size_t violations_{};
+}; // class no_heap_scope
+
+namespace internal {
+
+/**
+ * @brief Reports a heap allocation of one small_vector specialization inside
+ * a no_heap_scope. Kept out of line so that the check in small_vector is a
+ * single load and branch.
+ */
+template <typename vectorT>
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, cold))
+#endif // defined(__GNUC__) || defined(__clang__)
+void no_heap_violation(std::size_t bytes) {
+#if JACL_HAS_RTTI
+  const char* value_type = typeid(typename vectorT::value_type).name();
+#else
+  const char* value_type = "?";
+#endif // JACL_HAS_RTTI
+  no_heap_current()->violation(value_type, vectorT::static_capacity, bytes);
+}
+
+} // namespace internal
+} // namespace jacl
+
+#endif // JACL_SMALL_VECTOR_NO_HEAP_HH
@@ -0,0 +1,439 @@
+// Size profiling for small_vector.
+//
+// When JACL_SMALL_VECTOR_PROFILE is defined to 1, every small_vector
+// remembers where it was constructed and its peak size. On destruction the
+// final and peak sizes are added to histograms kept per specialization and
+// construction site. At exit, a report with the size distribution and the
+// inline capacity that minimizes spills within a byte budget is written to
+// the file named by JACL_SMALL_VECTOR_PROFILE_FILE, or to stderr if unset.
+// JACL_SMALL_VECTOR_PROFILE_BUDGET sets the budget of inline bytes per vector
+// (default 64).
+//
+// The construction site is the code address into which the constructor was
+// inlined, so distinct sites require an optimized build. Sites are reported
+// as module+offset, which addr2line resolves.
+//
+// This header is included by small_vector.hh after its configuration macros
+// when profiling is enabled, so it uses an include guard that follows the
+// include below instead of `#pragma once`.
+
+#include <jacl/small_vector.hh>
+
+#ifndef JACL_SMALL_VECTOR_PROFILE_HH
+#define JACL_SMALL_VECTOR_PROFILE_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined(JACL_HAS_RTTI)
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define JACL_HAS_RTTI 1
+#else
+#define JACL_HAS_RTTI 0
+#endif // defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#endif // !defined(JACL_HAS_RTTI)
+
+#if JACL_HAS_RTTI
+#include <typeinfo>
+#endif // JACL_HAS_RTTI
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <dlfcn.h>
+#define JACL_HAS_DLADDR 1
+#else
+#define JACL_HAS_DLADDR 0
+#endif // defined(__linux__) || defined(__APPLE__)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JACL_RETURN_ADDRESS() __builtin_return_address(0)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define JACL_RETURN_ADDRESS() _ReturnAddress()
+#else
+#define JACL_RETURN_ADDRESS() nullptr
+#endif // defined(__GNUC__) || defined(__clang__)
+
+namespace jacl {
+namespace profile {
+
+/**
+ * @brief Histogram of vector sizes.
+ *
+ * Sizes below `exact_sizes` have their own bucket; larger sizes are grouped
+ * by powers of two.
+ */
+class histogram {
+public:
+  static constexpr std::size_t exact_sizes = 128;
+  static constexpr std::size_t buckets     = exact_sizes + 64;
+
+  void add(std::size_t size, std::uint64_t count = 1) noexcept { counts_[bucket(size)] += count; }
+
+  void merge(const histogram& other) noexcept {
+    for(std::size_t b = 0; b < buckets; ++b) counts_[b] += other.counts_[b];
+  }
+
+  std::uint64_t total() const noexcept {
+    std::uint64_t n = 0;
+    for(auto c : counts_) n += c;
+    return n;
+  }
+
+  /// @brief Number of sizes greater than `n`; exact for n < exact_sizes.
+  std::uint64_t count_above(std::size_t n) const noexcept {
+    std::uint64_t above = 0;
+    for(std::size_t b = 0; b < buckets; ++b) {
+      if(lower_bound(b) > n) above += counts_[b];
+    }
+    return above;
+  }
+
+  /// @brief Smallest size s such that a fraction `q` of sizes is <= s. Sizes
+  /// of at least `exact_sizes` are rounded up to their bucket's upper bound.
+  std::size_t percentile(double q) const noexcept {
+    const double target = q * static_cast<double>(total());
+    std::uint64_t seen  = 0;
+    for(std::size_t b = 0; b < buckets; ++b) {
+      seen += counts_[b];
+      if(counts_[b] != 0 && static_cast<double>(seen) >= target) return upper_bound(b);
+    }
+    return 0;
+  }
+
+  static std::size_t bucket(std::size_t size) noexcept {
+    if(size < exact_sizes) return size;
+    std::size_t b = exact_sizes;
+    for(std::size_t s = size / exact_sizes; s > 1 && b + 1 < buckets; s >>= 1) ++b;
+    return b;
+  }
+
+  static std::size_t lower_bound(std::size_t b) noexcept {
+    return b < exact_sizes ? b : exact_sizes << (b - exact_sizes);
+  }
+
+  static std::size_t upper_bound(std::size_t b) noexcept {
+    return b < exact_sizes ? b : (exact_sizes << (b - exact_sizes + 1)) - 1;
+  }
+
+private:
+  std::uint64_t counts_[buckets] = {};
+}; // class histogram
+
+/// @brief Size distribution of the vectors of one specialization constructed
+/// at one site.
+struct site_profile {
+  std::string value_type; ///< Implementation-defined name; empty without RTTI.
+  std::size_t value_size;
+  std::size_t inline_capacity;
+  const void* site;
+  histogram final_size; ///< size() at destruction.
+  histogram peak_size;
+}; // struct site_profile
+
+struct recommendation {
+  std::size_t inline_capacity;
+  std::uint64_t spills; ///< Vectors whose peak size exceeds the capacity.
+}; // struct recommendation
+
+/**
+ * @brief Recommends an inline capacity from a peak-size histogram.
+ *
+ * Among the capacities whose inline storage fits in `budget_bytes`, returns
+ * the smallest one with the fewest spills.
+ */
+inline recommendation recommend(
+    const histogram& peak_size, std::size_t value_size, std::size_t budget_bytes) {
+  const std::size_t max_capacity = budget_bytes / std::max<std::size_t>(value_size, 1);
+  recommendation best{0, peak_size.count_above(0)};
+  for(std::size_t b = 1; b < histogram::buckets; ++b) {
+    const std::size_t n = histogram::upper_bound(b);
+    if(n > max_capacity) break;
+    const std::uint64_t spills = peak_size.count_above(n);
+    if(spills < best.spills) best = recommendation{n, spills};
+  }
+  return best;
+}
+
+} // namespace profile
+
+namespace internal {
+
+/**
+ * @brief Process-wide store of size histograms.
+ *
+ * Histograms are recorded into per-thread maps, which are merged into the
+ * shared map when their thread exits and when a snapshot is taken.
+ */
+class profile_registry {
+  using key = std::pair<std::size_t, const void*>; // (type id, site)
+
+  struct shard {
+    std::mutex mutex;
+    std::map<key, std::pair<profile::histogram, profile::histogram>> sites;
+
+    shard() { profile_registry::instance().attach(this); }
+
+    ~shard() {
+      profile_registry::instance().detach(this);
+      shard_destroyed() = true;
+    }
+  }; // struct shard
+
+  // Vectors with static or thread storage duration may be destroyed after
+  // their thread's shard; this flag outlives the shard.
+  static bool& shard_destroyed() noexcept {
+    static thread_local bool destroyed = false;
+    return destroyed;
+  }
+
+public:
+  // Never destroyed: vectors with static storage duration, including
+  // constant-initialized ones, may be destroyed after any other static object.
+  static profile_registry& instance() {
+    static profile_registry* registry = new profile_registry;
+    return *registry;
+  }
+
+  profile_registry(const profile_registry&)            = delete;
+  profile_registry& operator=(const profile_registry&) = delete;
+
+  std::size_t register_type(profile::site_profile desc) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    types_.push_back(std::move(desc));
+    return types_.size() - 1;
+  }
+
+  void record(std::size_t id, const void* site, std::size_t final_size, std::size_t peak_size) {
+    if(JACL_UNLIKELY(shard_destroyed())) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      add(retired_[key{id, site}], final_size, peak_size);
+      return;
+    }
+    static thread_local shard local;
+    std::lock_guard<std::mutex> lock{local.mutex}; // Uncontended except during snapshots.
+    add(local.sites[key{id, site}], final_size, peak_size);
+  }
+
+  std::vector<profile::site_profile> snapshot() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto merged = retired_;
+    for(shard* s : shards_) {
+      std::lock_guard<std::mutex> shard_lock{s->mutex};
+      merge(merged, s->sites);
+    }
+
+    std::vector<profile::site_profile> profiles;
+    for(const auto& entry : merged) {
+      profile::site_profile p = types_[entry.first.first];
+      p.site                  = entry.first.second;
+      p.final_size            = entry.second.first;
+      p.peak_size             = entry.second.second;
+      profiles.push_back(std::move(p));
+    }
+    return profiles;
+  }
+
+  void write_report(std::ostream& out) {
+    std::size_t budget = 64;
+    if(const char* env = std::getenv("JACL_SMALL_VECTOR_PROFILE_BUDGET")) {
+      budget = std::strtoul(env, nullptr, 10);
+    }
+    write_report(out, budget);
+  }
+
+  void write_report(std::ostream& out, std::size_t budget_bytes);
+
+private:
+  profile_registry() { std::atexit(&write_report_at_exit); }
+
+  static void write_report_at_exit() {
+    const char* path = std::getenv("JACL_SMALL_VECTOR_PROFILE_FILE");
+    if(path != nullptr && *path != '\0') {
+      std::ofstream out{path};
+      instance().write_report(out);
+    } else {
+      instance().write_report(std::cerr);
+    }
+  }
+
+  using site_map = std::map<key, std::pair<profile::histogram, profile::histogram>>;
+
+  static void add(std::pair<profile::histogram, profile::histogram>& h, std::size_t final_size,
+      std::size_t peak_size) noexcept {
+    h.first.add(final_size);
+    h.second.add(peak_size);
+  }
+
+  static void merge(site_map& into, const site_map& from) {
+    for(const auto& entry : from) {
+      auto& h = into[entry.first];
+      h.first.merge(entry.second.first);
+      h.second.merge(entry.second.second);
+    }
+  }
+
+  void attach(shard* s) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    shards_.push_back(s);
+  }
+
+  void detach(shard* s) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    shards_.erase(std::find(shards_.begin(), shards_.end(), s));
+    merge(retired_, s->sites);
+  }
+
+  std::mutex mutex_;
+  std::vector<profile::site_profile> types_;
+  std::vector<shard*> shards_;
+  site_map retired_;
+}; // class profile_registry
+
+inline std::string describe_site(const void* site) {
+  char buffer[64];
+#if JACL_HAS_DLADDR
+  Dl_info info;
+  if(site != nullptr && ::dladdr(site, &info) != 0 && info.dli_fname != nullptr) {
+    const auto offset = reinterpret_cast<std::uintptr_t>(site) -
+                        reinterpret_cast<std::uintptr_t>(info.dli_fbase);
+    std::snprintf(buffer, sizeof(buffer), "+0x%llx", static_cast<unsigned long long>(offset));
+    std::string name = info.dli_fname;
+    name += buffer;
+    if(info.dli_sname != nullptr) name = name + " (" + info.dli_sname + ")";
+    return name;
+  }
+#endif // JACL_HAS_DLADDR
+  std::snprintf(buffer, sizeof(buffer), "%p", site);
+  return buffer;
+}
+
+inline void write_summary(std::ostream& out, const profile::site_profile& p, std::size_t budget) {
+  const auto vectors = p.peak_size.total();
+  const auto rec     = profile::recommend(p.peak_size, p.value_size, budget);
+  const auto spills  = p.peak_size.count_above(p.inline_capacity);
+  out << "  vectors=" << vectors << " spills=" << spills << " final p50/p90/p99="
+      << p.final_size.percentile(0.5) << '/' << p.final_size.percentile(0.9) << '/'
+      << p.final_size.percentile(0.99) << " peak p50/p90/p99=" << p.peak_size.percentile(0.5)
+      << '/' << p.peak_size.percentile(0.9) << '/' << p.peak_size.percentile(0.99)
+      << " peak max=" << p.peak_size.percentile(1.0) << '\n';
+  out << "  recommended N=" << rec.inline_capacity << " (spills=" << rec.spills
+      << ", inline bytes=" << rec.inline_capacity * p.value_size << ")\n";
+}
+
+inline void profile_registry::write_report(std::ostream& out, std::size_t budget_bytes) {
+  const auto profiles = snapshot();
+  if(profiles.empty()) return;
+
+  out << "small_vector size profile (inline budget " << budget_bytes << " bytes per vector)\n";
+  std::size_t i = 0;
+  while(i < profiles.size()) {
+    // Profiles are ordered by type, so each type's sites are contiguous.
+    profile::site_profile all = profiles[i];
+    std::size_t j             = i + 1;
+    for(; j < profiles.size() && profiles[j].value_type == all.value_type &&
+          profiles[j].inline_capacity == all.inline_capacity &&
+          profiles[j].value_size == all.value_size;
+        ++j) {
+      all.final_size.merge(profiles[j].final_size);
+      all.peak_size.merge(profiles[j].peak_size);
+    }
+
+    out << "\nsmall_vector<" << (all.value_type.empty() ? "?" : all.value_type) << ", "
+        << all.inline_capacity << "> value_size=" << all.value_size << '\n';
+    write_summary(out, all, budget_bytes);
+    if(j - i > 1) {
+      for(std::size_t k = i; k < j; ++k) {
+        out << " site " << describe_site(profiles[k].site) << '\n';
+        write_summary(out, profiles[k], budget_bytes);
+      }
+    }
+    i = j;
+  }
+}
+
+/**
+ * @brief Per-vector profiling state, stored in each small_vector.
+ */
+struct profile_state {
+  const void* site{};
+  std::size_t peak{};
+
+  JACL_FORCE_INLINE JACL_CONSTEXPR20 profile_state() noexcept {
+    if(!JACL_IS_CONSTANT_EVALUATED()) site = capture_site();
+  }
+
+  JACL_CONSTEXPR20 void observe(std::size_t size) noexcept {
+    if(size > peak) peak = size;
+  }
+
+private:
+  // Not inlined, so that its return address lies in the (inlined) constructor.
+  // Also creates the registry, so that the exit report is registered before
+  // the first vector with static storage duration is constructed.
+#if defined(__GNUC__) || defined(__clang__)
+  __attribute__((noinline))
+#elif defined(_MSC_VER)
+  __declspec(noinline)
+#endif
+  static const void* capture_site() noexcept {
+    profile_registry::instance();
+    return JACL_RETURN_ADDRESS();
+  }
+}; // struct profile_state
+
+template <typename vectorT>
+struct profile_recorder {
+  static std::size_t id() {
+    static const std::size_t id = [] {
+      using value_type = typename vectorT::value_type;
+      profile::site_profile desc{};
+#if JACL_HAS_RTTI
+      desc.value_type = typeid(value_type).name();
+#endif // JACL_HAS_RTTI
+      desc.value_size      = sizeof(value_type);
+      desc.inline_capacity = vectorT::static_capacity;
+      return profile_registry::instance().register_type(desc);
+    }();
+    return id;
+  }
+
+  static void record(const profile_state& state, std::size_t final_size) noexcept {
+    profile_registry::instance().record(
+        id(), state.site, final_size, std::max(state.peak, final_size));
+  }
+}; // struct profile_recorder
+
+} // namespace internal
+
+namespace profile {
+
+/**
+ * @brief Returns the histograms of every specialization and construction site
+ * recorded so far, ordered by specialization.
+ */
+inline std::vector<site_profile> snapshot() {
+  return internal::profile_registry::instance().snapshot();
+}
+
+/**
+ * @brief Writes the report that is otherwise written at exit.
+ */
+inline void report(std::ostream& out, std::size_t budget_bytes) {
+  internal::profile_registry::instance().write_report(out, budget_bytes);
+}
+
+} // namespace profile
+} // namespace jacl
+
+#endif // JACL_SMALL_VECTOR_PROFILE_HH
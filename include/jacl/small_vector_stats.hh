@@ -0,0 +1,257 @@
+// Runtime statistics for small_vector.
+//
+// When JACL_SMALL_VECTOR_STATS is defined to 1, every small_vector
+// specialization counts its constructions, spills to the heap, heap
+// reallocations, bytes relocated into new buffers, peak size and shrinks back
+// to inline storage. Counters are sharded per thread, so recording an event
+// never contends with other threads; jacl::stats::snapshot() sums the shards.
+//
+// This header is included by small_vector.hh after its configuration macros
+// when statistics are enabled, so it uses an include guard that follows the
+// include below instead of `#pragma once`.
+
+#include <jacl/small_vector.hh>
+
+#ifndef JACL_SMALL_VECTOR_STATS_HH
+#define JACL_SMALL_VECTOR_STATS_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if !defined(JACL_HAS_RTTI)
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define JACL_HAS_RTTI 1
+#else
+#define JACL_HAS_RTTI 0
+#endif // defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#endif // !defined(JACL_HAS_RTTI)
+
+#if JACL_HAS_RTTI
+#include <typeinfo>
+#endif // JACL_HAS_RTTI
+
+namespace jacl {
+namespace stats {
+
+/// @brief Counters of one small_vector specialization.
+struct counters {
+  std::uint64_t constructions;
+  std::uint64_t spills;          ///< Moves from inline storage to the heap.
+  std::uint64_t reallocations;   ///< Moves from one heap buffer to another.
+  std::uint64_t bytes_relocated; ///< Bytes of elements moved into new buffers.
+  std::uint64_t peak_size;
+  std::uint64_t shrinks_to_inline;
+}; // struct counters
+
+/// @brief Statistics of one small_vector specialization.
+struct entry {
+  std::string value_type; ///< Implementation-defined name; empty without RTTI.
+  std::size_t value_size;
+  std::size_t inline_capacity;
+  counters totals;
+}; // struct entry
+
+} // namespace stats
+
+namespace internal {
+
+enum class stats_event : unsigned {
+  constructions,
+  spills,
+  reallocations,
+  bytes_relocated,
+  peak_size,
+  shrinks_to_inline,
+  count
+}; // enum class stats_event
+
+/**
+ * @brief Process-wide registry of specializations and per-thread shards.
+ *
+ * Each thread owns a shard with one block of counters per specialization.
+ * Only the owning thread writes a block, with relaxed loads and stores, so
+ * recording needs no atomic read-modify-write. Shards of exited threads are
+ * folded into `retired_`.
+ */
+class stats_registry {
+  static constexpr std::size_t event_count = std::size_t(stats_event::count);
+
+  struct block {
+    std::atomic<std::uint64_t> values[event_count];
+
+    block() {
+      for(auto& v : values) v.store(0, std::memory_order_relaxed);
+    }
+  }; // struct block
+
+  struct shard {
+    std::mutex mutex; // Guards growth of `blocks` against readers.
+    std::vector<std::unique_ptr<block>> blocks;
+
+    shard() { stats_registry::instance().attach(this); }
+
+    ~shard() { stats_registry::instance().detach(this); }
+
+    block& at(std::size_t id) {
+      if(JACL_UNLIKELY(id >= blocks.size())) {
+        std::lock_guard<std::mutex> lock{mutex};
+        while(blocks.size() <= id) blocks.emplace_back(new block);
+      }
+      return *blocks[id];
+    }
+  }; // struct shard
+
+public:
+  static stats_registry& instance() {
+    static stats_registry registry;
+    return registry;
+  }
+
+  stats_registry(const stats_registry&)            = delete;
+  stats_registry& operator=(const stats_registry&) = delete;
+
+  std::size_t register_type(stats::entry desc) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    types_.push_back(std::move(desc));
+    return types_.size() - 1;
+  }
+
+  void record(std::size_t id, stats_event event, std::uint64_t value) noexcept {
+    static thread_local shard local;
+    auto& v             = local.at(id).values[std::size_t(event)];
+    const auto previous = v.load(std::memory_order_relaxed);
+    if(event == stats_event::peak_size) {
+      if(value > previous) v.store(value, std::memory_order_relaxed);
+    } else {
+      v.store(previous + value, std::memory_order_relaxed);
+    }
+  }
+
+  std::vector<stats::entry> snapshot() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::vector<stats::entry> entries = types_;
+    for(std::size_t id = 0; id < entries.size(); ++id) {
+      std::uint64_t values[event_count] = {};
+      if(id < retired_.size()) accumulate(values, *retired_[id]);
+      for(shard* s : shards_) {
+        std::lock_guard<std::mutex> shard_lock{s->mutex};
+        if(id < s->blocks.size()) accumulate(values, *s->blocks[id]);
+      }
+      entries[id].totals = stats::counters{values[0], values[1], values[2], values[3], values[4],
+          values[5]};
+    }
+    return entries;
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for(auto& b : retired_) clear(*b);
+    for(shard* s : shards_) {
+      std::lock_guard<std::mutex> shard_lock{s->mutex};
+      for(auto& b : s->blocks) clear(*b);
+    }
+  }
+
+private:
+  stats_registry() = default;
+
+  static void accumulate(std::uint64_t (&values)[event_count], const block& b) {
+    for(std::size_t e = 0; e < event_count; ++e) {
+      const auto v = b.values[e].load(std::memory_order_relaxed);
+      values[e]    = e == std::size_t(stats_event::peak_size) ? std::max(values[e], v)
+                                                               : values[e] + v;
+    }
+  }
+
+  static void clear(block& b) {
+    for(auto& v : b.values) v.store(0, std::memory_order_relaxed);
+  }
+
+  void attach(shard* s) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    shards_.push_back(s);
+  }
+
+  void detach(shard* s) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    shards_.erase(std::find(shards_.begin(), shards_.end(), s));
+    while(retired_.size() < s->blocks.size()) retired_.emplace_back(new block);
+    for(std::size_t id = 0; id < s->blocks.size(); ++id) {
+      std::uint64_t values[event_count] = {};
+      accumulate(values, *retired_[id]);
+      accumulate(values, *s->blocks[id]);
+      for(std::size_t e = 0; e < event_count; ++e) {
+        retired_[id]->values[e].store(values[e], std::memory_order_relaxed);
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<stats::entry> types_;
+  std::vector<shard*> shards_;
+  std::vector<std::unique_ptr<block>> retired_;
+}; // class stats_registry
+
+/**
+ * @brief Records statistics events of one small_vector specialization.
+ */
+template <typename vectorT>
+struct stats_recorder {
+  static std::size_t id() {
+    static const std::size_t id = [] {
+      using value_type = typename vectorT::value_type;
+      stats::entry desc{};
+#if JACL_HAS_RTTI
+      desc.value_type = typeid(value_type).name();
+#endif // JACL_HAS_RTTI
+      desc.value_size      = sizeof(value_type);
+      desc.inline_capacity = vectorT::static_capacity;
+      return stats_registry::instance().register_type(desc);
+    }();
+    return id;
+  }
+
+  static void record(stats_event event, std::uint64_t value) noexcept {
+    stats_registry::instance().record(id(), event, value);
+  }
+}; // struct stats_recorder
+
+} // namespace internal
+
+namespace stats {
+
+/**
+ * @brief Returns the statistics of every specialization used so far, summed
+ * over all threads. Safe to call concurrently with recording.
+ */
+inline std::vector<entry> snapshot() { return internal::stats_registry::instance().snapshot(); }
+
+/**
+ * @brief Sets every counter to zero.
+ */
+inline void reset() { internal::stats_registry::instance().reset(); }
+
+/**
+ * @brief Writes the statistics as one line per specialization.
+ */
+inline void dump(std::ostream& out) {
+  for(const auto& e : snapshot()) {
+    out << "small_vector<" << (e.value_type.empty() ? "?" : e.value_type) << ", "
+        << e.inline_capacity << "> value_size=" << e.value_size
+        << " constructions=" << e.totals.constructions << " spills=" << e.totals.spills
+        << " reallocations=" << e.totals.reallocations
+        << " bytes_relocated=" << e.totals.bytes_relocated << " peak_size=" << e.totals.peak_size
+        << " shrinks_to_inline=" << e.totals.shrinks_to_inline << '\n';
+  }
+}
+
+} // namespace stats
+} // namespace jacl
+
+#endif // JACL_SMALL_VECTOR_STATS_HH
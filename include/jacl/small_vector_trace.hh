@@ -0,0 +1,456 @@
+// Operation tracing for small_vector.
+//
+// When JACL_SMALL_VECTOR_TRACE is defined to 1, every mutating small_vector
+// operation is recorded while a trace is active. A trace is started with
+// jacl::trace::start() or by setting the JACL_SMALL_VECTOR_TRACE_FILE
+// environment variable, and is read back with jacl::trace::read().
+//
+// This header is included by small_vector.hh after its configuration macros
+// when tracing is enabled, so it uses an include guard that follows the
+// include below instead of `#pragma once`.
+
+#include <jacl/small_vector.hh>
+
+#ifndef JACL_SMALL_VECTOR_TRACE_HH
+#define JACL_SMALL_VECTOR_TRACE_HH
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if !defined(JACL_HAS_RTTI)
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define JACL_HAS_RTTI 1
+#else
+#define JACL_HAS_RTTI 0
+#endif // defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#endif // !defined(JACL_HAS_RTTI)
+
+#if JACL_HAS_RTTI
+#include <typeinfo>
+#endif // JACL_HAS_RTTI
+
+namespace jacl {
+namespace trace {
+
+/// @brief Traced operations.
+enum class op : std::uint8_t {
+  construct,      ///< Default, count, or range construction.
+  copy_construct, ///< `other` is the source.
+  move_construct, ///< `other` is the source.
+  destroy,
+  copy_assign, ///< `other` is the source.
+  move_assign, ///< `other` is the source.
+  assign,
+  emplace_back,
+  pop_back,
+  insert, ///< `arg` is the position; the count is the change in size.
+  erase,  ///< `arg` is the position; the count is the change in size.
+  clear,
+  reserve, ///< `arg` is the requested capacity.
+  resize,
+  shrink_to_fit,
+  swap, ///< `other` is the vector swapped with.
+}; // enum class op
+
+/// @brief The vector is heap-allocated after the operation.
+constexpr std::uint8_t flag_heap = 0x1;
+
+/// @brief Value type is trivially copyable.
+constexpr std::uint32_t type_trivially_copyable = 0x1;
+
+/**
+ * @brief One traced operation.
+ *
+ * Objects are identified by address. An address is reused only after a
+ * `destroy` record, so (address, lifetime) pairs identify vectors uniquely.
+ */
+struct record {
+  std::uint64_t sequence; ///< Global order of the operation.
+  std::uint64_t object;   ///< Address of the vector.
+  std::uint64_t other;    ///< Address of the source or swapped vector, if any.
+  std::uint32_t size_before;
+  std::uint32_t size_after;
+  std::uint32_t arg;
+  std::uint16_t type; ///< Index into the trace's type table.
+  std::uint8_t op;
+  std::uint8_t flags;
+}; // struct record
+
+static_assert(sizeof(record) == 40, "trace::record must be packed");
+
+/**
+ * @brief A small_vector specialization that appears in a trace.
+ */
+struct type_desc {
+  std::uint16_t id;
+  std::uint32_t value_size;
+  std::uint32_t value_align;
+  std::uint32_t inline_size;
+  std::uint32_t flags;
+  std::string name; ///< Implementation-defined type name; empty without RTTI.
+}; // struct type_desc
+
+/**
+ * @brief A trace read from a file, with records in sequence order.
+ */
+struct trace_data {
+  std::vector<type_desc> types;
+  std::vector<record> records;
+}; // struct trace_data
+
+} // namespace trace
+
+namespace internal {
+
+// File layout, in native byte order:
+//   trace_file_header
+//   chunks of { uint32 kind, uint32 bytes, payload }
+// Type chunks precede the records that refer to them.
+constexpr char trace_magic[8]              = {'J', 'S', 'V', 'T', 'R', 'A', 'C', 'E'};
+constexpr std::uint32_t trace_version      = 1;
+constexpr std::uint32_t trace_chunk_type   = 1;
+constexpr std::uint32_t trace_chunk_record = 2;
+
+struct trace_file_header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t record_size;
+}; // struct trace_file_header
+
+struct trace_type_header {
+  std::uint16_t id;
+  std::uint16_t name_size;
+  std::uint32_t value_size;
+  std::uint32_t value_align;
+  std::uint32_t inline_size;
+  std::uint32_t flags;
+}; // struct trace_type_header
+
+inline void throw_invalid_trace(const char* what) {
+#if !JACL_NO_EXCEPTIONS
+  throw std::runtime_error{what};
+#else
+  (void)what;
+  std::abort();
+#endif // JACL_NO_EXCEPTIONS
+}
+
+/**
+ * @brief Process-wide trace writer.
+ *
+ * Records are buffered per thread and written in chunks. The type table is
+ * kept in memory so that a trace started late still describes every type.
+ */
+class trace_writer {
+  static constexpr std::size_t buffer_records = 4096;
+
+  struct thread_buffer {
+    std::mutex mutex;
+    std::vector<trace::record> records;
+
+    thread_buffer() {
+      records.reserve(buffer_records);
+      trace_writer::instance().attach(this);
+    }
+
+    ~thread_buffer() { trace_writer::instance().detach(this); }
+  }; // struct thread_buffer
+
+public:
+  static trace_writer& instance() {
+    static trace_writer writer;
+    return writer;
+  }
+
+  trace_writer(const trace_writer&)            = delete;
+  trace_writer& operator=(const trace_writer&) = delete;
+
+  ~trace_writer() { stop(); }
+
+  bool enabled() const noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+  bool start(const char* path) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    close_locked();
+    file_ = std::fopen(path, "wb");
+    if(file_ == nullptr) return false;
+
+    trace_file_header header{};
+    std::memcpy(header.magic, trace_magic, sizeof(header.magic));
+    header.version     = trace_version;
+    header.record_size = sizeof(trace::record);
+    std::fwrite(&header, sizeof(header), 1, file_);
+    for(const auto& type : types_) write_type_locked(type);
+    enabled_.store(true, std::memory_order_relaxed);
+    return true;
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> lock{mutex_};
+    close_locked();
+  }
+
+  std::uint16_t register_type(trace::type_desc desc) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    desc.id = static_cast<std::uint16_t>(types_.size());
+    types_.push_back(desc);
+    if(file_ != nullptr) write_type_locked(desc);
+    return desc.id;
+  }
+
+  void append(const trace::record& r) noexcept {
+    thread_buffer& buffer = local_buffer();
+    {
+      // Only the owning thread appends, so the reserved capacity is never
+      // exceeded.
+      std::lock_guard<std::mutex> buffer_lock{buffer.mutex};
+      buffer.records.push_back(r);
+      if(buffer.records.size() < buffer_records) return;
+    }
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::lock_guard<std::mutex> buffer_lock{buffer.mutex};
+    flush_locked(buffer);
+  }
+
+  std::uint64_t next_sequence() noexcept {
+    return sequence_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+private:
+  trace_writer() {
+    if(const char* path = std::getenv("JACL_SMALL_VECTOR_TRACE_FILE")) start(path);
+  }
+
+  static thread_buffer& local_buffer() {
+    static thread_local thread_buffer buffer;
+    return buffer;
+  }
+
+  void attach(thread_buffer* buffer) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    buffers_.push_back(buffer);
+  }
+
+  // Locks are always taken in the order `mutex_`, then the buffer's mutex.
+  void detach(thread_buffer* buffer) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+    flush_locked(*buffer);
+    buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), buffer), buffers_.end());
+  }
+
+  // Requires `mutex_` and the buffer's mutex.
+  void flush_locked(thread_buffer& buffer) noexcept {
+    if(file_ != nullptr && !buffer.records.empty()) {
+      const std::uint32_t header[2] = {trace_chunk_record,
+          static_cast<std::uint32_t>(buffer.records.size() * sizeof(trace::record))};
+      std::fwrite(header, sizeof(header), 1, file_);
+      std::fwrite(buffer.records.data(), sizeof(trace::record), buffer.records.size(), file_);
+    }
+    buffer.records.clear();
+  }
+
+  void write_type_locked(const trace::type_desc& desc) {
+    trace_type_header type{};
+    type.id          = desc.id;
+    type.name_size   = static_cast<std::uint16_t>(std::min<std::size_t>(desc.name.size(), 0xffff));
+    type.value_size  = desc.value_size;
+    type.value_align = desc.value_align;
+    type.inline_size = desc.inline_size;
+    type.flags       = desc.flags;
+    const std::uint32_t header[2] = {
+        trace_chunk_type, static_cast<std::uint32_t>(sizeof(type) + type.name_size)};
+    std::fwrite(header, sizeof(header), 1, file_);
+    std::fwrite(&type, sizeof(type), 1, file_);
+    std::fwrite(desc.name.data(), 1, type.name_size, file_);
+  }
+
+  // Requires `mutex_`. Flushes every thread's buffered records.
+  void close_locked() {
+    enabled_.store(false, std::memory_order_relaxed);
+    if(file_ == nullptr) return;
+    for(thread_buffer* buffer : buffers_) {
+      std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+      flush_locked(*buffer);
+    }
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<std::uint64_t> sequence_{0};
+  std::mutex mutex_;
+  std::FILE* file_{nullptr};
+  std::vector<trace::type_desc> types_;
+  std::vector<thread_buffer*> buffers_;
+}; // class trace_writer
+
+// The vector whose operation is being traced on this thread. Operations that
+// small_vector performs on itself while inside a traced operation (e.g. the
+// reserve() in emplace_back()) are not recorded.
+inline const void*& trace_active_object() noexcept {
+  static thread_local const void* active = nullptr;
+  return active;
+}
+
+/**
+ * @brief Records one operation on a small_vector.
+ *
+ * Constructed at the start of a traced member function; the record is
+ * emitted by the destructor, once the size after the operation is known.
+ */
+template <typename vectorT>
+class trace_scope {
+public:
+  JACL_CONSTEXPR20 trace_scope(const vectorT* vec, trace::op op, std::size_t arg = 0,
+      const void* other = nullptr) noexcept :
+      vec_{vec}, other_{other}, arg_{arg}, op_{op} {
+    if(!JACL_IS_CONSTANT_EVALUATED()) enter();
+  }
+
+  trace_scope(const trace_scope&)            = delete;
+  trace_scope& operator=(const trace_scope&) = delete;
+
+  JACL_CONSTEXPR20 ~trace_scope() {
+    if(!JACL_IS_CONSTANT_EVALUATED()) leave();
+  }
+
+private:
+  static std::uint16_t type_id() {
+    static const std::uint16_t id = [] {
+      using value_type = typename vectorT::value_type;
+      trace::type_desc desc{};
+      desc.value_size  = sizeof(value_type);
+      desc.value_align = alignof(value_type);
+      desc.inline_size = static_cast<std::uint32_t>(vectorT::static_capacity);
+      desc.flags       = std::is_trivially_copyable<value_type>::value
+                             ? trace::type_trivially_copyable
+                             : 0;
+#if JACL_HAS_RTTI
+      desc.name = typeid(value_type).name();
+#endif // JACL_HAS_RTTI
+      return trace_writer::instance().register_type(desc);
+    }();
+    return id;
+  }
+
+  void enter() noexcept {
+    if(!trace_writer::instance().enabled() || trace_active_object() == vec_) return;
+    previous_             = trace_active_object();
+    trace_active_object() = vec_;
+    recording_            = true;
+    size_before_          = vec_->size();
+  }
+
+  void leave() noexcept {
+    if(!recording_) return;
+    trace_active_object() = previous_;
+
+    const bool destroyed = op_ == trace::op::destroy;
+    const bool heap = !destroyed && vec_->capacity() > std::size_t(vectorT::static_capacity);
+    trace::record r{};
+    r.sequence    = trace_writer::instance().next_sequence();
+    r.object      = reinterpret_cast<std::uintptr_t>(vec_);
+    r.other       = reinterpret_cast<std::uintptr_t>(other_);
+    r.size_before = static_cast<std::uint32_t>(size_before_);
+    r.size_after  = destroyed ? 0 : static_cast<std::uint32_t>(vec_->size());
+    r.arg         = static_cast<std::uint32_t>(arg_);
+    r.type        = type_id();
+    r.op          = static_cast<std::uint8_t>(op_);
+    r.flags       = heap ? trace::flag_heap : 0;
+    trace_writer::instance().append(r);
+  }
+
+  const vectorT* vec_;
+  const void* other_;
+  const void* previous_{nullptr};
+  std::size_t arg_;
+  std::size_t size_before_{0};
+  trace::op op_;
+  bool recording_{false};
+}; // class trace_scope
+
+} // namespace internal
+
+namespace trace {
+
+/**
+ * @brief Starts writing a trace to `path`, replacing any active trace.
+ *
+ * @return `false` if the file cannot be created.
+ */
+inline bool start(const char* path) { return internal::trace_writer::instance().start(path); }
+
+/**
+ * @brief Flushes and closes the active trace.
+ *
+ * Records that other threads are producing concurrently may be dropped.
+ */
+inline void stop() { internal::trace_writer::instance().stop(); }
+
+/**
+ * @brief Reads a trace file written by start()/stop().
+ *
+ * @throws std::runtime_error if the file cannot be read or is malformed.
+ */
+inline trace_data read(const char* path) {
+  std::unique_ptr<std::FILE, int (*)(std::FILE*)> file{std::fopen(path, "rb"), &std::fclose};
+  if(!file) internal::throw_invalid_trace("trace::read: cannot open file");
+
+  internal::trace_file_header header{};
+  if(std::fread(&header, sizeof(header), 1, file.get()) != 1 ||
+      std::memcmp(header.magic, internal::trace_magic, sizeof(header.magic)) != 0 ||
+      header.version != internal::trace_version || header.record_size != sizeof(record))
+    internal::throw_invalid_trace("trace::read: not a small_vector trace");
+
+  trace_data trace;
+  std::uint32_t chunk[2];
+  while(std::fread(chunk, sizeof(chunk), 1, file.get()) == 1) {
+    if(chunk[0] == internal::trace_chunk_type) {
+      internal::trace_type_header type{};
+      if(chunk[1] < sizeof(type) || std::fread(&type, sizeof(type), 1, file.get()) != 1 ||
+          chunk[1] != sizeof(type) + type.name_size)
+        internal::throw_invalid_trace("trace::read: malformed type");
+      type_desc desc{type.id, type.value_size, type.value_align, type.inline_size, type.flags,
+          std::string(type.name_size, '\0')};
+      if(type.name_size != 0 && std::fread(&desc.name[0], 1, type.name_size, file.get()) !=
+                                    type.name_size)
+        internal::throw_invalid_trace("trace::read: truncated type");
+      if(desc.id != trace.types.size()) internal::throw_invalid_trace("trace::read: bad type id");
+      trace.types.push_back(std::move(desc));
+    } else if(chunk[0] == internal::trace_chunk_record && chunk[1] % sizeof(record) == 0) {
+      const std::size_t first = trace.records.size();
+      const std::size_t count = chunk[1] / sizeof(record);
+      trace.records.resize(first + count);
+      if(std::fread(&trace.records[first], sizeof(record), count, file.get()) != count)
+        internal::throw_invalid_trace("trace::read: truncated records");
+    } else {
+      internal::throw_invalid_trace("trace::read: malformed chunk");
+    }
+  }
+
+  for(const auto& r : trace.records) {
+    if(r.type >= trace.types.size() || r.op > static_cast<std::uint8_t>(op::swap))
+      internal::throw_invalid_trace("trace::read: malformed record");
+  }
+
+  // Threads flush their buffers independently.
+  std::sort(trace.records.begin(), trace.records.end(),
+      [](const record& l, const record& r) { return l.sequence < r.sequence; });
+  return trace;
+}
+
+} // namespace trace
+} // namespace jacl
+
+#endif // JACL_SMALL_VECTOR_TRACE_HH
@@ -0,0 +1,427 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JACL_HAS_MMAP 1
+#else
+#define JACL_HAS_MMAP 0
+#endif // defined(__unix__) || defined(__APPLE__)
+
+namespace jacl {
+namespace internal {
+
+// Magic numbers are stored in native byte order, so a file written on a host
+// with a different endianness fails validation instead of being misread.
+constexpr uint32_t serialized_vector_magic = 0x5653564au; // "JSVV"
+constexpr uint32_t serialized_file_magic   = 0x4653564au; // "JSVF"
+constexpr uint16_t serialized_version      = 1;
+
+// Records are aligned to this boundary within a file. It bounds the alignment
+// of the element types that can be mapped in place.
+constexpr std::size_t serialized_record_alignment = 64;
+
+/**
+ * @brief Header that precedes the payload of every serialized vector.
+ */
+struct serialized_vector_header {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t value_alignment;
+  uint8_t value_kind; ///< Distinguishes element types of the same size and alignment.
+  uint32_t value_size;
+  uint32_t size;
+  uint64_t payload_offset; ///< Offset of the payload from the start of the header.
+  uint64_t record_size;    ///< Header, padding, and payload bytes.
+}; // struct serialized_vector_header
+
+/**
+ * @brief Trailer at the end of a serialized vector file.
+ *
+ * The trailer points at an index of `count` 64-bit record offsets, which lets
+ * the writer stream records without seeking back.
+ */
+struct serialized_file_trailer {
+  uint64_t index_offset;
+  uint64_t count;
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+}; // struct serialized_file_trailer
+
+constexpr std::size_t align_up(std::size_t n, std::size_t alignment) noexcept {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+inline void throw_invalid_serialized_data(const char* what) {
+#if !JACL_NO_EXCEPTIONS
+  throw std::runtime_error{what};
+#else
+  (void)what;
+  std::abort();
+#endif // JACL_NO_EXCEPTIONS
+}
+
+template <typename valueT>
+constexpr uint8_t serialized_value_kind() noexcept {
+  return std::is_floating_point<valueT>::value ? 3
+         : std::is_unsigned<valueT>::value     ? 2
+         : std::is_signed<valueT>::value       ? 1
+                                               : 0;
+}
+
+template <typename valueT>
+constexpr std::size_t serialized_payload_offset() noexcept {
+  return align_up(sizeof(serialized_vector_header), alignof(valueT));
+}
+
+} // namespace internal
+
+/**
+ * @brief A read-only view of a contiguous sequence of elements.
+ *
+ * `small_vector_view` provides the const API of `small_vector` over memory it
+ * does not own, typically a serialized vector inside a memory-mapped file. The
+ * view never allocates and is trivially copyable.
+ *
+ * @tparam valueT The type of the elements.
+ */
+template <typename valueT>
+class small_vector_view {
+public:
+  using value_type             = valueT;
+  using reference              = const value_type&;
+  using const_reference        = const value_type&;
+  using size_type              = std::size_t;
+  using difference_type        = std::ptrdiff_t;
+  using pointer                = const value_type*;
+  using const_pointer          = const value_type*;
+  using iterator               = const_pointer;
+  using const_iterator         = const_pointer;
+  using reverse_iterator       = std::reverse_iterator<const_iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  constexpr small_vector_view() noexcept = default;
+
+  constexpr small_vector_view(const_pointer data, size_type size) noexcept :
+      data_{data}, size_{size} {}
+
+  template <size_t sizeN, typename allocT>
+  small_vector_view(const small_vector<valueT, sizeN, allocT>& v) noexcept :
+      data_{v.data()}, size_{v.size()} {}
+
+  /**
+   * @brief Creates a view over a serialized vector.
+   *
+   * Validates the record header at `bytes` against `valueT` and the number of
+   * readable bytes `n`. The payload is not copied.
+   *
+   * @param bytes The start of a record written by `serialize`.
+   * @param n The number of readable bytes starting at `bytes`.
+   * @return small_vector_view The view of the serialized elements.
+   *
+   * @throws std::runtime_error If the record is malformed, truncated, or was
+   * written for a different element type.
+   */
+  static small_vector_view from_bytes(const void* bytes, std::size_t n) {
+    static_assert(std::is_trivially_copyable<value_type>::value,
+        "small_vector_view: valueT must be trivially copyable to be mapped");
+
+    internal::serialized_vector_header header;
+    if(JACL_UNLIKELY(n < sizeof(header)))
+      internal::throw_invalid_serialized_data("small_vector_view: truncated header");
+    std::memcpy(&header, bytes, sizeof(header));
+
+    if(JACL_UNLIKELY(header.magic != internal::serialized_vector_magic ||
+                     header.version != internal::serialized_version))
+      internal::throw_invalid_serialized_data("small_vector_view: bad record header");
+    if(JACL_UNLIKELY(header.value_size != sizeof(value_type) ||
+                     header.value_alignment != alignof(value_type) ||
+                     header.value_kind != internal::serialized_value_kind<value_type>()))
+      internal::throw_invalid_serialized_data("small_vector_view: value type mismatch");
+    if(JACL_UNLIKELY(header.payload_offset != internal::serialized_payload_offset<value_type>() ||
+                     header.record_size > n ||
+                     header.record_size < header.payload_offset +
+                                              uint64_t(header.size) * sizeof(value_type)))
+      internal::throw_invalid_serialized_data("small_vector_view: truncated payload");
+
+    const auto* payload = static_cast<const unsigned char*>(bytes) + header.payload_offset;
+    if(JACL_UNLIKELY(reinterpret_cast<std::uintptr_t>(payload) % alignof(value_type) != 0))
+      internal::throw_invalid_serialized_data("small_vector_view: misaligned payload");
+
+    return small_vector_view{reinterpret_cast<const_pointer>(payload), header.size};
+  }
+
+  const_iterator begin() const noexcept { return data_; }
+  const_iterator end() const noexcept { return data_ + size_; }
+  const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+  const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+  const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+  const_reverse_iterator crend() const noexcept { return rend(); }
+
+  size_type size() const noexcept { return size_; }
+  size_type capacity() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  const_reference operator[](size_type n) const { return data_[n]; }
+  const_reference at(size_type n) const {
+    if(n >= size_) {
+#if !JACL_NO_EXCEPTIONS
+      throw std::out_of_range{"small_vector_view::at"};
+#else
+      std::abort();
+#endif // JACL_NO_EXCEPTIONS
+    }
+    return data_[n];
+  }
+
+  const_reference front() const { return data_[0]; }
+  const_reference back() const { return data_[size_ - 1]; }
+
+  const_pointer data() const noexcept { return data_; }
+
+private:
+  const_pointer data_{};
+  size_type size_{};
+}; // class small_vector_view
+
+/**
+ * @brief Returns the number of bytes `serialize` writes for `size` elements.
+ */
+template <typename valueT>
+constexpr std::size_t serialized_size(std::size_t size) noexcept {
+  return internal::align_up(
+      internal::serialized_payload_offset<valueT>() + size * sizeof(valueT),
+      internal::serialized_record_alignment);
+}
+
+/**
+ * @brief Serializes a contiguous sequence of elements as a single record.
+ *
+ * The record consists of a header, padding up to the element alignment, the raw
+ * element bytes, and padding up to the record alignment, so that consecutive
+ * records remain aligned. The element type must be trivially copyable.
+ *
+ * @param out The stream to write the record to.
+ * @param data Pointer to the first element.
+ * @param size The number of elements.
+ * @return std::size_t The number of bytes written.
+ */
+template <typename valueT>
+std::size_t serialize(std::ostream& out, const valueT* data, std::size_t size) {
+  static_assert(std::is_trivially_copyable<valueT>::value,
+      "serialize: valueT must be trivially copyable");
+  static_assert(alignof(valueT) <= internal::serialized_record_alignment,
+      "serialize: valueT is over-aligned for the serialized format");
+
+  if(JACL_UNLIKELY(size > std::numeric_limits<uint32_t>::max()))
+    internal::throw_invalid_serialized_data("serialize: too many elements");
+
+  internal::serialized_vector_header header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic           = internal::serialized_vector_magic;
+  header.version         = internal::serialized_version;
+  header.value_alignment = alignof(valueT);
+  header.value_kind      = internal::serialized_value_kind<valueT>();
+  header.value_size      = sizeof(valueT);
+  header.size            = uint32_t(size);
+  header.payload_offset  = internal::serialized_payload_offset<valueT>();
+  header.record_size     = serialized_size<valueT>(size);
+
+  static const char zeros[internal::serialized_record_alignment] = {};
+  const std::size_t payload_bytes = size * sizeof(valueT);
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(zeros, std::streamsize(header.payload_offset - sizeof(header)));
+  out.write(reinterpret_cast<const char*>(data), std::streamsize(payload_bytes));
+  out.write(zeros, std::streamsize(header.record_size - header.payload_offset - payload_bytes));
+  return std::size_t(header.record_size);
+}
+
+template <typename valueT, size_t sizeN, typename allocT>
+std::size_t serialize(std::ostream& out, const small_vector<valueT, sizeN, allocT>& v) {
+  return serialize(out, v.data(), v.size());
+}
+
+/**
+ * @brief Writes a file of serialized vectors that `mapped_small_vector_file`
+ * can load.
+ *
+ * Records are appended as they are added. `finish()` writes the record index
+ * and the trailer; the file is not loadable until it has been called.
+ */
+class serialized_vector_writer {
+public:
+  explicit serialized_vector_writer(std::ostream& out) : out_{out} {}
+
+  template <typename valueT, size_t sizeN, typename allocT>
+  void append(const small_vector<valueT, sizeN, allocT>& v) {
+    append(v.data(), v.size());
+  }
+
+  template <typename valueT>
+  void append(const valueT* data, std::size_t size) {
+    offsets_.push_back(offset_);
+    offset_ += serialize(out_, data, size);
+  }
+
+  void finish() {
+    internal::serialized_file_trailer trailer;
+    std::memset(&trailer, 0, sizeof(trailer));
+    trailer.index_offset = offset_;
+    trailer.count        = offsets_.size();
+    trailer.magic        = internal::serialized_file_magic;
+    trailer.version      = internal::serialized_version;
+
+    out_.write(reinterpret_cast<const char*>(offsets_.data()),
+        std::streamsize(offsets_.size() * sizeof(uint64_t)));
+    out_.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    out_.flush();
+  }
+
+private:
+  std::ostream& out_;
+  std::vector<uint64_t> offsets_;
+  uint64_t offset_{};
+}; // class serialized_vector_writer
+
+#if JACL_HAS_MMAP
+
+/**
+ * @brief A read-only memory mapping of a file of serialized vectors.
+ *
+ * Opening the file validates only the trailer and the record index; pages are
+ * faulted in on first access and each record header is validated when its
+ * view is requested. This keeps the cost of opening independent of the number
+ * and size of the vectors in the file.
+ */
+class mapped_small_vector_file {
+public:
+  mapped_small_vector_file() noexcept = default;
+
+  /**
+   * @brief Maps the file at `path`.
+   *
+   * @throws std::runtime_error If the file cannot be opened or mapped, or if
+   * its trailer or index is malformed.
+   */
+  explicit mapped_small_vector_file(const char* path) {
+    const int fd = ::open(path, O_RDONLY);
+    if(JACL_UNLIKELY(fd < 0))
+      internal::throw_invalid_serialized_data("mapped_small_vector_file: cannot open file");
+    defer { ::close(fd); };
+
+    struct stat st;
+    if(JACL_UNLIKELY(::fstat(fd, &st) != 0))
+      internal::throw_invalid_serialized_data("mapped_small_vector_file: cannot stat file");
+    if(JACL_UNLIKELY(std::size_t(st.st_size) < sizeof(internal::serialized_file_trailer)))
+      internal::throw_invalid_serialized_data("mapped_small_vector_file: truncated file");
+
+    void* base = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if(JACL_UNLIKELY(base == MAP_FAILED))
+      internal::throw_invalid_serialized_data("mapped_small_vector_file: cannot map file");
+    base_ = static_cast<const unsigned char*>(base);
+    size_ = std::size_t(st.st_size);
+    defer_fail { unmap(); };
+
+    internal::serialized_file_trailer trailer;
+    std::memcpy(&trailer, base_ + size_ - sizeof(trailer), sizeof(trailer));
+    if(JACL_UNLIKELY(trailer.magic != internal::serialized_file_magic ||
+                     trailer.version != internal::serialized_version))
+      internal::throw_invalid_serialized_data("mapped_small_vector_file: bad trailer");
+    const uint64_t index_end = size_ - sizeof(trailer);
+    if(JACL_UNLIKELY(trailer.index_offset > index_end ||
+                     trailer.index_offset % alignof(uint64_t) != 0 ||
+                     (index_end - trailer.index_offset) / sizeof(uint64_t) != trailer.count))
+      internal::throw_invalid_serialized_data("mapped_small_vector_file: bad index");
+
+    index_ = reinterpret_cast<const uint64_t*>(base_ + trailer.index_offset);
+    count_ = std::size_t(trailer.count);
+    data_end_ = std::size_t(trailer.index_offset);
+  }
+
+  mapped_small_vector_file(mapped_small_vector_file&& other) noexcept :
+      base_{internal::exchange(other.base_, nullptr)},
+      size_{internal::exchange(other.size_, 0)},
+      index_{internal::exchange(other.index_, nullptr)},
+      count_{internal::exchange(other.count_, 0)},
+      data_end_{internal::exchange(other.data_end_, 0)} {}
+
+  mapped_small_vector_file& operator=(mapped_small_vector_file&& other) noexcept {
+    if(this != &other) {
+      unmap();
+      base_     = internal::exchange(other.base_, nullptr);
+      size_     = internal::exchange(other.size_, 0);
+      index_    = internal::exchange(other.index_, nullptr);
+      count_    = internal::exchange(other.count_, 0);
+      data_end_ = internal::exchange(other.data_end_, 0);
+    }
+    return *this;
+  }
+
+  mapped_small_vector_file(const mapped_small_vector_file&)            = delete;
+  mapped_small_vector_file& operator=(const mapped_small_vector_file&) = delete;
+
+  ~mapped_small_vector_file() { unmap(); }
+
+  /**
+   * @brief The number of vectors in the file.
+   */
+  std::size_t size() const noexcept { return count_; }
+
+  bool empty() const noexcept { return count_ == 0; }
+
+  /**
+   * @brief Returns a view of the `i`-th vector in the file.
+   *
+   * @throws std::out_of_range If `i` is not less than `size()`.
+   * @throws std::runtime_error If the record is malformed or was written for a
+   * different element type.
+   */
+  template <typename valueT>
+  small_vector_view<valueT> view(std::size_t i) const {
+    if(i >= count_) {
+#if !JACL_NO_EXCEPTIONS
+      throw std::out_of_range{"mapped_small_vector_file::view"};
+#else
+      std::abort();
+#endif // JACL_NO_EXCEPTIONS
+    }
+
+    const uint64_t offset = index_[i];
+    if(JACL_UNLIKELY(offset > data_end_ || offset % internal::serialized_record_alignment != 0))
+      internal::throw_invalid_serialized_data("mapped_small_vector_file: bad record offset");
+    return small_vector_view<valueT>::from_bytes(base_ + offset, data_end_ - offset);
+  }
+
+private:
+  void unmap() noexcept {
+    if(base_) ::munmap(const_cast<unsigned char*>(base_), size_);
+    base_ = nullptr;
+  }
+
+  const unsigned char* base_{};
+  std::size_t size_{};
+  const uint64_t* index_{};
+  std::size_t count_{};
+  std::size_t data_end_{};
+}; // class mapped_small_vector_file
+
+#endif // JACL_HAS_MMAP
+
+} // namespace jacl
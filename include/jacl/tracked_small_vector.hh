@@ -0,0 +1,397 @@
+#pragma once
+
+#include <jacl/small_vector.hh>
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+namespace jacl {
+
+/**
+ * @brief A half-open range of element indices, `[first, last)`.
+ */
+struct index_range {
+  std::size_t first;
+  std::size_t last;
+
+  std::size_t size() const noexcept { return last - first; }
+
+  bool operator==(const index_range& other) const noexcept {
+    return first == other.first && last == other.last;
+  }
+  bool operator!=(const index_range& other) const noexcept { return !(*this == other); }
+}; // struct index_range
+
+/**
+ * @brief A set of disjoint index ranges.
+ *
+ * Inserted ranges are coalesced with any ranges they overlap or touch, so the
+ * set always holds the minimal number of sorted, non-adjacent ranges.
+ */
+class index_range_set {
+  using ranges_type = small_vector<index_range, 4>;
+
+public:
+  using const_iterator = ranges_type::const_iterator;
+  using size_type      = ranges_type::size_type;
+
+  /**
+   * @brief Adds `[first, last)` to the set.
+   *
+   * @complexity Logarithmic in the number of ranges to locate the insertion
+   * point, plus linear in the number of ranges after it.
+   */
+  void insert(std::size_t first, std::size_t last) {
+    if(first >= last) return;
+
+    // The first range that overlaps or touches `[first, last)`.
+    auto lo = std::lower_bound(ranges_.begin(), ranges_.end(), first,
+        [](const index_range& r, std::size_t i) { return r.last < i; });
+    // One past the last range that overlaps or touches `[first, last)`.
+    auto hi = std::upper_bound(lo, ranges_.end(), last,
+        [](std::size_t i, const index_range& r) { return i < r.first; });
+
+    if(lo == hi) {
+      ranges_.insert(lo, {index_range{first, last}});
+    } else {
+      lo->first = std::min(lo->first, first);
+      lo->last  = std::max((hi - 1)->last, last);
+      ranges_.erase(lo + 1, hi);
+    }
+  }
+
+  /**
+   * @brief Removes every index greater than or equal to `n` from the set.
+   */
+  void truncate(std::size_t n) {
+    while(!ranges_.empty() && ranges_.back().first >= n) ranges_.pop_back();
+    if(!ranges_.empty() && ranges_.back().last > n) ranges_.back().last = n;
+  }
+
+  bool contains(std::size_t i) const noexcept {
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), i,
+        [](std::size_t j, const index_range& r) { return j < r.first; });
+    return it != ranges_.begin() && i < (it - 1)->last;
+  }
+
+  /**
+   * @brief The total number of indices covered by the set.
+   */
+  std::size_t count() const noexcept {
+    std::size_t n = 0;
+    for(const auto& r : ranges_) n += r.size();
+    return n;
+  }
+
+  void clear() noexcept { ranges_.clear(); }
+
+  bool empty() const noexcept { return ranges_.empty(); }
+  size_type size() const noexcept { return ranges_.size(); }
+  const_iterator begin() const noexcept { return ranges_.begin(); }
+  const_iterator end() const noexcept { return ranges_.end(); }
+
+private:
+  ranges_type ranges_;
+}; // class index_range_set
+
+/**
+ * @brief The changes made to a `tracked_small_vector` since the previous delta.
+ *
+ * `values` holds the current values of the elements in `ranges`, in range
+ * order. Applying a delta to a copy of the vector taken when the previous delta
+ * was emitted reproduces the current contents of the vector.
+ */
+template <typename valueT>
+struct small_vector_delta {
+  std::size_t size{};                  ///< The size of the vector after the changes.
+  small_vector<index_range, 4> ranges; ///< The modified index ranges, sorted and disjoint.
+  std::vector<valueT> values;          ///< The values of the modified elements.
+
+  bool empty() const noexcept { return ranges.empty(); }
+}; // struct small_vector_delta
+
+/**
+ * @brief Applies `delta` to `target`.
+ *
+ * `target` is resized to `delta.size`, then the modified elements are assigned
+ * from the delta. New elements are default constructed before assignment.
+ */
+template <typename valueT, size_t sizeN, typename allocT>
+void apply_delta(
+    small_vector<valueT, sizeN, allocT>& target, const small_vector_delta<valueT>& delta) {
+  target.resize(delta.size);
+  auto value = delta.values.begin();
+  for(const auto& r : delta.ranges) {
+    std::copy(value, value + r.size(), target.begin() + r.first);
+    value += r.size();
+  }
+}
+
+/**
+ * @brief A small vector that records which elements have been modified.
+ *
+ * `tracked_small_vector` wraps a `small_vector` and records the index ranges
+ * modified through its mutating API in a coalesced `index_range_set`. The
+ * recorded changes are emitted with `take_delta()`, so replicating the vector
+ * costs time proportional to the size of the changes rather than the size of
+ * the vector.
+ *
+ * Non-const element access (`operator[]`, `at`, `front`, `back`) marks the
+ * accessed element as modified. Non-const `begin()`, `end()`, and `data()` mark
+ * every element as modified; use the const overloads together with
+ * `mark_dirty()` for targeted writes through pointers.
+ *
+ * Shifting elements with `insert` or `erase` marks every element after the
+ * position as modified.
+ *
+ * @tparam valueT The type of the elements.
+ * @tparam sizeN The static capacity of the underlying small vector.
+ * @tparam allocT The allocator type of the underlying small vector.
+ */
+template <typename valueT, size_t sizeN, typename allocT = std::allocator<valueT>>
+class tracked_small_vector {
+  using vector_type = small_vector<valueT, sizeN, allocT>;
+
+public:
+  using value_type             = typename vector_type::value_type;
+  using allocator_type         = typename vector_type::allocator_type;
+  using reference              = typename vector_type::reference;
+  using const_reference        = typename vector_type::const_reference;
+  using size_type              = typename vector_type::size_type;
+  using difference_type        = typename vector_type::difference_type;
+  using pointer                = typename vector_type::pointer;
+  using const_pointer          = typename vector_type::const_pointer;
+  using iterator               = typename vector_type::iterator;
+  using const_iterator         = typename vector_type::const_iterator;
+  using reverse_iterator       = typename vector_type::reverse_iterator;
+  using const_reverse_iterator = typename vector_type::const_reverse_iterator;
+  using delta_type             = small_vector_delta<value_type>;
+
+  tracked_small_vector() = default;
+
+  explicit tracked_small_vector(const allocator_type& a) : data_{a} {}
+
+  /**
+   * @brief Constructs a tracked vector from the contents of `v`.
+   *
+   * The initial contents are considered modified, so the first delta carries
+   * the full vector.
+   */
+  explicit tracked_small_vector(vector_type v) : data_{std::move(v)} {
+    dirty_.insert(0, data_.size());
+  }
+
+  tracked_small_vector(std::initializer_list<value_type> il) : data_{il} {
+    dirty_.insert(0, data_.size());
+  }
+
+  /**
+   * @brief The underlying vector.
+   */
+  const vector_type& get() const noexcept { return data_; }
+
+  const allocator_type& get_allocator() const noexcept { return data_.get_allocator(); }
+
+  iterator begin() noexcept {
+    mark_all_dirty();
+    return data_.begin();
+  }
+  const_iterator begin() const noexcept { return data_.begin(); }
+  iterator end() noexcept {
+    mark_all_dirty();
+    return data_.end();
+  }
+  const_iterator end() const noexcept { return data_.end(); }
+  const_iterator cbegin() const noexcept { return data_.cbegin(); }
+  const_iterator cend() const noexcept { return data_.cend(); }
+  const_reverse_iterator crbegin() const noexcept { return data_.crbegin(); }
+  const_reverse_iterator crend() const noexcept { return data_.crend(); }
+
+  size_type size() const noexcept { return data_.size(); }
+  size_type capacity() const noexcept { return data_.capacity(); }
+  bool empty() const noexcept { return data_.empty(); }
+
+  reference operator[](size_type n) {
+    dirty_.insert(n, n + 1);
+    return data_[n];
+  }
+  const_reference operator[](size_type n) const { return data_[n]; }
+  reference at(size_type n) {
+    reference result = data_.at(n);
+    dirty_.insert(n, n + 1);
+    return result;
+  }
+  const_reference at(size_type n) const { return data_.at(n); }
+
+  reference front() { return (*this)[0]; }
+  const_reference front() const { return data_.front(); }
+  reference back() { return (*this)[size() - 1]; }
+  const_reference back() const { return data_.back(); }
+
+  pointer data() noexcept {
+    mark_all_dirty();
+    return data_.data();
+  }
+  const_pointer data() const noexcept { return data_.data(); }
+
+  /**
+   * @brief Assigns `value` to the element at `n` and marks it as modified.
+   */
+  void set(size_type n, const value_type& value) { (*this)[n] = value; }
+  void set(size_type n, value_type&& value) { (*this)[n] = std::move(value); }
+
+  /**
+   * @brief Marks `[first, last)` as modified.
+   *
+   * Use this after writing to elements through a pointer obtained from the
+   * const API.
+   */
+  void mark_dirty(size_type first, size_type last) {
+    dirty_.insert(first, std::min<size_type>(last, size()));
+  }
+
+  void push_back(const value_type& x) { emplace_back(x); }
+  void push_back(value_type&& x) { emplace_back(std::move(x)); }
+  template <class... Args>
+  reference emplace_back(Args&&... args) {
+    reference result = data_.emplace_back(std::forward<Args>(args)...);
+    dirty_.insert(size() - 1, size());
+    return result;
+  }
+
+  void pop_back() {
+    data_.pop_back();
+    dirty_.truncate(size());
+  }
+
+  template <typename... Args>
+  iterator emplace(const_iterator position, Args&&... args) {
+    const size_type offset = position - cbegin();
+    iterator result        = data_.emplace(position, std::forward<Args>(args)...);
+    dirty_.insert(offset, size());
+    return result;
+  }
+
+  iterator insert(const_iterator position, const value_type& value) {
+    return emplace(position, value);
+  }
+  iterator insert(const_iterator position, value_type&& value) {
+    return emplace(position, std::move(value));
+  }
+
+  template <typename iterT>
+  iterator insert(const_iterator position, iterT first, iterT last) {
+    const size_type offset = position - cbegin();
+    iterator result        = data_.insert(position, first, last);
+    dirty_.insert(offset, size());
+    return result;
+  }
+
+  iterator insert(const_iterator position, std::initializer_list<value_type> il) {
+    return insert(position, il.begin(), il.end());
+  }
+
+  iterator erase(const_iterator position) { return erase(position, position + 1); }
+
+  iterator erase(const_iterator first, const_iterator last) {
+    const size_type offset = first - cbegin();
+    iterator result        = data_.erase(first, last);
+    dirty_.truncate(size());
+    dirty_.insert(offset, size());
+    return result;
+  }
+
+  void clear() noexcept {
+    data_.clear();
+    dirty_.clear();
+  }
+
+  void reserve(size_type sz) { data_.reserve(sz); }
+
+  void resize(size_type sz) {
+    const size_type old_size = size();
+    data_.resize(sz);
+    resized(old_size);
+  }
+
+  void resize(size_type sz, const value_type& value) {
+    const size_type old_size = size();
+    data_.resize(sz, value);
+    resized(old_size);
+  }
+
+  template <typename iterT>
+  void assign(iterT first, iterT last) {
+    data_.assign(first, last);
+    dirty_.clear();
+    mark_all_dirty();
+  }
+
+  void assign(size_type sz, const value_type& val) {
+    data_.assign(sz, val);
+    dirty_.clear();
+    mark_all_dirty();
+  }
+
+  void assign(std::initializer_list<value_type> il) { assign(il.begin(), il.end()); }
+
+  /**
+   * @brief The index ranges modified since the last call to `take_delta()`.
+   */
+  const index_range_set& dirty_ranges() const noexcept { return dirty_; }
+
+  /**
+   * @brief Emits the changes made since the previous delta and resets tracking.
+   *
+   * @return delta_type The new size of the vector and the values of the
+   * modified elements.
+   */
+  delta_type take_delta() {
+    delta_type delta;
+    delta.size = size();
+    delta.values.reserve(dirty_.count());
+    for(const auto& r : dirty_) {
+      delta.ranges.push_back(r);
+      delta.values.insert(delta.values.end(), data_.cbegin() + r.first, data_.cbegin() + r.last);
+    }
+    dirty_.clear();
+    return delta;
+  }
+
+  /**
+   * @brief Applies a delta emitted by another tracked vector.
+   *
+   * The applied elements are marked as modified so that the changes propagate
+   * to deltas emitted by this vector.
+   */
+  void apply_delta(const delta_type& delta) {
+    jacl::apply_delta(data_, delta);
+    dirty_.truncate(size());
+    for(const auto& r : delta.ranges) dirty_.insert(r.first, r.last);
+  }
+
+  void swap(tracked_small_vector& other) noexcept(noexcept(std::declval<vector_type&>().swap(
+      std::declval<vector_type&>()))) {
+    data_.swap(other.data_);
+    std::swap(dirty_, other.dirty_);
+  }
+
+private:
+  void mark_all_dirty() { dirty_.insert(0, size()); }
+
+  void resized(size_type old_size) {
+    if(size() > old_size) {
+      dirty_.insert(old_size, size());
+    } else {
+      dirty_.truncate(size());
+    }
+  }
+
+  vector_type data_;
+  index_range_set dirty_;
+}; // class tracked_small_vector
+
+} // namespace jacl
@@ -0,0 +1,19 @@
+// C++20 module interface for small_vector.
+//
+//   import jacl.small_vector;
+//
+// The header is included in the global module fragment, so the module and the
+// header can be used side by side in the same program. Macros (JACL_LIKELY,
+// JACL_CONSTEXPR20, etc.) are not exported; include the header if needed.
+
+module;
+
+#include "jacl/small_vector.hh"
+
+export module jacl.small_vector;
+
+export namespace jacl {
+
+using jacl::small_vector;
+
+} // namespace jacl
@@ -0,0 +1,14 @@
+// Explicit instantiations of the common small_vector specializations. Linking
+// the small_vector_instantiations library defines
+// JACL_SMALL_VECTOR_EXTERN_TEMPLATES for consumers, which then reuse these
+// definitions instead of instantiating the class template themselves.
+
+#include "jacl/small_vector.hh"
+
+namespace jacl {
+
+#define JACL_SMALL_VECTOR_INSTANTIATE(valueT, sizeN) template class small_vector<valueT, sizeN>;
+JACL_SMALL_VECTOR_COMMON_INSTANTIATIONS(JACL_SMALL_VECTOR_INSTANTIATE)
+#undef JACL_SMALL_VECTOR_INSTANTIATE
+
+} // namespace jacl
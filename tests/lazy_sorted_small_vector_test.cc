@@ -0,0 +1,70 @@
+#include "jacl/lazy_sorted_small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+TEST(LazySortedSmallVectorTest, SortsOnRead) {
+  jacl::lazy_sorted_small_vector<int, 4> vec{5, 1, 4};
+  EXPECT_FALSE(vec.is_sorted());
+  EXPECT_EQ(vec.front(), 1);
+  EXPECT_TRUE(vec.is_sorted());
+
+  vec.push_back(3);
+  vec.emplace_back(0);
+  vec.push_back(9);
+  EXPECT_EQ(vec.unsorted_size(), 3);
+  EXPECT_EQ(vec.size(), 6);
+  EXPECT_TRUE(std::equal(vec.begin(), vec.end(), std::vector<int>{0, 1, 3, 4, 5, 9}.begin()));
+  EXPECT_TRUE(vec.contains(4));
+  EXPECT_FALSE(vec.contains(2));
+  EXPECT_EQ(*vec.lower_bound(2), 3);
+  EXPECT_EQ(vec.back(), 9);
+
+  vec.erase(vec.lower_bound(3));
+  EXPECT_TRUE(vec.is_sorted());
+  EXPECT_TRUE(std::equal(vec.begin(), vec.end(), std::vector<int>{0, 1, 4, 5, 9}.begin()));
+
+  vec.clear();
+  EXPECT_TRUE(vec.empty());
+  EXPECT_TRUE(vec.is_sorted());
+}
+
+TEST(LazySortedSmallVectorTest, MatchesAFullSort) {
+  jacl::lazy_sorted_small_vector<std::string, 8, std::greater<std::string>> vec;
+  std::vector<std::string> model;
+  std::mt19937 rng{7};
+  for(int round = 0; round < 200; ++round) {
+    const std::size_t k = rng() % 20;
+    for(std::size_t i = 0; i < k; ++i) {
+      std::string s = std::to_string(rng() % 1000);
+      model.push_back(s);
+      vec.push_back(std::move(s));
+    }
+    std::sort(model.begin(), model.end(), std::greater<std::string>());
+    ASSERT_EQ(vec.size(), model.size());
+    ASSERT_TRUE(std::equal(vec.begin(), vec.end(), model.begin())) << "round " << round;
+  }
+}
+
+TEST(LazySortedSmallVectorTest, MergeIsStable) {
+  using entry = std::pair<int, int>;
+  struct by_key {
+    bool operator()(const entry& a, const entry& b) const { return a.first < b.first; }
+  };
+  jacl::lazy_sorted_small_vector<entry, 4, by_key> vec;
+  const std::vector<entry> initial{{2, 0}, {1, 1}, {3, 2}};
+  vec.append(initial.begin(), initial.end());
+  vec.sort();
+  const std::vector<entry> appended{{2, 3}, {1, 4}, {2, 5}};
+  vec.append(appended.begin(), appended.end());
+
+  const std::vector<entry> expected{{1, 1}, {1, 4}, {2, 0}, {2, 3}, {2, 5}, {3, 2}};
+  EXPECT_TRUE(std::equal(vec.begin(), vec.end(), expected.begin()));
+}
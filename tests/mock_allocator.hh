@@ -0,0 +1,125 @@
+#pragma once
+
+#include "jacl/small_vector.hh"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+
+// Counts the allocations made through MockAllocator. The counters are shared by
+// every MockAllocator instantiation and reset by the test fixtures.
+class AllocationStats {
+public:
+  static std::size_t allocation_count() { return counters().allocation_count; }
+  static std::size_t deallocation_count() { return counters().deallocation_count; }
+  static std::size_t total_allocated() { return counters().total_allocated; }
+  static std::size_t total_deallocated() { return counters().total_deallocated; }
+  static std::size_t outstanding_allocations() { return counters().allocations.size(); }
+
+  static void reset_counters() { counters() = state{}; }
+
+protected:
+  static void record_allocation(void* ptr, std::size_t n) {
+    counters().allocation_count++;
+    counters().total_allocated  += n;
+    counters().allocations[ptr]  = n;
+  }
+
+  static void record_deallocation(void* ptr, std::size_t n) {
+    counters().deallocation_count++;
+    counters().total_deallocated += n;
+    auto it                       = counters().allocations.find(ptr);
+    if(it != counters().allocations.end()) { counters().allocations.erase(it); }
+  }
+
+private:
+  struct state {
+    std::size_t allocation_count{};
+    std::size_t deallocation_count{};
+    std::size_t total_allocated{};
+    std::size_t total_deallocated{};
+    std::unordered_map<void*, std::size_t> allocations;
+  }; // struct state
+
+  // C++11 compatible alternative to inline static members.
+  static state& counters() {
+    static state s;
+    return s;
+  }
+}; // class AllocationStats
+
+class StatefulPolicy {
+public:
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap            = std::true_type;
+
+  StatefulPolicy() : id_{next_id()} {}
+
+  StatefulPolicy(const StatefulPolicy&) noexcept : id_{next_id()} {}
+
+  StatefulPolicy& operator=(const StatefulPolicy&) noexcept {
+    id_ = next_id();
+    return *this;
+  }
+
+  StatefulPolicy(StatefulPolicy&& other) noexcept :
+      id_{jacl::internal::exchange(other.id_, next_id())} {}
+
+  StatefulPolicy& operator=(StatefulPolicy&& other) noexcept {
+    id_ = jacl::internal::exchange(other.id_, next_id());
+    return *this;
+  }
+
+  bool operator==(const StatefulPolicy& other) const noexcept { return id_ == other.id_; }
+  bool operator!=(const StatefulPolicy& other) const noexcept { return id_ != other.id_; }
+
+  std::size_t get_id() const noexcept { return id_; }
+
+private:
+  static std::size_t next_id() {
+    static std::size_t id = 1;
+    return id++;
+  }
+
+  std::size_t id_{};
+}; // class StatefulPolicy
+
+class NonstatefulPolicy {
+public:
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap            = std::true_type;
+
+  bool operator==(const NonstatefulPolicy&) const noexcept { return true; }
+  bool operator!=(const NonstatefulPolicy&) const noexcept { return false; }
+
+}; // class NonstatefulPolicy
+
+// Allocator backed by malloc that records every allocation in AllocationStats.
+template <typename T, typename policyT>
+class MockAllocator : public AllocationStats, public policyT {
+public:
+  using value_type      = T;
+  using size_type       = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment =
+      typename policyT::propagate_on_container_copy_assignment;
+  using propagate_on_container_move_assignment =
+      typename policyT::propagate_on_container_move_assignment;
+  using propagate_on_container_swap = typename policyT::propagate_on_container_swap;
+
+  T* allocate(size_type n) {
+    T* ptr = static_cast<T*>(std::malloc(n * sizeof(T)));
+    if(!ptr) throw std::bad_alloc();
+    record_allocation(ptr, n * sizeof(T));
+    return ptr;
+  }
+
+  void deallocate(T* ptr, size_type n) {
+    record_deallocation(ptr, n * sizeof(T));
+    std::free(ptr);
+  }
+}; // class MockAllocator
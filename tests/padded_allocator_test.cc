@@ -0,0 +1,83 @@
+#include "jacl/padded_allocator.hh"
+
+#include "mock_allocator.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t padding = 64;
+
+// Reads every byte up to the padding past the capacity, as a SIMD kernel
+// without tail handling would. Out-of-bounds reads show up in sanitizer builds.
+template <typename vectorT>
+unsigned over_read(const vectorT& vec) {
+  const std::size_t bytes = vec.capacity() * sizeof(typename vectorT::value_type) + padding;
+  const auto* p           = reinterpret_cast<const unsigned char*>(vec.data());
+  unsigned sum            = 0;
+  unsigned char chunk[16];
+  for(std::size_t i = 0; i + sizeof(chunk) <= bytes; i += sizeof(chunk)) {
+    std::memcpy(chunk, p + i, sizeof(chunk));
+    sum += chunk[0];
+  }
+  std::memcpy(chunk, p + bytes - sizeof(chunk), sizeof(chunk));
+  return sum + chunk[0];
+}
+
+} // namespace
+
+TEST(PaddedAllocatorTest, InlineBufferIsPadded) {
+  using vector_type = jacl::padded_small_vector<std::uint32_t, 4, padding>;
+  static_assert(vector_type::static_capacity == 4, "padding does not change the capacity");
+  static_assert(sizeof(vector_type) >= sizeof(jacl::small_vector<std::uint32_t, 4>) + padding,
+      "the inline buffer is padded");
+
+  vector_type vec{1, 2, 3};
+  EXPECT_EQ(vec.capacity(), 4);
+  const auto* object_end = reinterpret_cast<const unsigned char*>(&vec) + sizeof(vec);
+  const auto* padded_end = reinterpret_cast<const unsigned char*>(vec.data()) +
+                           vec.capacity() * sizeof(std::uint32_t) + padding;
+  EXPECT_LE(padded_end, object_end);
+  over_read(vec);
+}
+
+TEST(PaddedAllocatorTest, HeapBuffersArePadded) {
+  using base_allocator = MockAllocator<std::uint32_t, NonstatefulPolicy>;
+  using allocator_type = jacl::padded_allocator<std::uint32_t, padding, base_allocator>;
+  static_assert(allocator_type::padding_elements == padding / sizeof(std::uint32_t),
+      "the padding is rounded to whole elements");
+
+  AllocationStats::reset_counters();
+  {
+    jacl::small_vector<std::uint32_t, 4, allocator_type> vec;
+    for(std::uint32_t i = 0; i < 100; ++i) {
+      vec.push_back(i);
+      over_read(vec);
+    }
+    vec.reserve(1000);
+    EXPECT_EQ(vec.capacity(), 1000);
+    EXPECT_EQ(AllocationStats::allocation_count(), 9);
+    vec.shrink_to_fit();
+    over_read(vec);
+    vec.resize(2);
+    vec.shrink_to_fit();
+    over_read(vec);
+  }
+  EXPECT_EQ(AllocationStats::total_allocated(), AllocationStats::total_deallocated());
+  EXPECT_EQ(AllocationStats::outstanding_allocations(), 0);
+}
+
+TEST(PaddedAllocatorTest, AllocatesThePaddingOnTop) {
+  using allocator_type =
+      jacl::padded_allocator<double, 20, MockAllocator<double, NonstatefulPolicy>>;
+  AllocationStats::reset_counters();
+  allocator_type alloc;
+  double* p = alloc.allocate(10);
+  EXPECT_EQ(AllocationStats::total_allocated(), (10 + 3) * sizeof(double));
+  alloc.deallocate(p, 10);
+  EXPECT_EQ(AllocationStats::total_deallocated(), (10 + 3) * sizeof(double));
+}
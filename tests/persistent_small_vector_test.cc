@@ -0,0 +1,142 @@
+#include "jacl/persistent_small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+// Counts copies to check that updates copy one path, not the whole vector.
+struct counted {
+  static std::size_t copies;
+
+  counted(int v = 0) : value{v} {}
+  counted(const counted& other) : value{other.value} { ++copies; }
+  counted& operator=(const counted& other) {
+    value = other.value;
+    ++copies;
+    return *this;
+  }
+  counted(counted&&)            = default;
+  counted& operator=(counted&&) = default;
+
+  int value;
+};
+
+std::size_t counted::copies = 0;
+
+template <typename vectorT, typename T>
+void expect_same(const vectorT& vec, const std::vector<T>& model) {
+  ASSERT_EQ(vec.size(), model.size());
+  for(std::size_t i = 0; i < model.size(); ++i) ASSERT_EQ(vec[i], model[i]) << "at " << i;
+  EXPECT_TRUE(std::equal(vec.begin(), vec.end(), model.begin()));
+}
+
+} // namespace
+
+TEST(PersistentSmallVectorTest, StaysInlineUpToTheCapacity) {
+  jacl::persistent_small_vector<std::string, 3> empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_TRUE(empty.is_inline());
+
+  const auto one   = empty.push_back("a");
+  const auto three = one.push_back("b").push_back("c");
+  const auto four  = three.push_back("d");
+  EXPECT_TRUE(three.is_inline());
+  EXPECT_FALSE(four.is_inline());
+  EXPECT_TRUE(four.pop_back().is_inline());
+  EXPECT_EQ(four.pop_back(), three);
+
+  expect_same(empty, std::vector<std::string>{});
+  expect_same(one, std::vector<std::string>{"a"});
+  expect_same(three, std::vector<std::string>{"a", "b", "c"});
+  expect_same(four, std::vector<std::string>{"a", "b", "c", "d"});
+  EXPECT_EQ(four.front(), "a");
+  EXPECT_EQ(four.back(), "d");
+  EXPECT_THROW(four.at(4), std::out_of_range);
+}
+
+TEST(PersistentSmallVectorTest, IteratorConstructor) {
+  const std::vector<int> values{1, 2, 3, 4, 5, 6};
+  const jacl::persistent_small_vector<int, 4> vec(values.begin(), values.end());
+  expect_same(vec, values);
+
+  // Two integers are not an iterator range.
+  EXPECT_FALSE((std::is_constructible<jacl::persistent_small_vector<int, 4>, int, int>::value));
+}
+
+TEST(PersistentSmallVectorTest, OldVersionsAreUnchanged) {
+  // Chunks of 4 so that a few hundred elements build a deep tree.
+  using vector_type = jacl::persistent_small_vector<int, 2, 2>;
+  std::vector<vector_type> versions(1);
+  std::vector<std::vector<int>> models(1);
+
+  std::mt19937 rng{42};
+  for(int step = 0; step < 3000; ++step) {
+    const std::size_t from = rng() % versions.size();
+    vector_type vec        = versions[from];
+    std::vector<int> model = models[from];
+    const unsigned op      = rng() % 8;
+    if(op < 5 || model.empty()) {
+      vec = vec.push_back(step);
+      model.push_back(step);
+    } else if(op < 7) {
+      const std::size_t i = rng() % model.size();
+      vec                 = vec.set(i, -step);
+      model[i]            = -step;
+    } else {
+      vec = vec.pop_back();
+      model.pop_back();
+    }
+    versions.push_back(vec);
+    models.push_back(model);
+  }
+
+  for(std::size_t v = 0; v < versions.size(); ++v) expect_same(versions[v], models[v]);
+}
+
+TEST(PersistentSmallVectorTest, GrowsAndShrinksThroughEveryLevel) {
+  using vector_type = jacl::persistent_small_vector<int, 4, 1>;
+  std::vector<int> model;
+  vector_type vec;
+  for(int i = 0; i < 300; ++i) {
+    vec = vec.push_back(i);
+    model.push_back(i);
+    expect_same(vec, model);
+  }
+
+  const vector_type range(model.begin(), model.end());
+  EXPECT_EQ(range, vec);
+
+  while(!model.empty()) {
+    vec = vec.pop_back();
+    model.pop_back();
+    expect_same(vec, model);
+  }
+  EXPECT_TRUE(vec.is_inline());
+}
+
+TEST(PersistentSmallVectorTest, UpdatesShareUnchangedChunks) {
+  using vector_type = jacl::persistent_small_vector<counted, 8>;
+  std::vector<int> values(10000);
+  for(int i = 0; i < 10000; ++i) values[i] = i;
+  const vector_type vec(values.begin(), values.end());
+
+  counted::copies      = 0;
+  const auto updated   = vec.set(123, 7).set(9999, 8).push_back(10000).pop_back();
+  const std::size_t cc = counted::copies;
+  // One chunk per set, one tail copy each for push_back and pop_back.
+  EXPECT_LE(cc, 4 * vector_type::chunk_size);
+
+  EXPECT_EQ(vec[123].value, 123);
+  EXPECT_EQ(updated[123].value, 7);
+  EXPECT_EQ(vec[9999].value, 9999);
+  EXPECT_EQ(updated[9999].value, 8);
+  EXPECT_EQ(updated.size(), vec.size());
+}
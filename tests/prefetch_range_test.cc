@@ -0,0 +1,48 @@
+#include "jacl/prefetch_range.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+using list_type = jacl::small_vector<int, 2>;
+
+std::vector<list_type> make_lists() {
+  std::vector<list_type> lists;
+  for(int i = 0; i < 20; ++i) {
+    // Every third list spills to the heap.
+    lists.emplace_back(std::size_t(i % 3 == 0 ? 5 : 1), i);
+  }
+  return lists;
+}
+
+} // namespace
+
+TEST(PrefetchRangeTest, VisitsEveryVectorInOrder) {
+  std::vector<list_type> lists = make_lists();
+  for(std::size_t distance : {0, 1, 4, 100}) {
+    std::vector<int> seen;
+    for(const list_type& list : jacl::prefetch_range(lists, distance)) {
+      for(int x : list) seen.push_back(x);
+    }
+    std::vector<int> expected;
+    for(const list_type& list : lists) expected.insert(expected.end(), list.begin(), list.end());
+    EXPECT_EQ(seen, expected) << "distance " << distance;
+  }
+}
+
+TEST(PrefetchRangeTest, AdaptsMutableAndEmptyRanges) {
+  std::vector<list_type> lists = make_lists();
+  for(list_type& list : jacl::prefetch_range(lists)) list.push_back(-1);
+  for(const list_type& list : lists) EXPECT_EQ(list.back(), -1);
+
+  const std::vector<list_type> empty;
+  auto range = jacl::prefetch_range(empty);
+  EXPECT_TRUE(range.begin() == range.end());
+
+  auto it = jacl::prefetch_range(lists, 3).begin();
+  EXPECT_EQ(it++.base(), lists.begin());
+  EXPECT_EQ(it->front(), 1);
+}
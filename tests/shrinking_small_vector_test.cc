@@ -0,0 +1,168 @@
+#include "jacl/shrinking_small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Copyable, but its move constructor may throw.
+struct may_throw_on_move {
+  int value;
+
+  may_throw_on_move(int v) : value{v} {}
+  may_throw_on_move(const may_throw_on_move&) = default;
+  may_throw_on_move(may_throw_on_move&& other) noexcept(false) : value{other.value} {}
+  may_throw_on_move& operator=(const may_throw_on_move&) = default;
+};
+
+// Throws a non-bad_alloc exception from allocate while `fail` is set.
+template <typename T>
+struct failing_allocator {
+  using value_type = T;
+
+  static bool fail;
+
+  failing_allocator() = default;
+  template <typename U>
+  failing_allocator(const failing_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    if(fail) throw std::runtime_error("allocate");
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* p, std::size_t n) noexcept { std::allocator<T>().deallocate(p, n); }
+
+  friend bool operator==(const failing_allocator&, const failing_allocator&) { return true; }
+  friend bool operator!=(const failing_allocator&, const failing_allocator&) { return false; }
+};
+
+template <typename T>
+bool failing_allocator<T>::fail = false;
+
+} // namespace
+
+TEST(HysteresisShrinkPolicyTest, ShrinkTarget) {
+  using policy = jacl::hysteresis_shrink_policy<>;
+  // Inline or not sparse enough: keep the buffer.
+  EXPECT_EQ(policy::shrink_target(0, 4, 4), 4);
+  EXPECT_EQ(policy::shrink_target(26, 100, 4), 100);
+  // A quarter full: shrink to twice the size, or inline.
+  EXPECT_EQ(policy::shrink_target(25, 100, 4), 50);
+  EXPECT_EQ(policy::shrink_target(2, 100, 4), 4);
+  EXPECT_EQ(policy::shrink_target(0, 100, 4), 4);
+
+  using eager = jacl::hysteresis_shrink_policy<2, 1>;
+  EXPECT_EQ(eager::shrink_target(50, 100, 4), 50);
+}
+
+TEST(ShrinkingSmallVectorTest, PopBackShrinksWithHysteresis) {
+  jacl::shrinking_small_vector<int, 4> vec;
+  for(int i = 0; i < 100; ++i) vec.push_back(i);
+  const std::size_t peak_capacity = vec.capacity();
+
+  while((vec.size() - 1) * 4 > peak_capacity) {
+    vec.pop_back();
+    EXPECT_EQ(vec.capacity(), peak_capacity);
+  }
+  vec.pop_back();
+  const std::size_t shrunk_capacity = vec.capacity();
+  EXPECT_EQ(shrunk_capacity, vec.size() * 2);
+
+  // Oscillating around the shrink point does not reallocate.
+  for(int i = 0; i < 10; ++i) {
+    vec.push_back(i);
+    vec.pop_back();
+    vec.pop_back();
+    vec.push_back(i);
+  }
+  EXPECT_EQ(vec.capacity(), shrunk_capacity);
+
+  while(vec.size() > 2) vec.pop_back();
+  EXPECT_EQ(vec.capacity(), vec.static_capacity);
+  EXPECT_EQ(vec.heap_bytes(), 0);
+  EXPECT_EQ(vec[0], 0);
+  EXPECT_EQ(vec[1], 1);
+}
+
+TEST(ShrinkingSmallVectorTest, EraseClearAndResize) {
+  jacl::shrinking_small_vector<std::string, 2> vec;
+  for(int i = 0; i < 64; ++i) vec.push_back(std::to_string(i));
+
+  auto it = vec.erase(vec.begin() + 1, vec.begin() + 60);
+  EXPECT_LT(vec.capacity(), 64);
+  ASSERT_EQ(vec.size(), 5);
+  EXPECT_EQ(*it, "60");
+  EXPECT_EQ(vec.front(), "0");
+  EXPECT_EQ(vec.back(), "63");
+
+  vec.resize(1);
+  EXPECT_EQ(vec.capacity(), vec.static_capacity);
+  EXPECT_EQ(vec.front(), "0");
+
+  for(int i = 0; i < 64; ++i) vec.push_back(std::to_string(i));
+  vec.clear();
+  EXPECT_EQ(vec.capacity(), vec.static_capacity);
+  EXPECT_TRUE(vec.empty());
+}
+
+TEST(ShrinkingSmallVectorTest, ReserveIsKeptUntilElementsAreRemoved) {
+  jacl::shrinking_small_vector<int, 4> vec{1, 2, 3};
+  vec.reserve(100);
+  EXPECT_EQ(vec.capacity(), 100);
+  vec.push_back(4);
+  EXPECT_EQ(vec.capacity(), 100);
+
+  // Three elements are below a quarter of 100 but need a heap buffer.
+  vec.pop_back();
+  EXPECT_EQ(vec.capacity(), 6);
+  vec.pop_back();
+  vec.pop_back();
+  EXPECT_EQ(vec.capacity(), vec.static_capacity);
+}
+
+TEST(ShrinkingSmallVectorTest, InsertSingleValue) {
+  jacl::shrinking_small_vector<std::string, 2> vec{"a", "c"};
+  const std::string b = "b";
+  auto it = vec.insert(vec.begin() + 1, b);
+  EXPECT_EQ(*it, "b");
+  it = vec.insert(vec.end(), std::string("d"));
+  EXPECT_EQ(*it, "d");
+  ASSERT_EQ(vec.size(), 4);
+  EXPECT_EQ(vec[0], "a");
+  EXPECT_EQ(vec[1], "b");
+  EXPECT_EQ(vec[2], "c");
+  EXPECT_EQ(vec[3], "d");
+  EXPECT_EQ(b, "b");
+}
+
+TEST(ShrinkingSmallVectorTest, MayThrowOnMoveNeverShrinks) {
+  jacl::shrinking_small_vector<may_throw_on_move, 2> vec;
+  for(int i = 0; i < 16; ++i) vec.push_back(i);
+  const std::size_t peak_capacity = vec.capacity();
+  vec.erase(vec.begin() + 1, vec.end());
+  EXPECT_EQ(vec.capacity(), peak_capacity);
+  EXPECT_EQ(vec.front().value, 0);
+  vec.clear();
+  EXPECT_EQ(vec.capacity(), peak_capacity);
+}
+
+TEST(ShrinkingSmallVectorTest, FailedShrinkAllocationKeepsTheBuffer) {
+  jacl::shrinking_small_vector<int, 2, jacl::hysteresis_shrink_policy<>, failing_allocator<int>>
+      vec;
+  for(int i = 0; i < 64; ++i) vec.push_back(i);
+  const std::size_t peak_capacity = vec.capacity();
+
+  failing_allocator<int>::fail = true;
+  vec.erase(vec.begin() + 8, vec.end());
+  failing_allocator<int>::fail = false;
+  EXPECT_EQ(vec.capacity(), peak_capacity);
+  ASSERT_EQ(vec.size(), 8);
+  EXPECT_EQ(vec.back(), 7);
+
+  vec.pop_back();
+  EXPECT_LT(vec.capacity(), peak_capacity);
+}
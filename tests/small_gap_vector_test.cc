@@ -0,0 +1,155 @@
+#include "jacl/small_gap_vector.hh"
+
+#include "mock_allocator.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+template <typename vectorT, typename T>
+void expect_same(const vectorT& vec, const std::vector<T>& model) {
+  ASSERT_EQ(vec.size(), model.size());
+  ASSERT_EQ(std::size_t(vec.end() - vec.begin()), model.size());
+  EXPECT_TRUE(std::equal(vec.begin(), vec.end(), model.begin()));
+  EXPECT_TRUE(std::equal(vec.rbegin(), vec.rend(), model.rbegin()));
+}
+
+// Counts live instances; the copy constructor throws once `copies_left`
+// runs out.
+struct throwing_copy {
+  static int live;
+  static int copies_left;
+
+  int value;
+
+  throwing_copy(int v) : value{v} { ++live; }
+  throwing_copy(const throwing_copy& other) : value{other.value} {
+    if(copies_left-- == 0) throw std::runtime_error("copy");
+    ++live;
+  }
+  throwing_copy(throwing_copy&& other) noexcept : value{other.value} { ++live; }
+  ~throwing_copy() { --live; }
+};
+
+int throwing_copy::live        = 0;
+int throwing_copy::copies_left = -1;
+
+} // namespace
+
+TEST(SmallGapVectorTest, ConstructorsReleaseOnThrow) {
+  using vector_type =
+      jacl::small_gap_vector<throwing_copy, 2, MockAllocator<throwing_copy, NonstatefulPolicy>>;
+  AllocationStats::reset_counters();
+  {
+    const std::vector<throwing_copy> values{0, 1, 2, 3, 4, 5};
+    const int live = throwing_copy::live;
+
+    // Each constructor spills to the heap before the fifth copy throws.
+    throwing_copy::copies_left = 4;
+    EXPECT_THROW(vector_type(values.begin(), values.end()), std::runtime_error);
+    EXPECT_EQ(throwing_copy::live, live);
+    EXPECT_EQ(AllocationStats::outstanding_allocations(), 0);
+
+    throwing_copy::copies_left = 4;
+    EXPECT_THROW(vector_type({0, 1, 2, 3, 4, 5}), std::runtime_error);
+    EXPECT_EQ(throwing_copy::live, live);
+    EXPECT_EQ(AllocationStats::outstanding_allocations(), 0);
+
+    throwing_copy::copies_left = -1;
+    const vector_type original(values.begin(), values.end());
+    throwing_copy::copies_left = 4;
+    EXPECT_THROW(vector_type{original}, std::runtime_error);
+    throwing_copy::copies_left = -1;
+    EXPECT_EQ(throwing_copy::live, live + 6);
+    EXPECT_EQ(AllocationStats::outstanding_allocations(), 1);
+  }
+  EXPECT_EQ(throwing_copy::live, 0);
+  EXPECT_EQ(AllocationStats::allocation_count(), AllocationStats::deallocation_count());
+}
+
+TEST(SmallGapVectorTest, EditsAtCursorMoveTheGap) {
+  jacl::small_gap_vector<int, 4> vec{1, 2, 3};
+  EXPECT_FALSE(vec.is_heap_allocated());
+
+  vec.insert(vec.begin() + 1, 10);
+  EXPECT_EQ(vec.gap_position(), 2);
+  vec.insert(vec.begin() + 2, 11);
+  EXPECT_TRUE(vec.is_heap_allocated());
+  EXPECT_EQ(vec.gap_position(), 3);
+  expect_same(vec, std::vector<int>{1, 10, 11, 2, 3});
+
+  auto it = vec.erase(vec.begin() + 2);
+  EXPECT_EQ(*it, 2);
+  EXPECT_EQ(vec.gap_position(), 2);
+  expect_same(vec, std::vector<int>{1, 10, 2, 3});
+
+  auto halves = vec.spans();
+  EXPECT_EQ(std::vector<int>(halves.first.begin(), halves.first.end()), (std::vector<int>{1, 10}));
+  EXPECT_EQ(std::vector<int>(halves.second.begin(), halves.second.end()), (std::vector<int>{2, 3}));
+
+  const int* p = vec.make_contiguous();
+  EXPECT_EQ(std::vector<int>(p, p + vec.size()), (std::vector<int>{1, 10, 2, 3}));
+  EXPECT_TRUE(vec.spans().second.empty());
+}
+
+TEST(SmallGapVectorTest, RandomEditsMatchVector) {
+  std::mt19937 rng(42);
+  jacl::small_gap_vector<std::string, 8> vec;
+  std::vector<std::string> model;
+  std::size_t cursor = 0;
+  for(int i = 0; i < 2000; ++i) {
+    // Mostly local edits, with an occasional jump.
+    if(rng() % 16 == 0) cursor = model.empty() ? 0 : rng() % (model.size() + 1);
+    cursor = std::min(cursor, model.size());
+    if(rng() % 3 != 0 || model.empty()) {
+      const std::string value = std::to_string(i);
+      vec.insert(vec.begin() + std::ptrdiff_t(cursor), value);
+      model.insert(model.begin() + std::ptrdiff_t(cursor), value);
+      ++cursor;
+    } else {
+      if(cursor == model.size()) --cursor;
+      vec.erase(vec.begin() + std::ptrdiff_t(cursor));
+      model.erase(model.begin() + std::ptrdiff_t(cursor));
+    }
+  }
+  expect_same(vec, model);
+
+  jacl::small_gap_vector<std::string, 8> copy = vec;
+  expect_same(copy, model);
+  EXPECT_EQ(copy.gap_position(), vec.gap_position());
+
+  jacl::small_gap_vector<std::string, 8> moved = std::move(vec);
+  expect_same(moved, model);
+  EXPECT_TRUE(vec.empty());
+
+  copy.erase(copy.begin(), copy.begin() + std::ptrdiff_t(model.size() / 2));
+  model.erase(model.begin(), model.begin() + std::ptrdiff_t(model.size() / 2));
+  expect_same(copy, model);
+  copy.clear();
+  EXPECT_TRUE(copy.empty());
+}
+
+TEST(SmallGapVectorTest, MoveOnlyElements) {
+  jacl::small_gap_vector<std::unique_ptr<int>, 2> vec;
+  for(int i = 0; i < 6; ++i) vec.emplace(vec.begin(), new int(i));
+  vec.push_back(std::unique_ptr<int>(new int(6)));
+  vec.pop_back();
+  std::vector<int> values;
+  for(const auto& p : vec) values.push_back(*p);
+  EXPECT_EQ(values, (std::vector<int>{5, 4, 3, 2, 1, 0}));
+
+  jacl::small_gap_vector<std::unique_ptr<int>, 2> other;
+  other.emplace_back(new int(7));
+  other = std::move(vec);
+  EXPECT_EQ(other.size(), 6);
+  EXPECT_EQ(*other.front(), 5);
+  EXPECT_EQ(*other.back(), 0);
+}
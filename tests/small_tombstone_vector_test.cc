@@ -0,0 +1,108 @@
+#include "jacl/small_tombstone_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+template <typename vectorT, typename T>
+void expect_same(const vectorT& vec, const std::vector<T>& model) {
+  ASSERT_EQ(vec.size(), model.size());
+  ASSERT_EQ(std::size_t(std::distance(vec.begin(), vec.end())), model.size());
+  EXPECT_TRUE(std::equal(vec.begin(), vec.end(), model.begin()));
+  EXPECT_TRUE(std::equal(vec.rbegin(), vec.rend(), model.rbegin()));
+}
+
+} // namespace
+
+TEST(SmallTombstoneVectorTest, BitScans) {
+  for(unsigned i = 0; i < 64; ++i) {
+    const std::uint64_t bit = std::uint64_t(1) << i;
+    EXPECT_EQ(jacl::internal::ctz64(bit), i);
+    EXPECT_EQ(jacl::internal::clz64(bit), 63 - i);
+    EXPECT_EQ(jacl::internal::ctz64(~std::uint64_t(0) << i), i);
+    EXPECT_EQ(jacl::internal::popcount64(~std::uint64_t(0) << i), 64 - i);
+  }
+  EXPECT_EQ(jacl::internal::popcount64(0), 0);
+  EXPECT_EQ(jacl::internal::popcount64(0x8000000000000001ull), 2);
+}
+
+TEST(SmallTombstoneVectorTest, EraseKeepsOrderWithoutShifting) {
+  jacl::small_tombstone_vector<std::string, 4, 50> vec{"a", "b", "c", "d", "e"};
+  auto it = vec.erase(std::next(vec.begin()));
+  EXPECT_EQ(*it, "c");
+  EXPECT_EQ(vec.erased_count(), 1);
+  EXPECT_EQ(vec.slot_count(), 5);
+  expect_same(vec, std::vector<std::string>{"a", "c", "d", "e"});
+
+  // Erasing the last element drops its slot and erased slots before it.
+  vec.erase(std::next(vec.begin(), 2));
+  EXPECT_EQ(vec.erased_count(), 2);
+  vec.pop_back();
+  EXPECT_EQ(vec.erased_count(), 1);
+  EXPECT_EQ(vec.slot_count(), 3);
+  EXPECT_EQ(vec.back(), "c");
+  EXPECT_EQ(vec.front(), "a");
+  expect_same(vec, std::vector<std::string>{"a", "c"});
+
+  vec.push_back("f");
+  const auto& compacted = vec.compacted();
+  EXPECT_EQ(compacted.size(), 3);
+  EXPECT_EQ(vec.erased_count(), 0);
+  expect_same(vec, std::vector<std::string>{"a", "c", "f"});
+}
+
+TEST(SmallTombstoneVectorTest, CompactsPastTheThreshold) {
+  jacl::small_tombstone_vector<int, 8, 25> vec;
+  for(int i = 0; i < 200; ++i) vec.push_back(i);
+
+  // Erase every third element from the front; the 51st erase crosses 25%.
+  auto it = vec.begin();
+  std::vector<int> model;
+  for(int i = 0; i < 200; ++i) {
+    if(i % 3 == 0 && i < 160) {
+      it = vec.erase(it);
+      EXPECT_EQ(*it, i + 1);
+    } else {
+      model.push_back(i);
+      ++it;
+    }
+  }
+  EXPECT_EQ(it, vec.end());
+  EXPECT_LT(vec.slot_count(), 200);
+  EXPECT_LE(vec.erased_count() * 4, vec.slot_count());
+  expect_same(vec, model);
+}
+
+TEST(SmallTombstoneVectorTest, MatchesAVectorUnderRandomErases) {
+  jacl::small_tombstone_vector<int, 16, 50> vec;
+  std::vector<int> model;
+  std::mt19937 rng{3};
+  for(int step = 0; step < 5000; ++step) {
+    if(model.empty() || rng() % 3 != 0) {
+      vec.push_back(step);
+      model.push_back(step);
+    } else {
+      const std::size_t i = rng() % model.size();
+      auto next           = vec.erase(std::next(vec.cbegin(), std::ptrdiff_t(i)));
+      model.erase(model.begin() + std::ptrdiff_t(i));
+      if(i < model.size()) {
+        ASSERT_EQ(*next, model[i]);
+      } else {
+        ASSERT_EQ(next, vec.end());
+      }
+    }
+    if(step % 500 == 0) expect_same(vec, model);
+  }
+  expect_same(vec, model);
+  vec.clear();
+  EXPECT_TRUE(vec.empty());
+  EXPECT_EQ(vec.begin(), vec.end());
+}
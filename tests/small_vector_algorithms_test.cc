@@ -0,0 +1,227 @@
+#include "jacl/small_vector_algorithms.hh"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+template <typename T>
+T value_of(unsigned v) {
+  return T(v);
+}
+
+template <>
+std::string value_of<std::string>(unsigned v) {
+  return std::to_string(v);
+}
+
+template <typename T>
+std::vector<jacl::small_vector<T, 8>> sorted_runs(
+    std::size_t k, std::size_t max_size, unsigned seed) {
+  std::mt19937 rng{seed};
+  std::vector<jacl::small_vector<T, 8>> runs(k);
+  for(auto& run : runs) {
+    const std::size_t n = rng() % (max_size + 1);
+    for(std::size_t i = 0; i < n; ++i) run.push_back(value_of<T>(unsigned(rng() % 100)));
+    std::sort(run.begin(), run.end());
+  }
+  return runs;
+}
+
+template <typename T>
+std::vector<T> sorted_concatenation(const std::vector<jacl::small_vector<T, 8>>& runs) {
+  std::vector<T> all;
+  for(const auto& run : runs) all.insert(all.end(), run.begin(), run.end());
+  std::sort(all.begin(), all.end());
+  return all;
+}
+
+} // namespace
+
+TEST(MergeKTest, MergesAnyNumberOfRuns) {
+  for(std::size_t k : {0, 1, 2, 3, 5, 16, 33}) {
+    const auto runs = sorted_runs<int>(k, 40, unsigned(k));
+    jacl::small_vector<int, 8> out{-1};
+    jacl::merge_k(runs, out);
+
+    std::vector<int> expected{-1};
+    const auto sorted = sorted_concatenation(runs);
+    expected.insert(expected.end(), sorted.begin(), sorted.end());
+    ASSERT_EQ(out.size(), expected.size()) << "k=" << k;
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), expected.begin())) << "k=" << k;
+  }
+}
+
+TEST(MergeKTest, UsesTheComparator) {
+  std::vector<std::vector<double>> runs{{3.5, 1.0}, {9.0, 2.0, -4.0}};
+  std::vector<double> out;
+  jacl::merge_k(runs, out, std::greater<double>());
+  EXPECT_EQ(out, (std::vector<double>{9.0, 3.5, 2.0, 1.0, -4.0}));
+
+  runs.push_back({5.0});
+  out.clear();
+  jacl::merge_k(runs, out, std::greater<double>());
+  EXPECT_EQ(out, (std::vector<double>{9.0, 5.0, 3.5, 2.0, 1.0, -4.0}));
+}
+
+TEST(MergeKTest, AppendsToNonContiguousContainers) {
+  const std::vector<std::vector<int>> runs{{1, 4, 6}, {2, 3, 5}};
+  std::deque<int> out{0};
+  jacl::merge_k(runs, out);
+  EXPECT_EQ(out, (std::deque<int>{0, 1, 2, 3, 4, 5, 6}));
+}
+
+TEST(MergeKTest, IsStable) {
+  using entry = std::pair<int, int>;
+  struct by_key {
+    bool operator()(const entry& a, const entry& b) const { return a.first < b.first; }
+  };
+  const std::vector<std::vector<entry>> runs{
+      {{1, 0}, {2, 0}}, {{1, 1}, {2, 1}, {3, 1}}, {{2, 2}}, {{1, 3}, {3, 3}}};
+  jacl::small_vector<entry, 4> out;
+  jacl::merge_k(runs, out, by_key{});
+
+  const std::vector<entry> expected{
+      {1, 0}, {1, 1}, {1, 3}, {2, 0}, {2, 1}, {2, 2}, {3, 1}, {3, 3}};
+  EXPECT_TRUE(std::equal(out.begin(), out.end(), expected.begin()));
+}
+
+TEST(MergeKTest, MovesFromRvalueInputs) {
+  struct by_value {
+    bool operator()(const std::unique_ptr<int>& a, const std::unique_ptr<int>& b) const {
+      return *a < *b;
+    }
+  };
+  std::vector<jacl::small_vector<std::unique_ptr<int>, 2>> runs(3);
+  for(int i = 0; i < 12; ++i) runs[std::size_t(i) % 3].emplace_back(new int(i));
+
+  jacl::small_vector<std::unique_ptr<int>, 4> out;
+  jacl::merge_k(std::move(runs), out, by_value{});
+  ASSERT_EQ(out.size(), 12);
+  for(int i = 0; i < 12; ++i) EXPECT_EQ(*out[std::size_t(i)], i);
+
+  const auto strings = sorted_runs<std::string>(4, 10, 1);
+  auto copies        = strings;
+  jacl::small_vector<std::string, 8> merged;
+  jacl::merge_k(std::move(copies), merged);
+  EXPECT_TRUE(std::equal(merged.begin(), merged.end(), sorted_concatenation(strings).begin()));
+}
+
+TEST(ConcatTest, ConcatenatesInOrder) {
+  std::vector<jacl::small_vector<int, 4>> parts(5);
+  std::vector<int> expected;
+  for(int i = 0; i < 40; ++i) {
+    parts[std::size_t(i * 7 % 5)].push_back(i);
+  }
+  for(const auto& part : parts) expected.insert(expected.end(), part.begin(), part.end());
+  parts.insert(parts.begin() + 2, jacl::small_vector<int, 4>{});
+
+  const jacl::small_vector<int, 4> all = jacl::concat(parts);
+  ASSERT_EQ(all.size(), expected.size());
+  EXPECT_TRUE(std::equal(all.begin(), all.end(), expected.begin()));
+
+  EXPECT_TRUE(jacl::concat(std::vector<jacl::small_vector<int, 4>>{}).empty());
+
+  const std::vector<std::vector<double>> vectors{{1.5}, {}, {2.5, 3.5}};
+  const auto doubles = jacl::concat<jacl::small_vector<double, 2>>(vectors);
+  EXPECT_EQ(doubles.size(), 3);
+  EXPECT_EQ(doubles[2], 3.5);
+}
+
+TEST(ConcatTest, CopiesLargeInputsOnSeveralThreads) {
+  // About 29 MiB in uneven parts, so the thread ranges split parts.
+  std::vector<jacl::small_vector<std::uint32_t, 8>> parts;
+  std::uint32_t next = 0;
+  for(std::size_t n : {std::size_t(1) << 20, std::size_t(3), std::size_t(5) << 20, std::size_t(0),
+          std::size_t(1234567)}) {
+    parts.emplace_back();
+    for(std::size_t i = 0; i < n; ++i) parts.back().push_back(next++);
+  }
+  const std::size_t total = next;
+
+  for(std::size_t threads : {1, 3, 4}) {
+    const auto all = jacl::concat(parts, threads);
+    ASSERT_EQ(all.size(), total);
+    for(std::size_t i = 0; i < total; ++i) ASSERT_EQ(all[i], std::uint32_t(i)) << i;
+  }
+}
+
+TEST(ConcatTest, MovesFromRvalueInputs) {
+  std::vector<jacl::small_vector<std::unique_ptr<int>, 2>> parts(3);
+  for(int i = 0; i < 9; ++i) parts[std::size_t(i / 3)].emplace_back(new int(i));
+
+  const auto all = jacl::concat(std::move(parts));
+  ASSERT_EQ(all.size(), 9);
+  for(int i = 0; i < 9; ++i) EXPECT_EQ(*all[std::size_t(i)], i);
+
+  std::vector<jacl::small_vector<std::string, 2>> strings{{"a", "b"}, {"c"}};
+  const auto copied = jacl::concat(strings);
+  EXPECT_EQ(copied.size(), 3);
+  EXPECT_EQ(strings[0][0], "a");
+}
+
+TEST(PartitionByTest, ScattersThroughWriteCombiningBuffers) {
+  std::vector<std::uint64_t> rows(10000);
+  for(std::size_t i = 0; i < rows.size(); ++i) rows[i] = i * 2654435761u;
+  const auto key = [](std::uint64_t row) { return std::size_t(row % 37); };
+
+  std::vector<jacl::small_vector<std::uint64_t, 4>> buckets(37);
+  buckets[5].push_back(42);
+  jacl::partition_by(rows, key, buckets);
+
+  std::vector<std::vector<std::uint64_t>> expected(37);
+  expected[5].push_back(42);
+  for(std::uint64_t row : rows) expected[key(row)].push_back(row);
+  for(std::size_t b = 0; b < buckets.size(); ++b) {
+    ASSERT_EQ(buckets[b].size(), expected[b].size()) << "bucket " << b;
+    EXPECT_EQ(buckets[b].capacity(), expected[b].size()) << "bucket " << b;
+    EXPECT_TRUE(std::equal(buckets[b].begin(), buckets[b].end(), expected[b].begin()));
+  }
+}
+
+TEST(PartitionByTest, ConvertsToTheBucketElementType) {
+  const std::vector<int> narrow{3, -1, 4, 1, -5, 9, 2, -6};
+  std::vector<jacl::small_vector<long, 4>> wide(2);
+  jacl::partition_by(narrow, [](int x) { return std::size_t(x < 0); }, wide);
+  EXPECT_EQ(std::vector<long>(wide[0].begin(), wide[0].end()), (std::vector<long>{3, 4, 1, 9, 2}));
+  EXPECT_EQ(std::vector<long>(wide[1].begin(), wide[1].end()), (std::vector<long>{-1, -5, -6}));
+
+  const std::vector<float> reals{0.5f, 2.75f, 7.25f};
+  std::vector<jacl::small_vector<int, 4>> truncated(1);
+  jacl::partition_by(reals, [](float) { return std::size_t(0); }, truncated);
+  EXPECT_EQ(
+      std::vector<int>(truncated[0].begin(), truncated[0].end()), (std::vector<int>{0, 2, 7}));
+}
+
+TEST(PartitionByTest, AppendsOtherElements) {
+  std::vector<std::string> words{"apple", "kiwi", "banana", "fig", "cherry", "plum"};
+  const auto by_length = [](const std::string& w) { return w.size() % 3; };
+
+  jacl::small_vector<std::string, 2> buckets[3];
+  jacl::partition_by(words, by_length, buckets);
+  EXPECT_EQ(buckets[0].size(), 3);
+  EXPECT_EQ(buckets[0][0], "banana");
+  EXPECT_EQ(buckets[0][1], "fig");
+  EXPECT_EQ(buckets[0][2], "cherry");
+  EXPECT_EQ(buckets[1].size(), 2);
+  EXPECT_EQ(buckets[2].size(), 1);
+  EXPECT_EQ(words[0], "apple");
+
+  std::vector<std::unique_ptr<int>> owned;
+  for(int i = 0; i < 10; ++i) owned.emplace_back(new int(i));
+  std::vector<jacl::small_vector<std::unique_ptr<int>, 2>> parity(2);
+  jacl::partition_by(std::move(owned), [](const std::unique_ptr<int>& p) { return *p % 2; },
+      parity);
+  ASSERT_EQ(parity[1].size(), 5);
+  EXPECT_EQ(*parity[1][4], 9);
+}
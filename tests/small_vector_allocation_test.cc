@@ -0,0 +1,395 @@
+#include "jacl/small_vector.hh"
+
+#include "mock_allocator.hh"
+
+#include <cstddef>
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Allocation contracts of small_vector: the exact number of allocations and
+// bytes requested from the allocator by each operation.
+
+namespace {
+
+template <typename T>
+struct value_factory;
+
+template <>
+struct value_factory<int> {
+  static int make(int i) { return i; }
+}; // struct value_factory<int>
+
+// Long enough to defeat the small string optimization, so that elements that
+// are not destroyed show up as leaks in sanitizer builds.
+template <>
+struct value_factory<std::string> {
+  static std::string make(int i) { return "a string that is heap allocated #" + std::to_string(i); }
+}; // struct value_factory<std::string>
+
+template <>
+struct value_factory<std::unique_ptr<int>> {
+  static std::unique_ptr<int> make(int i) { return std::unique_ptr<int>(new int(i)); }
+}; // struct value_factory<std::unique_ptr<int>>
+
+} // namespace
+
+template <typename T>
+class AllocationContractTest : public ::testing::Test {
+protected:
+  enum { inline_size = 4 };
+  using value_type  = T;
+  using vector_type = jacl::small_vector<T, inline_size, MockAllocator<T, NonstatefulPolicy>>;
+
+  static T make(int i) { return value_factory<T>::make(i); }
+
+  static vector_type make_vector(int n) {
+    vector_type vec;
+    for(int i = 0; i < n; ++i) vec.push_back(make(i));
+    return vec;
+  }
+
+  static std::size_t bytes(std::size_t n) { return n * sizeof(T); }
+
+  // Counters relative to the last checkpoint.
+  void checkpoint() {
+    allocations_       = AllocationStats::allocation_count();
+    deallocations_     = AllocationStats::deallocation_count();
+    allocated_bytes_   = AllocationStats::total_allocated();
+    deallocated_bytes_ = AllocationStats::total_deallocated();
+  }
+
+  std::size_t allocations() const { return AllocationStats::allocation_count() - allocations_; }
+  std::size_t deallocations() const {
+    return AllocationStats::deallocation_count() - deallocations_;
+  }
+  std::size_t allocated_bytes() const {
+    return AllocationStats::total_allocated() - allocated_bytes_;
+  }
+  std::size_t deallocated_bytes() const {
+    return AllocationStats::total_deallocated() - deallocated_bytes_;
+  }
+
+  void SetUp() override {
+    AllocationStats::reset_counters();
+    checkpoint();
+  }
+
+  void TearDown() override {
+    EXPECT_EQ(AllocationStats::allocation_count(), AllocationStats::deallocation_count());
+    EXPECT_EQ(AllocationStats::total_allocated(), AllocationStats::total_deallocated());
+    EXPECT_EQ(AllocationStats::outstanding_allocations(), 0);
+  }
+
+private:
+  std::size_t allocations_{};
+  std::size_t deallocations_{};
+  std::size_t allocated_bytes_{};
+  std::size_t deallocated_bytes_{};
+}; // class AllocationContractTest
+
+template <typename T>
+class CopyAllocationContractTest : public AllocationContractTest<T> {};
+
+using AllocationContractTypes     = ::testing::Types<int, std::string, std::unique_ptr<int>>;
+using CopyAllocationContractTypes = ::testing::Types<int, std::string>;
+TYPED_TEST_SUITE(AllocationContractTest, AllocationContractTypes);
+TYPED_TEST_SUITE(CopyAllocationContractTest, CopyAllocationContractTypes);
+
+TYPED_TEST(AllocationContractTest, InlineOnlySequencesDoNotAllocate) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type vec;
+  for(int i = 0; i < TestFixture::inline_size; ++i) vec.push_back(this->make(i));
+  vec.pop_back();
+  vec.emplace(vec.begin(), this->make(10));
+  vec.erase(vec.begin() + 1);
+  vec.resize(2);
+  vec.resize(TestFixture::inline_size);
+  vec.reserve(TestFixture::inline_size);
+  vec.shrink_to_fit();
+
+  vector_type moved{std::move(vec)};
+  vector_type other = this->make_vector(2);
+  other.swap(moved);
+  vec = std::move(other);
+  vec.clear();
+
+  EXPECT_EQ(moved.size(), 2);
+  EXPECT_EQ(vec.capacity(), TestFixture::inline_size);
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 0);
+}
+
+TYPED_TEST(AllocationContractTest, GrowthAllocatesOncePerGeometricStep) {
+  using vector_type = typename TestFixture::vector_type;
+  const int count   = 100;
+
+  std::size_t steps = 0;
+  for(std::size_t cap = TestFixture::inline_size; cap < count; cap += cap / 2 + 1) ++steps;
+
+  {
+    vector_type vec;
+    std::size_t expected_bytes = 0;
+    for(int i = 0; i < count; ++i) {
+      const std::size_t cap         = vec.capacity();
+      const std::size_t allocations = this->allocations();
+      vec.push_back(this->make(i));
+      if(vec.capacity() == cap) {
+        EXPECT_EQ(this->allocations(), allocations);
+      } else {
+        EXPECT_EQ(this->allocations(), allocations + 1);
+        EXPECT_GE(vec.capacity(), cap + cap / 2);
+        expected_bytes += this->bytes(vec.capacity());
+      }
+    }
+    EXPECT_EQ(this->allocations(), steps);
+    EXPECT_EQ(this->allocated_bytes(), expected_bytes);
+    // Every buffer but the last one has been released.
+    EXPECT_EQ(this->deallocations(), steps - 1);
+  }
+  EXPECT_EQ(this->deallocations(), steps);
+}
+
+TYPED_TEST(AllocationContractTest, MoveConstructFromHeapDoesNotAllocate) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type vec       = this->make_vector(10);
+  const auto* data      = vec.data();
+  const std::size_t cap = vec.capacity();
+  this->checkpoint();
+
+  vector_type moved{std::move(vec)};
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 0);
+  EXPECT_EQ(moved.data(), data);
+  EXPECT_EQ(moved.capacity(), cap);
+  EXPECT_TRUE(vec.empty());
+  EXPECT_EQ(vec.capacity(), TestFixture::inline_size);
+}
+
+TYPED_TEST(AllocationContractTest, MoveAssignFromHeapReleasesOnlyTheTargetBuffer) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type source         = this->make_vector(10);
+  vector_type heap_dest      = this->make_vector(20);
+  vector_type inline_dest    = this->make_vector(2);
+  const std::size_t dest_cap = heap_dest.capacity();
+  this->checkpoint();
+
+  heap_dest = std::move(source);
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 1);
+  EXPECT_EQ(this->deallocated_bytes(), this->bytes(dest_cap));
+
+  this->checkpoint();
+  inline_dest = std::move(heap_dest);
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 0);
+  EXPECT_EQ(inline_dest.size(), 10);
+}
+
+TYPED_TEST(AllocationContractTest, ReserveAllocatesExactlyOnce) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type vec = this->make_vector(2);
+  vec.reserve(TestFixture::inline_size);
+  EXPECT_EQ(this->allocations(), 0);
+
+  vec.reserve(10);
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(10));
+  EXPECT_EQ(this->deallocations(), 0);
+
+  this->checkpoint();
+  vec.reserve(10);
+  vec.reserve(5);
+  EXPECT_EQ(this->allocations(), 0);
+
+  vec.reserve(20);
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(20));
+  EXPECT_EQ(this->deallocations(), 1);
+  EXPECT_EQ(this->deallocated_bytes(), this->bytes(10));
+}
+
+TYPED_TEST(AllocationContractTest, ShrinkToFit) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type vec = this->make_vector(10);
+  vec.reserve(32);
+  this->checkpoint();
+
+  // Shrink to an exact fit on the heap.
+  vec.shrink_to_fit();
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(10));
+  EXPECT_EQ(this->deallocations(), 1);
+  EXPECT_EQ(this->deallocated_bytes(), this->bytes(32));
+
+  this->checkpoint();
+  vec.shrink_to_fit();
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 0);
+
+  // Shrink back to the inline buffer.
+  vec.resize(TestFixture::inline_size);
+  vec.shrink_to_fit();
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 1);
+  EXPECT_EQ(vec.capacity(), TestFixture::inline_size);
+}
+
+TYPED_TEST(AllocationContractTest, EraseClearAndPopBackKeepTheBuffer) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type vec       = this->make_vector(10);
+  const std::size_t cap = vec.capacity();
+  this->checkpoint();
+
+  vec.erase(vec.begin(), vec.begin() + 3);
+  vec.erase(vec.begin() + 1);
+  vec.pop_back();
+  EXPECT_EQ(vec.size(), 5);
+  vec.clear();
+
+  EXPECT_EQ(vec.capacity(), cap);
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 0);
+}
+
+TYPED_TEST(AllocationContractTest, SwapDoesNotAllocate) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type heap_a   = this->make_vector(10);
+  vector_type heap_b   = this->make_vector(20);
+  vector_type inline_a = this->make_vector(1);
+  vector_type inline_b = this->make_vector(3);
+  this->checkpoint();
+
+  heap_a.swap(heap_b);
+  heap_a.swap(inline_a);
+  inline_b.swap(heap_b);
+  inline_a.swap(inline_b);
+
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 0);
+}
+
+TYPED_TEST(AllocationContractTest, InsertBeyondCapacityAllocatesOnce) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type vec = this->make_vector(TestFixture::inline_size);
+  vec.emplace(vec.begin() + 1, this->make(100));
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->deallocations(), 0);
+
+  // Range insertion allocates exactly the required capacity.
+  std::vector<typename TestFixture::value_type> values;
+  for(int i = 0; i < 10; ++i) values.push_back(this->make(i));
+  const std::size_t new_size = vec.size() + values.size();
+  this->checkpoint();
+  vec.insert(vec.begin() + 2, std::make_move_iterator(values.begin()),
+      std::make_move_iterator(values.end()));
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(new_size));
+  EXPECT_EQ(this->deallocations(), 1);
+  EXPECT_EQ(vec.size(), new_size);
+}
+
+TYPED_TEST(AllocationContractTest, DestructorReleasesTheHeapBuffer) {
+  {
+    auto heap_vec   = this->make_vector(10);
+    auto inline_vec = this->make_vector(2);
+    this->checkpoint();
+  }
+  EXPECT_EQ(this->deallocations(), 1);
+}
+
+TYPED_TEST(AllocationContractTest, HeapBytesMatchTheLiveBuffer) {
+  using vector_type = typename TestFixture::vector_type;
+
+  vector_type vec = this->make_vector(TestFixture::inline_size);
+  EXPECT_EQ(vec.heap_bytes(), 0);
+  EXPECT_EQ(vec.memory_usage(), sizeof(vector_type));
+
+  vec.push_back(this->make(100));
+  vec.reserve(20);
+  EXPECT_EQ(vec.heap_bytes(), this->allocated_bytes() - this->deallocated_bytes());
+  EXPECT_EQ(vec.heap_bytes(), this->bytes(vec.capacity()));
+  EXPECT_EQ(vec.memory_usage(), sizeof(vector_type) + vec.heap_bytes());
+
+  vec.resize(2);
+  vec.shrink_to_fit();
+  EXPECT_EQ(vec.heap_bytes(), 0);
+  EXPECT_EQ(this->allocated_bytes(), this->deallocated_bytes());
+}
+
+TYPED_TEST(CopyAllocationContractTest, CopyConstructAllocatesAnExactFit) {
+  using vector_type = typename TestFixture::vector_type;
+
+  const vector_type heap_vec   = this->make_vector(10);
+  const vector_type inline_vec = this->make_vector(3);
+  this->checkpoint();
+
+  vector_type heap_copy{heap_vec};
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(10));
+
+  this->checkpoint();
+  vector_type inline_copy{inline_vec};
+  EXPECT_EQ(this->allocations(), 0);
+}
+
+TYPED_TEST(CopyAllocationContractTest, CopyAssignReusesCapacity) {
+  using vector_type = typename TestFixture::vector_type;
+
+  const vector_type source         = this->make_vector(10);
+  vector_type large                = this->make_vector(20);
+  vector_type small_heap           = this->make_vector(6);
+  vector_type small_inline         = this->make_vector(2);
+  const std::size_t small_heap_cap = small_heap.capacity();
+  this->checkpoint();
+
+  large = source;
+  EXPECT_EQ(this->allocations(), 0);
+  EXPECT_EQ(this->deallocations(), 0);
+
+  small_heap = source;
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(10));
+  EXPECT_EQ(this->deallocations(), 1);
+  EXPECT_EQ(this->deallocated_bytes(), this->bytes(small_heap_cap));
+
+  this->checkpoint();
+  small_inline = source;
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(10));
+  EXPECT_EQ(this->deallocations(), 0);
+}
+
+TYPED_TEST(CopyAllocationContractTest, FillOperations) {
+  using vector_type = typename TestFixture::vector_type;
+  const auto value  = this->make(7);
+
+  vector_type inline_vec(3, value);
+  EXPECT_EQ(this->allocations(), 0);
+
+  vector_type heap_vec(10, value);
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(10));
+
+  this->checkpoint();
+  heap_vec.assign(8, value);
+  inline_vec.assign(TestFixture::inline_size, value);
+  EXPECT_EQ(this->allocations(), 0);
+
+  inline_vec.resize(12, value);
+  EXPECT_EQ(this->allocations(), 1);
+  EXPECT_EQ(this->allocated_bytes(), this->bytes(12));
+  EXPECT_EQ(this->deallocations(), 0);
+}
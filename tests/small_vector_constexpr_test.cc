@@ -0,0 +1,92 @@
+#include "jacl/small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#if JACL_CONSTEXPR20_SUPPORTED
+
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int sum_of_squares(int n) {
+  jacl::small_vector<int, 4> vec;
+  for(int i = 1; i <= n; ++i) vec.push_back(i * i);
+  int sum = 0;
+  for(int x : vec) sum += x;
+  return sum;
+}
+
+// Inline-only and spilling to the heap.
+static_assert(sum_of_squares(3) == 14);
+static_assert(sum_of_squares(10) == 385);
+
+constexpr bool insert_and_erase() {
+  jacl::small_vector<int, 2> vec{1, 5};
+  vec.insert(vec.begin() + 1, {2, 3, 4});
+  if(vec.size() != 5 || vec.capacity() < 5) return false;
+  for(int i = 0; i < 5; ++i) {
+    if(vec[i] != i + 1) return false;
+  }
+
+  vec.erase(vec.begin(), vec.begin() + 2);
+  vec.emplace(vec.begin(), 0);
+  return vec.size() == 4 && vec.front() == 0 && vec.back() == 5;
+}
+static_assert(insert_and_erase());
+
+constexpr bool copy_move_and_swap() {
+  jacl::small_vector<int, 4> inline_vec{1, 2};
+  jacl::small_vector<int, 4> heap_vec{1, 2, 3, 4, 5, 6};
+
+  jacl::small_vector<int, 4> copy{heap_vec};
+  jacl::small_vector<int, 4> moved{std::move(copy)};
+  inline_vec.swap(moved);
+  copy = inline_vec;
+  moved.resize(8, 7);
+  moved.shrink_to_fit();
+  return inline_vec.size() == 6 && copy.size() == 6 && moved.size() == 8 && moved[7] == 7 &&
+         copy[5] == 6;
+}
+static_assert(copy_move_and_swap());
+
+// Non-trivial element types can be used during constant evaluation.
+constexpr std::size_t total_length() {
+  jacl::small_vector<std::string, 2> words;
+  words.push_back("compile");
+  words.push_back("time");
+  words.emplace_back("lookup");
+  words.pop_back();
+  std::size_t n = 0;
+  for(const auto& w : words) n += w.size();
+  return n;
+}
+static_assert(total_length() == 11);
+
+// Tables are built by a constant expression and shipped as static data.
+constexpr jacl::small_vector<unsigned, 8> make_powers_of_two() {
+  jacl::small_vector<unsigned, 8> table;
+  for(unsigned i = 0; i < 8; ++i) table.push_back(1u << i);
+  return table;
+}
+
+// Declaring the table constexpr guarantees constant initialization. GCC does
+// not allow reading it in later constant expressions when the vector was
+// returned by NRVO, so its contents are checked at runtime below.
+constexpr jacl::small_vector<unsigned, 8> powers_of_two = make_powers_of_two();
+
+constexpr jacl::small_vector<unsigned, 8> primes{2, 3, 5, 7, 11};
+static_assert(primes.size() == 5 && primes.back() == 11);
+
+} // namespace
+
+TEST(SmallVectorConstexprTest, StaticTablesAreUsableAtRuntime) {
+  EXPECT_EQ(powers_of_two.size(), 8);
+  EXPECT_EQ(powers_of_two.capacity(), 8);
+  for(std::size_t i = 0; i < powers_of_two.size(); ++i) EXPECT_EQ(powers_of_two[i], 1u << i);
+
+  EXPECT_EQ(std::vector<unsigned>(primes.begin(), primes.end()),
+      (std::vector<unsigned>{2, 3, 5, 7, 11}));
+}
+
+#endif // JACL_CONSTEXPR20_SUPPORTED
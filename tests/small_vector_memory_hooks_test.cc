@@ -0,0 +1,107 @@
+// Built into a separate executable with JACL_SMALL_VECTOR_MEMORY_HOOKS=1.
+#include "jacl/small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<jacl::memory::event>& recorded_events() {
+  static std::vector<jacl::memory::event> events;
+  return events;
+}
+
+void record_event(const jacl::memory::event& e) { recorded_events().push_back(e); }
+
+// Installs record_event for the lifetime of the test.
+class SmallVectorMemoryHooksTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    recorded_events().clear();
+    previous_ = jacl::memory::set_hook(&record_event);
+  }
+
+  void TearDown() override { jacl::memory::set_hook(previous_); }
+
+private:
+  jacl::memory::hook previous_{};
+}; // class SmallVectorMemoryHooksTest
+
+} // namespace
+
+TEST_F(SmallVectorMemoryHooksTest, HookSeesEveryHeapBuffer) {
+  const void* buffer = nullptr;
+  {
+    jacl::small_vector<std::uint32_t, 2> vec{1, 2};
+    EXPECT_TRUE(recorded_events().empty());
+
+    vec.push_back(3); // 2 -> 4
+    buffer = vec.data();
+    vec.reserve(16);
+    vec.resize(1);
+    vec.shrink_to_fit();
+  }
+
+  const auto& events = recorded_events();
+  ASSERT_EQ(events.size(), 4);
+  EXPECT_EQ(events[0].op, jacl::memory::operation::allocate);
+  EXPECT_EQ(events[0].ptr, buffer);
+  EXPECT_EQ(events[0].bytes, 4 * sizeof(std::uint32_t));
+  EXPECT_EQ(events[0].value_size, sizeof(std::uint32_t));
+  EXPECT_EQ(events[0].inline_capacity, 2);
+  EXPECT_EQ(events[1].op, jacl::memory::operation::allocate);
+  EXPECT_EQ(events[1].bytes, 16 * sizeof(std::uint32_t));
+  EXPECT_EQ(events[2].op, jacl::memory::operation::deallocate);
+  EXPECT_EQ(events[2].ptr, buffer);
+  EXPECT_EQ(events[2].bytes, 4 * sizeof(std::uint32_t));
+  EXPECT_EQ(events[3].op, jacl::memory::operation::deallocate);
+  EXPECT_EQ(events[3].bytes, 16 * sizeof(std::uint32_t));
+}
+
+TEST_F(SmallVectorMemoryHooksTest, ThreadCountersBalance) {
+  const auto before = jacl::memory::thread_counters();
+  {
+    jacl::small_vector<std::string, 1> vec(10);
+    EXPECT_EQ(jacl::memory::thread_counters().live_bytes() - before.live_bytes(),
+        std::int64_t(vec.heap_bytes()));
+  }
+  const auto after = jacl::memory::thread_counters();
+  EXPECT_EQ(after.allocations - before.allocations, 1);
+  EXPECT_EQ(after.deallocations - before.deallocations, 1);
+  EXPECT_EQ(after.live_bytes(), before.live_bytes());
+}
+
+TEST_F(SmallVectorMemoryHooksTest, AccountsChargeTheirScopes) {
+  jacl::memory::account tenant_a;
+  jacl::memory::account tenant_b;
+  jacl::small_vector<int, 4> outside(4);
+  jacl::small_vector<int, 4> a_vec;
+  {
+    jacl::memory::account_scope scope{tenant_a};
+    a_vec.resize(100);
+    {
+      jacl::memory::account_scope nested{tenant_b};
+      jacl::small_vector<int, 4> temporary(50);
+    }
+    outside.resize(8);
+  }
+  EXPECT_EQ(tenant_a.live_bytes(), std::int64_t(a_vec.heap_bytes() + outside.heap_bytes()));
+  EXPECT_EQ(tenant_a.totals().allocations, 2);
+  EXPECT_EQ(tenant_b.live_bytes(), 0);
+  EXPECT_EQ(tenant_b.totals().allocated_bytes, 50 * sizeof(int));
+
+  // Other threads charge the same account from their own scopes.
+  std::thread worker([&] {
+    jacl::memory::account_scope scope{tenant_b};
+    jacl::small_vector<int, 4> vec(1000);
+    vec.clear();
+    vec.shrink_to_fit();
+  });
+  worker.join();
+  EXPECT_EQ(tenant_b.totals().allocations, 2);
+  EXPECT_EQ(tenant_b.live_bytes(), 0);
+}
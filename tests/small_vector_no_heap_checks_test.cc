@@ -0,0 +1,65 @@
+// Built into a separate executable with JACL_SMALL_VECTOR_NO_HEAP_CHECKS=1.
+#include "jacl/small_vector.hh"
+#include "jacl/small_vector_no_heap.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+
+void spill_in_default_scope() {
+  jacl::no_heap_scope scope;
+  jacl::small_vector<int, 1> vec(2);
+}
+
+} // namespace
+
+TEST(SmallVectorNoHeapTest, InlineOperationsAreAllowed) {
+  jacl::small_vector<int, 8> vec(4);
+  jacl::no_heap_scope scope{jacl::no_heap_action::count};
+  for(int i = 0; i < 4; ++i) vec.push_back(i);
+  vec.erase(vec.begin());
+  vec.emplace(vec.begin(), 7);
+  jacl::small_vector<int, 8> copy{vec};
+  copy.shrink_to_fit();
+  EXPECT_EQ(scope.violations(), 0);
+}
+
+TEST(SmallVectorNoHeapTest, CountsSpillsAndGrowth) {
+  jacl::small_vector<int, 2> vec{1, 2};
+  {
+    jacl::no_heap_scope scope{jacl::no_heap_action::count};
+    vec.push_back(3); // spill
+    vec.reserve(100); // reallocation
+    vec.push_back(4); // fits
+    EXPECT_EQ(scope.violations(), 2);
+  }
+
+  // Outside the scope, allocations are not checked.
+  vec.reserve(1000);
+}
+
+TEST(SmallVectorNoHeapTest, InnermostScopeHandlesViolations) {
+  jacl::no_heap_scope outer{jacl::no_heap_action::count};
+  {
+    jacl::no_heap_scope inner{jacl::no_heap_action::count};
+    jacl::small_vector<int, 1> vec(3);
+    EXPECT_EQ(inner.violations(), 1);
+  }
+  jacl::small_vector<int, 1> vec(3);
+  EXPECT_EQ(outer.violations(), 1);
+}
+
+TEST(SmallVectorNoHeapTest, LogReportsTheSpecialization) {
+  jacl::no_heap_scope scope{jacl::no_heap_action::log};
+  testing::internal::CaptureStderr();
+  jacl::small_vector<char, 4> vec(5);
+  const std::string log = testing::internal::GetCapturedStderr();
+  EXPECT_EQ(scope.violations(), 1);
+  EXPECT_NE(log.find(", 4> allocated 5 bytes on the heap"), std::string::npos) << log;
+}
+
+TEST(SmallVectorNoHeapTest, AbortIsTheDefault) {
+  EXPECT_DEATH(spill_in_default_scope(), "allocated 8 bytes on the heap");
+}
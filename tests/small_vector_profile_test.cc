@@ -0,0 +1,121 @@
+// Built into a separate executable with JACL_SMALL_VECTOR_PROFILE=1.
+#include "jacl/small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace {
+
+// Each test uses its own element type so that it reads its own histograms.
+template <int tagN>
+struct tagged {
+  std::uint32_t value;
+}; // struct tagged
+
+template <typename T, std::size_t sizeN>
+std::vector<jacl::profile::site_profile> profiles_of() {
+  std::vector<jacl::profile::site_profile> profiles;
+  for(auto& p : jacl::profile::snapshot()) {
+    if(p.value_type == typeid(T).name() && p.inline_capacity == sizeN) profiles.push_back(p);
+  }
+  return profiles;
+}
+
+template <typename T, std::size_t sizeN>
+jacl::profile::site_profile merged_profile_of() {
+  auto profiles = profiles_of<T, sizeN>();
+  jacl::profile::site_profile merged{};
+  for(const auto& p : profiles) {
+    merged.final_size.merge(p.final_size);
+    merged.peak_size.merge(p.peak_size);
+  }
+  return merged;
+}
+
+} // namespace
+
+TEST(SmallVectorProfileTest, HistogramBuckets) {
+  using jacl::profile::histogram;
+  histogram h;
+  h.add(3);
+  h.add(3);
+  h.add(100);
+  h.add(1000);
+  EXPECT_EQ(h.total(), 4);
+  EXPECT_EQ(h.count_above(3), 2);
+  EXPECT_EQ(h.count_above(100), 1);
+  EXPECT_EQ(h.percentile(0.5), 3);
+  EXPECT_EQ(h.percentile(0.75), 100);
+  // 1000 is in the bucket [512, 1024).
+  EXPECT_EQ(h.percentile(1.0), 1023);
+  EXPECT_EQ(histogram::lower_bound(histogram::bucket(1000)), 512);
+}
+
+TEST(SmallVectorProfileTest, RecordsFinalAndPeakSizes) {
+  using T = tagged<0>;
+  for(std::uint32_t n = 0; n < 10; ++n) {
+    jacl::small_vector<T, 4> vec;
+    for(std::uint32_t i = 0; i < n; ++i) vec.push_back(T{i});
+    vec.resize(n / 2);
+  }
+
+  const auto p = merged_profile_of<T, 4>();
+  EXPECT_EQ(p.peak_size.total(), 10);
+  EXPECT_EQ(p.peak_size.percentile(1.0), 9);
+  EXPECT_EQ(p.final_size.percentile(1.0), 4);
+  // Vectors whose peak exceeded the inline capacity.
+  EXPECT_EQ(p.peak_size.count_above(4), 5);
+}
+
+TEST(SmallVectorProfileTest, PeakSurvivesMovesAndSwaps) {
+  using T = tagged<1>;
+  {
+    jacl::small_vector<T, 2> a(6);
+    jacl::small_vector<T, 2> b{std::move(a)};
+    jacl::small_vector<T, 2> c;
+    c.swap(b);
+    c.clear();
+  }
+  // a ends empty but moved 6 elements out; b and c each held 6.
+  const auto p = merged_profile_of<T, 2>();
+  EXPECT_EQ(p.peak_size.total(), 3);
+  EXPECT_EQ(p.peak_size.count_above(5), 3);
+  EXPECT_EQ(p.final_size.count_above(0), 0);
+}
+
+TEST(SmallVectorProfileTest, RecommendsSmallestCapacityWithFewestSpills) {
+  jacl::profile::histogram peaks;
+  for(int i = 0; i < 90; ++i) peaks.add(3);
+  for(int i = 0; i < 9; ++i) peaks.add(6);
+  peaks.add(40);
+
+  // With 64 bytes of 4-byte elements, 40 does not fit; 6 covers the rest.
+  auto rec = jacl::profile::recommend(peaks, 4, 64);
+  EXPECT_EQ(rec.inline_capacity, 6);
+  EXPECT_EQ(rec.spills, 1);
+
+  rec = jacl::profile::recommend(peaks, 4, 256);
+  EXPECT_EQ(rec.inline_capacity, 40);
+  EXPECT_EQ(rec.spills, 0);
+
+  rec = jacl::profile::recommend(peaks, 4, 16);
+  EXPECT_EQ(rec.inline_capacity, 3);
+  EXPECT_EQ(rec.spills, 10);
+}
+
+TEST(SmallVectorProfileTest, Report) {
+  using T = tagged<2>;
+  { jacl::small_vector<T, 8> vec(3); }
+
+  std::ostringstream out;
+  jacl::profile::report(out, 64);
+  const std::string report = out.str();
+  const auto header = report.find(std::string{typeid(T).name()} + ", 8> value_size=4");
+  ASSERT_NE(header, std::string::npos);
+  EXPECT_NE(report.find("recommended N=3 (spills=0, inline bytes=12)", header), std::string::npos);
+}
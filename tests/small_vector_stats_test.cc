@@ -0,0 +1,101 @@
+// Built into a separate executable with JACL_SMALL_VECTOR_STATS=1.
+#include "jacl/small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+namespace {
+
+// Each test uses its own element type so that it reads its own counters.
+template <int tagN>
+struct tagged {
+  std::uint32_t value;
+}; // struct tagged
+
+template <typename T, std::size_t sizeN>
+jacl::stats::counters counters_of() {
+  for(const auto& e : jacl::stats::snapshot()) {
+    if(e.value_size == sizeof(T) && e.inline_capacity == sizeN &&
+        e.value_type == typeid(T).name())
+      return e.totals;
+  }
+  return jacl::stats::counters{};
+}
+
+} // namespace
+
+TEST(SmallVectorStatsTest, CountsSpillsAndReallocations) {
+  using T = tagged<0>;
+  {
+    jacl::small_vector<T, 2> vec;
+    for(std::uint32_t i = 0; i < 10; ++i) vec.push_back(T{i});
+    vec.resize(3);
+    vec.shrink_to_fit();
+    vec.resize(1);
+    vec.shrink_to_fit();
+  }
+  jacl::small_vector<T, 2> inline_only{T{1}, T{2}};
+
+  // Growth: 2 -> 4 (spill), 4 -> 7 -> 11 (reallocations), then shrinking to
+  // 3 elements reallocates once more before the vector goes back inline.
+  const auto c = counters_of<T, 2>();
+  EXPECT_EQ(c.constructions, 2);
+  EXPECT_EQ(c.spills, 1);
+  EXPECT_EQ(c.reallocations, 3);
+  EXPECT_EQ(c.bytes_relocated, (2 + 4 + 7 + 3 + 1) * sizeof(T));
+  EXPECT_EQ(c.peak_size, 10);
+  EXPECT_EQ(c.shrinks_to_inline, 1);
+}
+
+TEST(SmallVectorStatsTest, SpecializationsAreCountedSeparately) {
+  using T = tagged<1>;
+  jacl::small_vector<T, 1> a(5);
+  jacl::small_vector<T, 8> b(5);
+
+  const auto one   = counters_of<T, 1>();
+  const auto eight = counters_of<T, 8>();
+  EXPECT_EQ(one.spills, 1);
+  EXPECT_EQ(eight.spills, 0);
+  EXPECT_EQ(eight.peak_size, 5);
+}
+
+TEST(SmallVectorStatsTest, SumsThreads) {
+  using T = tagged<2>;
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; ++t) {
+    threads.emplace_back([t] {
+      jacl::small_vector<T, 4> vec;
+      for(int i = 0; i < 8 + t; ++i) vec.push_back(T{});
+    });
+  }
+  // Counters of threads that exited are kept.
+  for(auto& t : threads) t.join();
+
+  const auto c = counters_of<T, 4>();
+  EXPECT_EQ(c.constructions, 4);
+  EXPECT_EQ(c.spills, 4);
+  EXPECT_EQ(c.peak_size, 11);
+}
+
+TEST(SmallVectorStatsTest, ResetAndDump) {
+  using T = tagged<3>;
+  jacl::small_vector<T, 1> vec(3);
+
+  std::ostringstream out;
+  jacl::stats::dump(out);
+  EXPECT_NE(out.str().find(std::string{typeid(T).name()} + ", 1> value_size=4 constructions=1 "
+                           "spills=1"),
+      std::string::npos);
+
+  jacl::stats::reset();
+  vec.reserve(8);
+  const auto c = counters_of<T, 1>();
+  EXPECT_EQ(c.spills, 0);
+  EXPECT_EQ(c.reallocations, 1);
+}
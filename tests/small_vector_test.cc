@@ -1,5 +1,7 @@
 #include "jacl/small_vector.hh"
 
+#include "mock_allocator.hh"
+
 #include <cstddef>
 #include <gtest/gtest.h>
 
@@ -10,125 +12,6 @@
 #include <unordered_map>
 #include <vector>
 
-class AllocationStats {
-public:
-  static std::size_t allocation_count() { return allocation_count_; }
-  static std::size_t deallocation_count() { return deallocation_count_; }
-  static std::size_t total_allocated() { return total_allocated_; }
-  static std::size_t total_deallocated() { return total_deallocated_; }
-  static std::size_t outstanding_allocations() { return allocations_.size(); }
-
-  static void reset_counters() {
-    allocation_count_   = 0;
-    deallocation_count_ = 0;
-    total_allocated_    = 0;
-    total_deallocated_  = 0;
-    allocations_.clear();
-  }
-
-protected:
-  static void record_allocation(void* ptr, std::size_t n) {
-    allocation_count_++;
-    total_allocated_  += n;
-    allocations_[ptr]  = n;
-  }
-
-  static void record_deallocation(void* ptr, std::size_t n) {
-    deallocation_count_++;
-    total_deallocated_ += n;
-    auto it             = allocations_.find(ptr);
-    if(it != allocations_.end()) { allocations_.erase(it); }
-  }
-
-private:
-  static size_t allocation_count_;
-  static size_t deallocation_count_;
-  static size_t total_allocated_;
-  static size_t total_deallocated_;
-  static std::unordered_map<void*, std::size_t> allocations_;
-}; // class AllocationStats
-
-// C++11 compatible static member definitions
-size_t AllocationStats::allocation_count_   = 0;
-size_t AllocationStats::deallocation_count_ = 0;
-size_t AllocationStats::total_allocated_    = 0;
-size_t AllocationStats::total_deallocated_  = 0;
-std::unordered_map<void*, std::size_t> AllocationStats::allocations_;
-
-class StatefulPolicy {
-public:
-  using propagate_on_container_copy_assignment = std::true_type;
-  using propagate_on_container_move_assignment = std::true_type;
-  using propagate_on_container_swap            = std::true_type;
-
-  StatefulPolicy() : id_{next_id_++} {}
-
-  StatefulPolicy(const StatefulPolicy&) noexcept : id_{next_id_++} {}
-
-  StatefulPolicy& operator=(const StatefulPolicy&) noexcept {
-    id_ = next_id_++;
-    return *this;
-  }
-
-  StatefulPolicy(StatefulPolicy&& other) noexcept : id_{std::exchange(other.id_, next_id_++)} {}
-
-  StatefulPolicy& operator=(StatefulPolicy&& other) noexcept {
-    id_ = std::exchange(other.id_, next_id_++);
-    return *this;
-  }
-
-  bool operator==(const StatefulPolicy& other) const noexcept { return id_ == other.id_; }
-  bool operator!=(const StatefulPolicy& other) const noexcept { return id_ != other.id_; }
-
-  std::size_t get_id() const noexcept { return id_; }
-
-private:
-  size_t id_{};
-  static size_t next_id_;
-}; // class StatefulPolicy
-
-size_t StatefulPolicy::next_id_ = 1;
-
-class NonstatefulPolicy {
-public:
-  using propagate_on_container_copy_assignment = std::true_type;
-  using propagate_on_container_move_assignment = std::true_type;
-  using propagate_on_container_swap            = std::true_type;
-
-  bool operator==(const NonstatefulPolicy&) const noexcept { return true; }
-  bool operator!=(const NonstatefulPolicy&) const noexcept { return false; }
-
-}; // class NonstatefulPolicy
-
-template <typename T, typename policyT>
-class MockAllocator : public AllocationStats, public policyT {
-public:
-  using value_type      = T;
-  using size_type       = std::size_t;
-  using difference_type = std::ptrdiff_t;
-  using propagate_on_container_copy_assignment =
-      typename policyT::propagate_on_container_copy_assignment;
-  using propagate_on_container_move_assignment =
-      typename policyT::propagate_on_container_move_assignment;
-  using propagate_on_container_swap = typename policyT::propagate_on_container_swap;
-
-  T* allocate(size_type n) {
-    T* ptr = static_cast<T*>(std::malloc(n * sizeof(T)));
-    if(!ptr) throw std::bad_alloc();
-    record_allocation(ptr, n * sizeof(T));
-    return ptr;
-  }
-
-  void deallocate(T* ptr, size_type n) {
-    record_deallocation(ptr, n * sizeof(T));
-    std::free(ptr);
-  }
-
-private:
-  template <typename U>
-  friend class InstrumentedAllocator;
-}; // class InstrumentedAllocator
-
 using alloc_stateful_int_t        = MockAllocator<int, StatefulPolicy>;
 using alloc_nonstateful_int_t     = MockAllocator<int, NonstatefulPolicy>;
 using alloc_nonstateful_int_ptr_t = MockAllocator<std::unique_ptr<int>, NonstatefulPolicy>;
@@ -1007,6 +890,34 @@ TEST_F(SmallVectorTest, Resize) {
   EXPECT_EQ(AllocationStats::outstanding_allocations(), 1);
 }
 
+TEST_F(SmallVectorTest, ResizeAndOverwrite) {
+  jacl::small_vector<int, 4, alloc_nonstateful_int_t> vec{1, 2};
+
+  vec.resize_and_overwrite(4, [](int* p, size_t n) {
+    EXPECT_EQ(p[0], 1);
+    EXPECT_EQ(p[1], 2);
+    for(size_t i = 2; i < n; ++i) p[i] = int(i) * 10;
+    return n;
+  });
+  EXPECT_EQ(vec.size(), 4);
+  EXPECT_EQ(vec[3], 30);
+  EXPECT_EQ(AllocationStats::allocation_count(), 0);
+
+  vec.resize_and_overwrite(10, [](int* p, size_t) {
+    p[4] = 40;
+    return 5;
+  });
+  EXPECT_EQ(vec.size(), 5);
+  EXPECT_GE(vec.capacity(), 10);
+  EXPECT_EQ(vec[2], 20);
+  EXPECT_EQ(vec[4], 40);
+  EXPECT_EQ(AllocationStats::allocation_count(), 1);
+
+  vec.resize_and_overwrite(3, [](int*, size_t n) { return n - 2; });
+  EXPECT_EQ(vec.size(), 1);
+  EXPECT_EQ(vec[0], 1);
+}
+
 TEST_F(SmallVectorTest, ReserveWithStaticMemory) {
   jacl::small_vector<int, 4, alloc_nonstateful_int_t> vec{1, 2};
 
@@ -1083,7 +994,7 @@ TEST_F(SmallVectorTest, PushBackMoveSemantics) {
     jacl::small_vector<std::unique_ptr<int>, 4, alloc_nonstateful_int_ptr_t> vec;
 
     for(int i = 1; i <= 4; ++i) {
-      auto ptr = std::make_unique<int>(i);
+      auto ptr = std::unique_ptr<int>(new int(i));
       vec.push_back(std::move(ptr));
       EXPECT_EQ(vec.size(), static_cast<std::size_t>(i));
       EXPECT_EQ(vec.capacity(), 4);
@@ -1102,7 +1013,7 @@ TEST_F(SmallVectorTest, PushBackMoveSemantics) {
       size_t dealloc_count     = AllocationStats::deallocation_count();
 
       size_t cur_capacity = vec.capacity();
-      auto ptr            = std::make_unique<int>(i);
+      auto ptr            = std::unique_ptr<int>(new int(i));
       vec.push_back(std::move(ptr));
 
       if(vec.size() > cur_capacity) {
@@ -1283,3 +1194,83 @@ TEST_F(SmallVectorTest, PushBackCapacityGrowth) {
   EXPECT_EQ(AllocationStats::allocation_count(), pre_growth_count + 1);
   EXPECT_EQ(AllocationStats::deallocation_count(), pre_growth_count);
 }
+
+TEST_F(SmallVectorTest, InsertWithStaticAndDynamicMemory) {
+  jacl::small_vector<int, 4, alloc_nonstateful_int_t> vec{1, 4};
+
+  // Fits in the inline buffer.
+  auto it = vec.insert(vec.cbegin() + 1, {2, 3});
+  EXPECT_EQ(it, vec.begin() + 1);
+  EXPECT_EQ(std::vector<int>(vec.begin(), vec.end()), (std::vector<int>{1, 2, 3, 4}));
+  EXPECT_EQ(AllocationStats::allocation_count(), 0);
+
+  // Requires a heap buffer.
+  it = vec.insert(vec.cbegin(), {-1, 0});
+  EXPECT_EQ(it, vec.begin());
+  EXPECT_EQ(std::vector<int>(vec.begin(), vec.end()), (std::vector<int>{-1, 0, 1, 2, 3, 4}));
+  EXPECT_EQ(AllocationStats::allocation_count(), 1);
+
+  it = vec.emplace(vec.cend(), 5);
+  EXPECT_EQ(*it, 5);
+  EXPECT_EQ(vec.size(), 7);
+}
+
+namespace {
+
+// Counts live instances; the move constructor throws once `moves_left` runs
+// out.
+struct throwing_move {
+  static int live;
+  static int moves_left;
+
+  int value;
+
+  explicit throwing_move(int v) : value{v} { ++live; }
+  throwing_move(const throwing_move& other) : value{other.value} { ++live; }
+  throwing_move(throwing_move&& other) : value{other.value} {
+    if(moves_left-- == 0) throw std::runtime_error("move");
+    ++live;
+  }
+  throwing_move& operator=(const throwing_move&) = default;
+  ~throwing_move() { --live; }
+};
+
+int throwing_move::live       = 0;
+int throwing_move::moves_left = -1;
+
+} // namespace
+
+TEST_F(SmallVectorTest, InsertRollsBackThrowingMove) {
+  {
+    jacl::small_vector<throwing_move, 8> vec;
+    for(int i = 0; i < 4; ++i) vec.emplace_back(i);
+    ASSERT_EQ(throwing_move::live, 4);
+
+    // Shifting the tail moves 3 into the gap, then throws moving 2.
+    throwing_move::moves_left = 1;
+    const throwing_move value{-1};
+    EXPECT_THROW(vec.insert(vec.cbegin(), &value, &value + 1), std::runtime_error);
+    throwing_move::moves_left = -1;
+
+    // The moved-out tail element is dropped; the rest are intact.
+    ASSERT_EQ(vec.size(), 3);
+    EXPECT_EQ(throwing_move::live, 4);
+    for(int i = 0; i < 3; ++i) EXPECT_EQ(vec[i].value, i);
+  }
+  EXPECT_EQ(throwing_move::live, 0);
+}
+
+TEST_F(SmallVectorTest, EraseShiftsTail) {
+  jacl::small_vector<std::unique_ptr<int>, 4, alloc_nonstateful_int_ptr_t> vec;
+  for(int i = 0; i < 8; ++i) vec.push_back(std::unique_ptr<int>(new int(i)));
+
+  auto it = vec.erase(vec.cbegin() + 1, vec.cbegin() + 3);
+  EXPECT_EQ(**it, 3);
+  ASSERT_EQ(vec.size(), 6);
+  const int expected[] = {0, 3, 4, 5, 6, 7};
+  for(std::size_t i = 0; i < vec.size(); ++i) EXPECT_EQ(*vec[i], expected[i]);
+
+  it = vec.erase(vec.cend() - 1);
+  EXPECT_EQ(it, vec.end());
+  EXPECT_EQ(vec.size(), 5);
+}
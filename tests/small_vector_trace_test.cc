@@ -0,0 +1,148 @@
+// Built into a separate executable with JACL_SMALL_VECTOR_TRACE=1.
+#include "jacl/small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::uint64_t address(const void* p) { return reinterpret_cast<std::uintptr_t>(p); }
+
+std::vector<jacl::trace::op> ops_of(const jacl::trace::trace_data& trace, std::uint64_t object) {
+  std::vector<jacl::trace::op> ops;
+  for(const auto& r : trace.records) {
+    if(r.object == object) ops.push_back(static_cast<jacl::trace::op>(r.op));
+  }
+  return ops;
+}
+
+} // namespace
+
+class SmallVectorTraceTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "small_vector_trace_test_" +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".trace";
+  }
+
+  void TearDown() override {
+    jacl::trace::stop();
+    std::remove(path_.c_str());
+  }
+
+  std::string path_;
+}; // class SmallVectorTraceTest
+
+TEST_F(SmallVectorTraceTest, RecordsOperations) {
+  ASSERT_TRUE(jacl::trace::start(path_.c_str()));
+  std::uint64_t object = 0;
+  {
+    jacl::small_vector<int, 2> vec;
+    object = address(&vec);
+    vec.push_back(1);
+    vec.push_back(2);
+    vec.push_back(3);
+    vec.erase(vec.begin());
+    vec.insert(vec.begin() + 1, {4, 5});
+    vec.resize(1);
+    vec.shrink_to_fit();
+  }
+  jacl::trace::stop();
+
+  const auto trace = jacl::trace::read(path_.c_str());
+  ASSERT_FALSE(trace.records.empty());
+  const auto& type = trace.types[trace.records[0].type];
+  EXPECT_EQ(type.value_size, sizeof(int));
+  EXPECT_EQ(type.inline_size, 2);
+  EXPECT_TRUE(type.flags & jacl::trace::type_trivially_copyable);
+
+  // Operations called from other operations, such as the reallocation in
+  // push_back, are not recorded separately.
+  using op = jacl::trace::op;
+  EXPECT_EQ(ops_of(trace, object),
+      (std::vector<op>{op::construct, op::emplace_back, op::emplace_back, op::emplace_back,
+          op::erase, op::insert, op::resize, op::shrink_to_fit, op::destroy}));
+
+  const auto& spill = trace.records[3];
+  EXPECT_EQ(spill.size_before, 2);
+  EXPECT_EQ(spill.size_after, 3);
+  EXPECT_TRUE(spill.flags & jacl::trace::flag_heap);
+
+  const auto& insert = trace.records[5];
+  EXPECT_EQ(insert.size_before, 2);
+  EXPECT_EQ(insert.size_after, 4);
+  EXPECT_EQ(insert.arg, 1);
+
+  const auto& shrink = trace.records[7];
+  EXPECT_EQ(shrink.size_after, 1);
+  EXPECT_FALSE(shrink.flags & jacl::trace::flag_heap);
+
+  for(std::size_t i = 1; i < trace.records.size(); ++i) {
+    EXPECT_LT(trace.records[i - 1].sequence, trace.records[i].sequence);
+  }
+}
+
+TEST_F(SmallVectorTraceTest, RecordsSourceOfCopiesMovesAndSwaps) {
+  ASSERT_TRUE(jacl::trace::start(path_.c_str()));
+  jacl::small_vector<std::string, 1> a{"x", "y"};
+  jacl::small_vector<std::string, 1> b{a};
+  jacl::small_vector<std::string, 1> c{std::move(a)};
+  b.swap(c);
+  jacl::trace::stop();
+
+  const auto trace = jacl::trace::read(path_.c_str());
+  ASSERT_EQ(trace.records.size(), 4);
+  EXPECT_EQ(trace.records[1].op, static_cast<std::uint8_t>(jacl::trace::op::copy_construct));
+  EXPECT_EQ(trace.records[1].object, address(&b));
+  EXPECT_EQ(trace.records[1].other, address(&a));
+  EXPECT_EQ(trace.records[2].op, static_cast<std::uint8_t>(jacl::trace::op::move_construct));
+  EXPECT_EQ(trace.records[2].other, address(&a));
+  EXPECT_EQ(trace.records[3].op, static_cast<std::uint8_t>(jacl::trace::op::swap));
+  EXPECT_EQ(trace.records[3].other, address(&c));
+  EXPECT_FALSE(
+      trace.types[trace.records[0].type].flags & jacl::trace::type_trivially_copyable);
+}
+
+TEST_F(SmallVectorTraceTest, MergesThreads) {
+  ASSERT_TRUE(jacl::trace::start(path_.c_str()));
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; ++t) {
+    threads.emplace_back([] {
+      jacl::small_vector<double, 4> vec;
+      for(int i = 0; i < 10000; ++i) vec.push_back(i);
+    });
+  }
+  for(auto& t : threads) t.join();
+  jacl::trace::stop();
+
+  const auto trace = jacl::trace::read(path_.c_str());
+  ASSERT_EQ(trace.records.size(), 4 * (10000 + 2));
+  for(std::size_t i = 1; i < trace.records.size(); ++i) {
+    EXPECT_EQ(trace.records[i].type, trace.records[0].type);
+    EXPECT_LT(trace.records[i - 1].sequence, trace.records[i].sequence);
+  }
+}
+
+TEST_F(SmallVectorTraceTest, NothingIsRecordedWhenStopped) {
+  ASSERT_TRUE(jacl::trace::start(path_.c_str()));
+  jacl::trace::stop();
+  jacl::small_vector<int, 2> vec{1, 2, 3};
+  EXPECT_TRUE(jacl::trace::read(path_.c_str()).records.empty());
+}
+
+TEST_F(SmallVectorTraceTest, ReadRejectsMalformedFiles) {
+  EXPECT_THROW(jacl::trace::read(path_.c_str()), std::runtime_error);
+  {
+    std::ofstream out{path_, std::ios::binary};
+    out << "JSVTRACE but not really";
+  }
+  EXPECT_THROW(jacl::trace::read(path_.c_str()), std::runtime_error);
+}
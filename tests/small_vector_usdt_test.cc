@@ -0,0 +1,21 @@
+// Built into a separate executable with JACL_SMALL_VECTOR_USDT=1 when
+// sys/sdt.h is available. Probes are only observable with a tracer attached,
+// so this checks that every probe site compiles and leaves behavior unchanged.
+#include "jacl/small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+TEST(SmallVectorUsdtTest, ProbedOperations) {
+  jacl::small_vector<std::string, 2> vec{"a", "b"};
+  vec.push_back("c"); // spill
+  vec.reserve(16);    // realloc, dealloc
+  EXPECT_EQ(vec.capacity(), 16);
+
+  vec.resize(1);
+  vec.shrink_to_fit(); // shrink_to_inline, dealloc
+  EXPECT_EQ(vec.capacity(), 2);
+  ASSERT_EQ(vec.size(), 1);
+  EXPECT_EQ(vec[0], "a");
+}
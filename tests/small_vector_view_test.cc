@@ -0,0 +1,124 @@
+#include "jacl/small_vector_view.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class SmallVectorViewTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "small_vector_view_test_" +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".bin";
+  }
+
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  std::string path_;
+}; // class SmallVectorViewTest
+
+TEST_F(SmallVectorViewTest, ViewOfSmallVector) {
+  jacl::small_vector<int, 4> vec{1, 2, 3, 4, 5, 6};
+  jacl::small_vector_view<int> view{vec};
+
+  EXPECT_EQ(view.size(), vec.size());
+  EXPECT_EQ(view.data(), vec.data());
+  EXPECT_FALSE(view.empty());
+  EXPECT_EQ(view.front(), 1);
+  EXPECT_EQ(view.back(), 6);
+  for(std::size_t i = 0; i < view.size(); ++i) {
+    EXPECT_EQ(view[i], vec[i]);
+    EXPECT_EQ(view.at(i), vec[i]);
+  }
+  EXPECT_THROW(view.at(view.size()), std::out_of_range);
+  EXPECT_EQ(std::vector<int>(view.rbegin(), view.rend()), (std::vector<int>{6, 5, 4, 3, 2, 1}));
+}
+
+TEST_F(SmallVectorViewTest, DefaultConstructedViewIsEmpty) {
+  jacl::small_vector_view<double> view;
+  EXPECT_TRUE(view.empty());
+  EXPECT_EQ(view.size(), 0);
+  EXPECT_EQ(view.begin(), view.end());
+}
+
+TEST_F(SmallVectorViewTest, FromBytesRoundTrip) {
+  jacl::small_vector<uint64_t, 2> vec{10, 20, 30};
+  std::ostringstream out;
+  EXPECT_EQ(jacl::serialize(out, vec), jacl::serialized_size<uint64_t>(vec.size()));
+
+  // Copy into aligned storage; std::string does not guarantee the alignment
+  // that a mapped file provides.
+  const std::string bytes = out.str();
+  std::vector<uint64_t> storage((bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  std::memcpy(storage.data(), bytes.data(), bytes.size());
+
+  auto view = jacl::small_vector_view<uint64_t>::from_bytes(storage.data(), bytes.size());
+  EXPECT_EQ(std::vector<uint64_t>(view.begin(), view.end()), (std::vector<uint64_t>{10, 20, 30}));
+}
+
+TEST_F(SmallVectorViewTest, FromBytesRejectsTypeMismatch) {
+  jacl::small_vector<uint32_t, 4> vec{1, 2, 3};
+  std::ostringstream out;
+  jacl::serialize(out, vec);
+  const std::string bytes = out.str();
+  std::vector<uint64_t> storage((bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  std::memcpy(storage.data(), bytes.data(), bytes.size());
+
+  EXPECT_THROW(jacl::small_vector_view<uint64_t>::from_bytes(storage.data(), bytes.size()),
+      std::runtime_error);
+  EXPECT_THROW(
+      jacl::small_vector_view<uint32_t>::from_bytes(storage.data(), 8), std::runtime_error);
+  EXPECT_THROW(jacl::small_vector_view<uint32_t>::from_bytes(storage.data(), bytes.size() - 64),
+      std::runtime_error);
+}
+
+#if JACL_HAS_MMAP
+
+TEST_F(SmallVectorViewTest, MappedFile) {
+  std::vector<jacl::small_vector<int, 4>> vecs;
+  for(int n = 0; n < 20; ++n) {
+    vecs.emplace_back();
+    for(int i = 0; i < n; ++i) vecs.back().push_back(n * 100 + i);
+  }
+
+  {
+    std::ofstream out{path_, std::ios::binary};
+    jacl::serialized_vector_writer writer{out};
+    for(const auto& v : vecs) writer.append(v);
+    writer.finish();
+  }
+
+  jacl::mapped_small_vector_file file{path_.c_str()};
+  ASSERT_EQ(file.size(), vecs.size());
+  for(std::size_t n = 0; n < file.size(); ++n) {
+    auto view = file.view<int>(n);
+    ASSERT_EQ(view.size(), vecs[n].size());
+    EXPECT_TRUE(std::equal(view.begin(), view.end(), vecs[n].begin()));
+  }
+
+  EXPECT_THROW(file.view<int>(file.size()), std::out_of_range);
+  EXPECT_THROW(file.view<float>(1), std::runtime_error);
+
+  // Moving transfers the mapping.
+  jacl::mapped_small_vector_file moved{std::move(file)};
+  EXPECT_EQ(file.size(), 0);
+  EXPECT_EQ(moved.size(), vecs.size());
+  EXPECT_EQ(moved.view<int>(3)[2], 302);
+}
+
+TEST_F(SmallVectorViewTest, MappedFileRejectsMalformedFiles) {
+  EXPECT_THROW(jacl::mapped_small_vector_file{path_.c_str()}, std::runtime_error);
+
+  {
+    std::ofstream out{path_, std::ios::binary};
+    out << "not a serialized vector file, just some bytes to fill the trailer";
+  }
+  EXPECT_THROW(jacl::mapped_small_vector_file{path_.c_str()}, std::runtime_error);
+}
+
+#endif // JACL_HAS_MMAP
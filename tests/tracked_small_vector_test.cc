@@ -0,0 +1,144 @@
+#include "jacl/tracked_small_vector.hh"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<jacl::index_range> ranges_of(const jacl::index_range_set& set) {
+  return std::vector<jacl::index_range>(set.begin(), set.end());
+}
+
+} // namespace
+
+TEST(IndexRangeSetTest, InsertCoalescesOverlappingAndAdjacentRanges) {
+  jacl::index_range_set set;
+  EXPECT_TRUE(set.empty());
+
+  set.insert(10, 20);
+  set.insert(30, 40);
+  set.insert(0, 5);
+  EXPECT_EQ(ranges_of(set), (std::vector<jacl::index_range>{{0, 5}, {10, 20}, {30, 40}}));
+
+  // Adjacent on both sides.
+  set.insert(20, 30);
+  EXPECT_EQ(ranges_of(set), (std::vector<jacl::index_range>{{0, 5}, {10, 40}}));
+
+  // Overlapping several ranges.
+  set.insert(3, 12);
+  EXPECT_EQ(ranges_of(set), (std::vector<jacl::index_range>{{0, 40}}));
+
+  // Contained and empty ranges are no-ops.
+  set.insert(5, 6);
+  set.insert(50, 50);
+  EXPECT_EQ(ranges_of(set), (std::vector<jacl::index_range>{{0, 40}}));
+  EXPECT_EQ(set.count(), 40);
+}
+
+TEST(IndexRangeSetTest, TruncateAndContains) {
+  jacl::index_range_set set;
+  set.insert(0, 2);
+  set.insert(4, 8);
+  set.insert(10, 12);
+
+  EXPECT_TRUE(set.contains(0));
+  EXPECT_FALSE(set.contains(2));
+  EXPECT_TRUE(set.contains(7));
+  EXPECT_FALSE(set.contains(12));
+
+  set.truncate(6);
+  EXPECT_EQ(ranges_of(set), (std::vector<jacl::index_range>{{0, 2}, {4, 6}}));
+  set.truncate(4);
+  EXPECT_EQ(ranges_of(set), (std::vector<jacl::index_range>{{0, 2}}));
+  set.truncate(0);
+  EXPECT_TRUE(set.empty());
+}
+
+TEST(TrackedSmallVectorTest, ElementWritesAreTracked) {
+  jacl::tracked_small_vector<int, 4> vec;
+  for(int i = 0; i < 100; ++i) vec.push_back(i);
+  vec.take_delta();
+  EXPECT_TRUE(vec.dirty_ranges().empty());
+
+  vec[10] = -10;
+  vec.set(11, -11);
+  vec.at(50) = -50;
+  EXPECT_EQ(ranges_of(vec.dirty_ranges()), (std::vector<jacl::index_range>{{10, 12}, {50, 51}}));
+
+  // Const access does not mark elements.
+  const auto& cvec = vec;
+  EXPECT_EQ(cvec[20], 20);
+  EXPECT_EQ(vec.dirty_ranges().size(), 2);
+
+  auto delta = vec.take_delta();
+  EXPECT_EQ(delta.size, 100);
+  EXPECT_EQ(delta.values, (std::vector<int>{-10, -11, -50}));
+  EXPECT_TRUE(vec.dirty_ranges().empty());
+}
+
+TEST(TrackedSmallVectorTest, StructuralChangesAreTracked) {
+  jacl::tracked_small_vector<int, 4> vec;
+  for(int i = 0; i < 10; ++i) vec.push_back(i);
+  vec.take_delta();
+
+  vec.push_back(10);
+  EXPECT_EQ(ranges_of(vec.dirty_ranges()), (std::vector<jacl::index_range>{{10, 11}}));
+
+  vec.pop_back();
+  EXPECT_TRUE(vec.dirty_ranges().empty());
+
+  vec.insert(vec.cbegin() + 5, 42);
+  EXPECT_EQ(ranges_of(vec.dirty_ranges()), (std::vector<jacl::index_range>{{5, 11}}));
+  vec.take_delta();
+
+  vec.erase(vec.cbegin() + 8, vec.cend());
+  EXPECT_TRUE(vec.dirty_ranges().empty());
+  vec.erase(vec.cbegin() + 2);
+  EXPECT_EQ(ranges_of(vec.dirty_ranges()), (std::vector<jacl::index_range>{{2, 7}}));
+  vec.take_delta();
+
+  vec.resize(9, 7);
+  EXPECT_EQ(ranges_of(vec.dirty_ranges()), (std::vector<jacl::index_range>{{7, 9}}));
+  vec.resize(3);
+  EXPECT_TRUE(vec.dirty_ranges().empty());
+
+  vec.mark_dirty(1, 100);
+  EXPECT_EQ(ranges_of(vec.dirty_ranges()), (std::vector<jacl::index_range>{{1, 3}}));
+}
+
+TEST(TrackedSmallVectorTest, DeltasReplicateToFollowers) {
+  jacl::tracked_small_vector<std::string, 2> leader{"a", "b", "c"};
+  jacl::small_vector<std::string, 2> follower;
+  jacl::tracked_small_vector<std::string, 2> relay;
+
+  auto sync = [&] {
+    auto delta = leader.take_delta();
+    jacl::apply_delta(follower, delta);
+    relay.apply_delta(delta);
+    ASSERT_EQ(follower.size(), leader.size());
+    for(std::size_t i = 0; i < leader.size(); ++i) {
+      EXPECT_EQ(follower[i], leader.get()[i]);
+      EXPECT_EQ(relay.get()[i], leader.get()[i]);
+    }
+  };
+
+  sync();
+
+  for(int i = 0; i < 50; ++i) leader.push_back(std::to_string(i));
+  leader[1] = "B";
+  sync();
+
+  leader.erase(leader.cbegin() + 10, leader.cbegin() + 20);
+  leader.insert(leader.cbegin(), "front");
+  sync();
+
+  leader.resize(5);
+  leader.back() = "last";
+  sync();
+
+  leader.clear();
+  sync();
+  EXPECT_TRUE(follower.empty());
+}